@@ -0,0 +1,197 @@
+// See LICENSE for license details.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#ifndef BAREMETAL
+#include <sys/mman.h>
+#endif
+#include "include/gemmini_testutils.h"
+
+#ifndef BAREMETAL
+#define BATCH_SIZE 2
+#define IN_DIM 28
+#define IN_CHANNELS 64
+#define OUT_CHANNELS 64
+#define PADDING 1
+#else
+#define BATCH_SIZE 1
+#define IN_DIM 9
+#define IN_CHANNELS 19
+#define OUT_CHANNELS 21
+#define PADDING 1
+#endif
+
+#define KERNEL_DIM 3
+#define OUT_DIM (IN_DIM + 2*PADDING - KERNEL_DIM + 1)
+#define SHIFT 6
+
+// The inputs and weights are small enough for V and U to fit in 8 bits, so in
+// approximate mode, the only error comes from rounding M
+#define MAX_APPROX_ERROR 5
+
+// With full-range inputs and weights, V and U get rounded too, and the
+// worst-case error is too large for a tight budget, so the first full-range
+// test falls back to exact mode and the second one doesn't
+#define FULL_RANGE_SHIFT 10
+#define MAX_FULL_RANGE_EXACT_ERROR 16
+#define MAX_FULL_RANGE_APPROX_ERROR 255
+
+void conv(elem_t input[BATCH_SIZE][IN_DIM][IN_DIM][IN_CHANNELS],
+        elem_t weights[KERNEL_DIM][KERNEL_DIM][IN_CHANNELS][OUT_CHANNELS],
+        acc_t bias[OUT_CHANNELS],
+        elem_t output[BATCH_SIZE][OUT_DIM][OUT_DIM][OUT_CHANNELS],
+        int shift) {
+
+    for (int b = 0; b < BATCH_SIZE; b++) {
+        for (int orow = 0; orow < OUT_DIM; orow++) {
+            for (int ocol = 0; ocol < OUT_DIM; ocol++) {
+                for (int och = 0; och < OUT_CHANNELS; och++) {
+                    acc_t result = bias[och];
+
+                    for (int krow = 0; krow < KERNEL_DIM; krow++) {
+                        for (int kcol = 0; kcol < KERNEL_DIM; kcol++) {
+                            for (int kch = 0; kch < IN_CHANNELS; kch++) {
+                                int irow = orow + krow - PADDING;
+                                int icol = ocol + kcol - PADDING;
+
+                                elem_t pixel = irow < 0 || irow >= IN_DIM ||
+                                    icol < 0 || icol >= IN_DIM ?
+                                    0 : input[b][irow][icol][kch];
+
+                                result += weights[krow][kcol][kch][och] * pixel;
+                            }
+                        }
+                    }
+
+                    result = ROUNDING_RIGHT_SHIFT(result, shift);
+                    result = result > elem_t_max ? elem_t_max : (result < elem_t_min ? elem_t_min : result);
+                    result = result < 0 ? 0 : result;
+
+                    output[b][orow][ocol][och] = result;
+                }
+            }
+        }
+    }
+}
+
+void init_random(elem_t * buf, int len, int range) {
+    for (elem_t * ptr = buf; ptr < buf + len; ptr++)
+        *ptr = (rand() % range) - range / 2;
+}
+
+int max_error(elem_t * a, elem_t * b, int len) {
+    int max = 0;
+    for (int i = 0; i < len; i++) {
+        int err = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+        if (err > max)
+            max = err;
+    }
+    return max;
+}
+
+static elem_t input[BATCH_SIZE][IN_DIM][IN_DIM][IN_CHANNELS];
+static elem_t weights[KERNEL_DIM][KERNEL_DIM][IN_CHANNELS][OUT_CHANNELS];
+static acc_t bias[OUT_CHANNELS];
+static elem_t gold[BATCH_SIZE][OUT_DIM][OUT_DIM][OUT_CHANNELS];
+static elem_t output[BATCH_SIZE][OUT_DIM][OUT_DIM][OUT_CHANNELS];
+static struct tiled_conv_winograd_buffers buffers;
+
+void test(int range, int shift, int max_approx_error) {
+    printf("Inputs and weights in [%d, %d), shift %d\n", -range / 2, range / 2, shift);
+
+    init_random(&input[0][0][0][0], sizeof(input) / sizeof(elem_t), range);
+    init_random(&weights[0][0][0][0], sizeof(weights) / sizeof(elem_t), range);
+    for (int och = 0; och < OUT_CHANNELS; och++)
+        bias[och] = (rand() % 512) - 256;
+
+    printf("CPU conv...\n");
+    uint64_t start_cpu = read_cycles();
+    conv(input, weights, bias, gold, shift);
+    uint64_t end_cpu = read_cycles();
+    printf("CPU conv took %llu cycles\n", (unsigned long long)(end_cpu - start_cpu));
+
+#ifdef BAREMETAL
+    enum tiled_matmul_type_t last_option = WS;
+#else
+    enum tiled_matmul_type_t last_option = CPU;
+#endif
+
+    printf("Exact Winograd conv...\n");
+    uint64_t start = read_cycles();
+    tiled_conv_winograd_auto(
+        BATCH_SIZE, IN_DIM, IN_CHANNELS,
+        OUT_CHANNELS, OUT_DIM,
+        PADDING,
+
+        (elem_t*)input,
+        (elem_t*)weights,
+        bias,
+        (elem_t*)output,
+
+        RELU, shift, 0,
+        0,
+        &buffers,
+
+        WS);
+    uint64_t end = read_cycles();
+    printf("Exact Winograd conv took %llu cycles\n", (unsigned long long)(end - start));
+
+    int err = max_error(&gold[0][0][0][0], &output[0][0][0][0], sizeof(output) / sizeof(elem_t));
+    if (err != 0) {
+        printf("Exact Winograd conv is off by up to %d\n", err);
+        exit(1);
+    }
+
+    for (enum tiled_matmul_type_t option = WS; option <= last_option; option++) {
+        printf("Approximate Winograd conv (option %d)...\n", option);
+        start = read_cycles();
+        tiled_conv_winograd_auto(
+            BATCH_SIZE, IN_DIM, IN_CHANNELS,
+            OUT_CHANNELS, OUT_DIM,
+            PADDING,
+
+            (elem_t*)input,
+            (elem_t*)weights,
+            bias,
+            (elem_t*)output,
+
+            RELU, shift, 0,
+            max_approx_error,
+            &buffers,
+
+            option);
+        end = read_cycles();
+        printf("Approximate Winograd conv took %llu cycles\n", (unsigned long long)(end - start));
+
+        err = max_error(&gold[0][0][0][0], &output[0][0][0][0], sizeof(output) / sizeof(elem_t));
+        printf("Largest error: %d\n", err);
+        if (err > max_approx_error) {
+            printf("Approximate Winograd conv is off by more than %d\n", max_approx_error);
+            exit(1);
+        }
+    }
+
+    printf("\n");
+}
+
+int main() {
+#ifndef BAREMETAL
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      perror("mlockall failed");
+      exit(1);
+    }
+#endif
+
+    gemmini_flush(0);
+
+    printf("Output dimension: %u\n\n", OUT_DIM);
+
+    test(16, SHIFT, MAX_APPROX_ERROR);
+    test(256, FULL_RANGE_SHIFT, MAX_FULL_RANGE_EXACT_ERROR);
+    test(256, FULL_RANGE_SHIFT, MAX_FULL_RANGE_APPROX_ERROR);
+
+    exit(0);
+}
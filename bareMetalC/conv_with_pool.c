@@ -519,7 +519,7 @@ int main() {
         NO_BIAS ? NULL : (acc_t*)bias,
         (elem_t*)pool_output_mat,
 
-        NO_ACTIVATION, 0, 0,
+        NO_ACTIVATION, 0, 0, NULL, NULL,
         POOL_SIZE, NO_POOL ? 0 : POOL_STRIDE, POOL_PADDING,
 
         WS);
@@ -0,0 +1,168 @@
+// See LICENSE for license details.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#ifndef BAREMETAL
+#include <sys/mman.h>
+#endif
+#include "include/gemmini_testutils.h"
+
+#define SHIFT 4
+
+#ifndef BAREMETAL
+#define MAT_DIM_I 256
+#define MAT_DIM_K 128
+#define MAT_DIM_J 128
+#define BATCH_SIZE 2
+#define IN_DIM 28
+#define IN_CHANNELS 32
+#define OUT_CHANNELS 32
+#else
+#define MAT_DIM_I 64
+#define MAT_DIM_K 32
+#define MAT_DIM_J 48
+#define BATCH_SIZE 1
+#define IN_DIM 9
+#define IN_CHANNELS 19
+#define OUT_CHANNELS 21
+#endif
+
+#define KERNEL_DIM 3
+#define PADDING 1
+#define STRIDE 1
+#define OUT_DIM ((IN_DIM + 2*PADDING - KERNEL_DIM) / STRIDE + 1)
+
+void init_random(elem_t * buf, int len) {
+    for (elem_t * ptr = buf; ptr < buf + len; ptr++)
+        *ptr = (rand() % 16) - 8;
+}
+
+int buf_is_equal(const elem_t * a, const elem_t * b, int len) {
+    for (int i = 0; i < len; i++)
+        if (a[i] != b[i])
+            return 0;
+    return 1;
+}
+
+void matmul_gold(elem_t A[MAT_DIM_I][MAT_DIM_K], elem_t B[MAT_DIM_K][MAT_DIM_J], elem_t C[MAT_DIM_I][MAT_DIM_J]) {
+    tiled_matmul_auto(MAT_DIM_I, MAT_DIM_J, MAT_DIM_K,
+            (elem_t*)A, (elem_t*)B, NULL, (elem_t*)C,
+            MAT_DIM_K, MAT_DIM_J, MAT_DIM_J, MAT_DIM_J,
+            MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+            RELU, SHIFT, 0, NULL, NULL, false,
+            CPU);
+}
+
+gemmini_token_t matmul_async(elem_t A[MAT_DIM_I][MAT_DIM_K], elem_t B[MAT_DIM_K][MAT_DIM_J], elem_t C[MAT_DIM_I][MAT_DIM_J],
+        enum tiled_matmul_type_t option) {
+    return tiled_matmul_async(MAT_DIM_I, MAT_DIM_J, MAT_DIM_K,
+            (elem_t*)A, (elem_t*)B, NULL, (elem_t*)C,
+            MAT_DIM_K, MAT_DIM_J, MAT_DIM_J, MAT_DIM_J,
+            MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+            RELU, SHIFT, 0, NULL, NULL, false,
+            option);
+}
+
+int main() {
+#ifndef BAREMETAL
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      perror("mlockall failed");
+      exit(1);
+    }
+#endif
+
+    gemmini_flush(0);
+
+    static elem_t A1[MAT_DIM_I][MAT_DIM_K] row_align(1);
+    static elem_t A2[MAT_DIM_I][MAT_DIM_K] row_align(1);
+    static elem_t B[MAT_DIM_K][MAT_DIM_J] row_align(1);
+    static elem_t C1[MAT_DIM_I][MAT_DIM_J] row_align(1);
+    static elem_t C2[MAT_DIM_I][MAT_DIM_J] row_align(1);
+    static elem_t gold1[MAT_DIM_I][MAT_DIM_J];
+    static elem_t gold2[MAT_DIM_I][MAT_DIM_J];
+
+    static elem_t input[BATCH_SIZE][IN_DIM][IN_DIM][IN_CHANNELS] row_align(1);
+    static elem_t weights[KERNEL_DIM][KERNEL_DIM][IN_CHANNELS][OUT_CHANNELS] row_align(1);
+    static acc_t bias[OUT_CHANNELS] row_align_acc(1);
+    static elem_t output[BATCH_SIZE][OUT_DIM][OUT_DIM][OUT_CHANNELS] row_align(1);
+    static elem_t conv_gold[BATCH_SIZE][OUT_DIM][OUT_DIM][OUT_CHANNELS];
+
+    init_random(&A1[0][0], sizeof(A1) / sizeof(elem_t));
+    init_random(&A2[0][0], sizeof(A2) / sizeof(elem_t));
+    init_random(&B[0][0], sizeof(B) / sizeof(elem_t));
+    init_random(&input[0][0][0][0], sizeof(input) / sizeof(elem_t));
+    init_random(&weights[0][0][0][0], sizeof(weights) / sizeof(elem_t));
+    for (int och = 0; och < OUT_CHANNELS; och++)
+        bias[och] = (rand() % 512) - 256;
+
+#ifdef BAREMETAL
+    enum tiled_matmul_type_t last_option = WS;
+#else
+    enum tiled_matmul_type_t last_option = CPU;
+#endif
+
+    for (enum tiled_matmul_type_t option = OS; option <= last_option; option++) {
+        printf("Option %d\n", option);
+
+        // Queue up two independent matmuls, and compute their golds on the CPU
+        // while Gemmini works on them
+        const gemmini_token_t token1 = matmul_async(A1, B, C1, option);
+        const gemmini_token_t token2 = matmul_async(A2, B, C2, option);
+
+        matmul_gold(A1, B, gold1);
+        matmul_gold(A2, B, gold2);
+
+        gemmini_wait(token2);
+
+        if (!gemmini_done(token1) || !gemmini_done(token2)) {
+            printf("Waiting for the second matmul didn't complete the first one\n");
+            exit(1);
+        }
+
+        if (!buf_is_equal(&C1[0][0], &gold1[0][0], sizeof(C1) / sizeof(elem_t)) ||
+                !buf_is_equal(&C2[0][0], &gold2[0][0], sizeof(C2) / sizeof(elem_t))) {
+            printf("Async matmul is incorrect\n");
+            exit(1);
+        }
+
+        // Gemmini only runs convs in WS
+        if (option == OS)
+            continue;
+
+        const gemmini_token_t token = tiled_conv_async(
+            BATCH_SIZE, IN_DIM, IN_CHANNELS,
+            OUT_CHANNELS, OUT_DIM,
+            STRIDE, PADDING, KERNEL_DIM,
+
+            (elem_t*)input, (elem_t*)weights, bias, (elem_t*)output,
+
+            RELU, SHIFT, 0, NULL, NULL,
+            1, 0, 0,
+
+            option);
+
+        tiled_conv_auto(
+            BATCH_SIZE, IN_DIM, IN_CHANNELS,
+            OUT_CHANNELS, OUT_DIM,
+            STRIDE, PADDING, KERNEL_DIM,
+
+            (elem_t*)input, (elem_t*)weights, bias, (elem_t*)conv_gold,
+
+            RELU, SHIFT, 0, NULL, NULL,
+            1, 0, 0,
+
+            CPU);
+
+        gemmini_wait(token);
+
+        if (!buf_is_equal(&output[0][0][0][0], &conv_gold[0][0][0][0], sizeof(output) / sizeof(elem_t))) {
+            printf("Async conv is incorrect\n");
+            exit(1);
+        }
+    }
+
+    exit(0);
+}
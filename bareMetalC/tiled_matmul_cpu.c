@@ -138,7 +138,7 @@ int main() {
             (elem_t*)full_A, (elem_t*)full_B, NO_BIAS ? NULL : &full_D[0][0], (elem_t*)full_C,
             MAT_DIM_K, MAT_DIM_J, MAT_DIM_J, MAT_DIM_J,
             MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
-            NO_ACTIVATION, 0, 0, false,
+            NO_ACTIVATION, 0, 0, NULL, NULL, false,
             CPU);
 
     unsigned long end = read_cycles();
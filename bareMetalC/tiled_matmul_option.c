@@ -155,7 +155,7 @@ int main() {
                     (elem_t*)full_A, (elem_t*)full_B, no_bias ? NULL : &full_D[0][0], (elem_t*)full_C,
                     MAT_DIM_K, MAT_DIM_J, MAT_DIM_J, MAT_DIM_J,
                     MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
-                    activation, shift, relu6_shift, repeating_bias,
+                    activation, shift, relu6_shift, NULL, NULL, repeating_bias,
                     option);
 
             if (!full_is_equal(full_C, gold)) {
@@ -0,0 +1,150 @@
+// See LICENSE for license details.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#ifndef BAREMETAL
+#include <sys/mman.h>
+#endif
+#include "include/gemmini_testutils.h"
+
+#ifndef BAREMETAL
+#define MAT_DIM_I 128
+#define MAT_DIM_K 96
+#define MAT_DIM_J 80
+#else
+#define MAT_DIM_I 33
+#define MAT_DIM_K 28
+#define MAT_DIM_J 40
+#endif
+
+void full_matmul(elem_t A[MAT_DIM_I][MAT_DIM_K], elem_t B[MAT_DIM_K][MAT_DIM_J], acc_t D[MAT_DIM_J],
+  full_t C_full[MAT_DIM_I][MAT_DIM_J])
+{
+  for (size_t r = 0; r < MAT_DIM_I; r++)
+    for (size_t c = 0; c < MAT_DIM_J; c++) {
+      C_full[r][c] = D[c];
+      for (size_t k = 0; k < MAT_DIM_K; k++)
+        C_full[r][c] += A[r][k]*B[k][c];
+    }
+}
+
+void full_requant(full_t full[MAT_DIM_I][MAT_DIM_J], elem_t out[MAT_DIM_I][MAT_DIM_J],
+  acc_t mult[MAT_DIM_J], uint8_t shift[MAT_DIM_J], int act)
+{
+  for (size_t r = 0; r < MAT_DIM_I; r++)
+    for (size_t c = 0; c < MAT_DIM_J; c++) {
+      // Multiply, then bitshift and round element
+      full_t shifted = ROUNDING_RIGHT_SHIFT(full[r][c] * mult[c], shift[c]);
+
+      // Saturate and cast element
+      full_t elem = shifted > elem_t_max ? elem_t_max : (shifted < elem_t_min ? elem_t_min : shifted);
+
+      if (act == RELU && elem < 0)
+        elem = 0;
+
+      out[r][c] = elem;
+    }
+}
+
+void full_printMatrix(elem_t m[MAT_DIM_I][MAT_DIM_J]) {
+  for (size_t i = 0; i < MAT_DIM_I; ++i) {
+    for (size_t j = 0; j < MAT_DIM_J; ++j)
+      printf("%d ", m[i][j]);
+    printf("\n");
+  }
+}
+
+int full_is_equal(elem_t x[MAT_DIM_I][MAT_DIM_J], elem_t y[MAT_DIM_I][MAT_DIM_J]) {
+  for (size_t i = 0; i < MAT_DIM_I; ++i)
+    for (size_t j = 0; j < MAT_DIM_J; ++j)
+      if (x[i][j] != y[i][j])
+        return 0;
+  return 1;
+}
+
+int main() {
+#ifndef BAREMETAL
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    perror("mlockall failed");
+    exit(1);
+  }
+#endif
+
+  gemmini_flush(0);
+
+#ifdef BAREMETAL
+  for (enum tiled_matmul_type_t option = OS; option <= WS; option++) {
+#else
+  for (enum tiled_matmul_type_t option = OS; option <= CPU; option++) {
+#endif
+    for (int activation = 0; activation <= 1; activation++) {
+      static elem_t full_A[MAT_DIM_I][MAT_DIM_K] row_align(1);
+      static elem_t full_B[MAT_DIM_K][MAT_DIM_J] row_align(1);
+      static elem_t full_C[MAT_DIM_I][MAT_DIM_J] row_align(1);
+      static acc_t full_D[MAT_DIM_J] row_align_acc(1);
+
+      static acc_t mult[MAT_DIM_J];
+      static uint8_t shift[MAT_DIM_J];
+
+      static full_t gold_full[MAT_DIM_I][MAT_DIM_J];
+      static elem_t gold[MAT_DIM_I][MAT_DIM_J];
+
+      for (size_t i = 0; i < MAT_DIM_I; ++i)
+        for (size_t j = 0; j < MAT_DIM_K; ++j)
+          full_A[i][j] = (rand() % 16) - 8;
+
+      for (size_t i = 0; i < MAT_DIM_K; ++i)
+        for (size_t j = 0; j < MAT_DIM_J; ++j)
+          full_B[i][j] = (rand() % 16) - 8;
+
+      for (size_t j = 0; j < MAT_DIM_J; ++j)
+        full_D[j] = (rand() % 64) - 32;
+
+      // Gemmini needs power-of-two multipliers, and one shift for every
+      // DIM-wide block of output channels. The CPU can use any scales.
+      for (size_t j = 0; j < MAT_DIM_J; ++j) {
+        if (option == CPU) {
+          mult[j] = 1 + rand() % 100;
+          shift[j] = 6 + rand() % 8;
+        } else {
+          const int block_shift = 2 + (j / DIM) % 6;
+          const int mult_log2 = rand() % 2;
+          mult[j] = 1 << mult_log2;
+          shift[j] = block_shift + mult_log2;
+        }
+      }
+
+      printf("Starting CPU matmul\n");
+      full_matmul(full_A, full_B, full_D, gold_full);
+      full_requant(gold_full, gold, mult, shift, activation);
+
+      printf("Starting gemmini matmul\n");
+      tiled_matmul_auto(MAT_DIM_I, MAT_DIM_J, MAT_DIM_K,
+              (elem_t*)full_A, (elem_t*)full_B, full_D, (elem_t*)full_C,
+              MAT_DIM_K, MAT_DIM_J, MAT_DIM_J, MAT_DIM_J,
+              MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+              activation, 0, 0, mult, shift, true,
+              option);
+
+      if (!full_is_equal(full_C, gold)) {
+        printf("\nINCORRECT!\n");
+        printf("option: %d\n", option);
+        printf("activation: %d\n", activation);
+
+        printf("C:\n");
+        full_printMatrix(full_C);
+        printf("Gold:\n");
+        full_printMatrix(gold);
+        printf("\n");
+
+        exit(1);
+      }
+    }
+  }
+
+  exit(0);
+}
+
@@ -0,0 +1,132 @@
+// See LICENSE for license details.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#ifndef BAREMETAL
+#include <sys/mman.h>
+#endif
+#include "include/gemmini_testutils.h"
+
+#define ITERATIONS 8
+#define SHIFT 4
+
+#ifndef BAREMETAL
+#define MAT_DIM_I 512
+#define MAT_DIM_K 256
+#define MAT_DIM_J 256
+#else
+#define MAT_DIM_I 128
+#define MAT_DIM_K 64
+#define MAT_DIM_J 64
+#endif
+
+void full_matmul(elem_t A[MAT_DIM_I][MAT_DIM_K], elem_t B[MAT_DIM_K][MAT_DIM_J], acc_t D[MAT_DIM_I][MAT_DIM_J], full_t C_full[MAT_DIM_I][MAT_DIM_J]) {
+  for (size_t r = 0; r < MAT_DIM_I; r++)
+    for (size_t c = 0; c < MAT_DIM_J; c++) {
+      C_full[r][c] = D[r][c];
+      for (size_t k = 0; k < MAT_DIM_K; k++)
+        C_full[r][c] += A[r][k]*B[k][c];
+    }
+}
+
+void full_printMatrix(elem_t m[MAT_DIM_I][MAT_DIM_J]) {
+  for (size_t i = 0; i < MAT_DIM_I; ++i) {
+    for (size_t j = 0; j < MAT_DIM_J; ++j)
+      printf("%d ", m[i][j]);
+    printf("\n");
+  }
+}
+
+int full_is_equal(elem_t x[MAT_DIM_I][MAT_DIM_J], elem_t y[MAT_DIM_I][MAT_DIM_J]) {
+  for (size_t i = 0; i < MAT_DIM_I; ++i)
+    for (size_t j = 0; j < MAT_DIM_J; ++j)
+      if (x[i][j] != y[i][j])
+        return 0;
+  return 1;
+}
+
+void full_matshift_relu(full_t full[MAT_DIM_I][MAT_DIM_J], elem_t out[MAT_DIM_I][MAT_DIM_J], int shift) {
+  for (size_t r = 0; r < MAT_DIM_I; r++)
+    for (size_t c = 0; c < MAT_DIM_J; c++) {
+      // Bitshift and round element
+      full_t shifted = ROUNDING_RIGHT_SHIFT(full[r][c], shift);
+
+      // Saturate and cast element
+      full_t elem = shifted > elem_t_max ? elem_t_max : (shifted < elem_t_min ? elem_t_min : shifted);
+      out[r][c] = elem < 0 ? 0 : elem;
+    }
+}
+
+int main() {
+#ifndef BAREMETAL
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      perror("mlockall failed");
+      exit(1);
+    }
+#endif
+
+    gemmini_flush(0);
+
+    static elem_t full_A[MAT_DIM_I][MAT_DIM_K] row_align(1);
+    static elem_t full_B[MAT_DIM_K][MAT_DIM_J] row_align(1);
+    static elem_t full_C[MAT_DIM_I][MAT_DIM_J] row_align(1);
+    static acc_t full_D[MAT_DIM_I][MAT_DIM_J] row_align_acc(1);
+
+    static full_t gold_full[MAT_DIM_I][MAT_DIM_J];
+    static elem_t gold[MAT_DIM_I][MAT_DIM_J];
+
+    for (size_t i = 0; i < MAT_DIM_I; ++i)
+      for (size_t j = 0; j < MAT_DIM_K; ++j)
+        full_A[i][j] = (rand() % 16) - 8;
+
+    for (size_t i = 0; i < MAT_DIM_K; ++i)
+      for (size_t j = 0; j < MAT_DIM_J; ++j)
+        full_B[i][j] = (rand() % 16) - 8;
+
+    for (size_t i = 0; i < MAT_DIM_I; ++i)
+      for (size_t j = 0; j < MAT_DIM_J; ++j)
+        full_D[i][j] = (rand() % 64) - 32;
+
+    printf("Starting slow CPU matmul\n");
+    full_matmul(full_A, full_B, full_D, gold_full);
+    full_matshift_relu(gold_full, gold, SHIFT);
+
+    printf("Gemmini + CPU threads: %d\n", (int)gemmini_num_threads());
+
+    // The split between Gemmini and the CPU is tuned as the same matmul gets
+    // repeated, so every iteration should take about as long or less than the
+    // one before it
+    for (int it = 0; it < ITERATIONS; it++) {
+      for (size_t i = 0; i < MAT_DIM_I; ++i)
+        for (size_t j = 0; j < MAT_DIM_J; ++j)
+          full_C[i][j] = 0;
+
+      unsigned long start = read_cycles();
+
+      tiled_matmul_auto(MAT_DIM_I, MAT_DIM_J, MAT_DIM_K,
+              (elem_t*)full_A, (elem_t*)full_B, &full_D[0][0], (elem_t*)full_C,
+              MAT_DIM_K, MAT_DIM_J, MAT_DIM_J, MAT_DIM_J,
+              MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+              RELU, SHIFT, 0, NULL, NULL, false,
+              WS_CPU);
+
+      unsigned long end = read_cycles();
+      printf("Iteration %d: %lu cycles, CPU share %d/%d\n", it, end-start,
+          (int)tiled_matmul_hetero_entry(MAT_DIM_I, MAT_DIM_J, MAT_DIM_K)->cpu_share, HETERO_SHARE_ONE);
+
+      if (!full_is_equal(full_C, gold)) {
+        printf("C:\n");
+        full_printMatrix(full_C);
+        printf("Gold:\n");
+        full_printMatrix(gold);
+        printf("\n");
+
+        exit(1);
+      }
+    }
+
+  exit(0);
+}
@@ -0,0 +1,323 @@
+// Runs a catalog of convolutions, across kernel sizes, strides, channel counts
+// and pooling, three ways: with tiled_conv_auto, as an im2col followed by
+// tiled_matmul_auto (and then pooling on the CPU), and with conv_cpu. Each run
+// is reported as a CSV row, with its utilization of Gemmini's DIM^2 MACs per
+// cycle, and the number of each kind of command it sent Gemmini, so that
+// changes to the tiling show up here before they show up in the models. The
+// three outputs of every conv are also checked against each other.
+//
+// Like the GEMM sweep, each Gemmini run is done twice: once with the command
+// counters on, and once with them off, which is the one that is timed.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#ifndef BAREMETAL
+#include <sys/mman.h>
+#endif
+#include "include/gemmini.h"
+#include "include/gemmini_nn.h"
+
+#ifndef GEMMINI_COUNTERS
+#error "the conv sweep needs -DGEMMINI_COUNTERS"
+#endif
+
+#define PEAK_MACS_PER_CYCLE (DIM * DIM)
+
+struct ConvShape {
+    const char * name;
+    int batch_size, in_dim, in_channels, out_channels;
+    int kernel_dim, stride, padding;
+    int pool_size, pool_stride, pool_padding; // pool_stride is 0 without pooling
+};
+
+static const struct ConvShape shapes[] = {
+    // 1x1 convs, from 64 to 2048 channels
+    {"k1_s1_c64_256", 1, 56, 64, 256, 1, 1, 0, 0, 0, 0},
+    {"k1_s1_c1024_256", 1, 14, 1024, 256, 1, 1, 0, 0, 0, 0},
+    {"k1_s1_c512_2048", 1, 7, 512, 2048, 1, 1, 0, 0, 0, 0},
+    {"k1_s1_c2048_512", 1, 7, 2048, 512, 1, 1, 0, 0, 0, 0},
+    {"k1_s2_c256_512", 1, 56, 256, 512, 1, 2, 0, 0, 0, 0},
+
+    // 3x3 convs
+    {"k3_s2_c3_32", 1, 224, 3, 32, 3, 2, 1, 0, 0, 0},
+    {"k3_s1_c64_64", 1, 56, 64, 64, 3, 1, 1, 0, 0, 0},
+    {"k3_s2_c128_128", 1, 56, 128, 128, 3, 2, 1, 0, 0, 0},
+    {"k3_s1_c256_256", 1, 14, 256, 256, 3, 1, 1, 0, 0, 0},
+    {"k3_s1_c512_512", 1, 7, 512, 512, 3, 1, 1, 0, 0, 0},
+
+    // 5x5 convs
+    {"k5_s1_c32_64", 1, 28, 32, 64, 5, 1, 2, 0, 0, 0},
+    {"k5_s2_c16_32", 1, 56, 16, 32, 5, 2, 2, 0, 0, 0},
+
+    // 7x7 convs
+    {"k7_s2_c3_64", 1, 224, 3, 64, 7, 2, 3, 0, 0, 0},
+    {"k7_s1_c64_64", 1, 14, 64, 64, 7, 1, 3, 0, 0, 0},
+
+    // Pooled convs
+    {"k7_s2_c3_64_pool3s2", 1, 224, 3, 64, 7, 2, 3, 3, 2, 1},
+    {"k3_s2_c3_32_pool3s2", 1, 224, 3, 32, 3, 2, 1, 3, 2, 1},
+    {"k3_s1_c64_64_pool2s2", 1, 56, 64, 64, 3, 1, 1, 2, 2, 0},
+    {"k1_s1_c256_128_pool2s2", 1, 28, 256, 128, 1, 1, 0, 2, 2, 0},
+};
+
+#define N_SHAPES (sizeof(shapes)/sizeof(shapes[0]))
+
+// Big enough for the largest conv in the catalog
+#define MAX_INPUT_ELEMS (1024 * 1024)
+#define MAX_WEIGHT_ELEMS (3 * 1024 * 1024)
+#define MAX_OUTPUT_ELEMS (1024 * 1024)
+#define MAX_IM2COL_ELEMS (2 * 1024 * 1024)
+#define MAX_OUT_CHANNELS 2048
+
+static elem_t input[MAX_INPUT_ELEMS] row_align(1);
+static elem_t weights[MAX_WEIGHT_ELEMS] row_align(1);
+static acc_t bias[MAX_OUT_CHANNELS] row_align_acc(1);
+static elem_t im2col_buffer[MAX_IM2COL_ELEMS] row_align(1);
+static elem_t matmul_buffer[MAX_OUTPUT_ELEMS] row_align(1);
+
+enum conv_method_t {CONV_METHOD_CONV, CONV_METHOD_MATMUL, CONV_METHOD_CPU, N_CONV_METHODS};
+static const char * method_names[] = {"conv", "matmul", "cpu"};
+
+static elem_t outputs[N_CONV_METHODS][MAX_OUTPUT_ELEMS] row_align(1);
+
+struct SweepResult {
+    uint64_t cycles, cpu_cycles;
+    struct gemmini_counters counters;
+};
+
+static uint32_t sweep_seed = 1;
+
+static void sweep_fill(elem_t * x, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        sweep_seed = sweep_seed * 1664525 + 1013904223;
+        x[i] = (int)((sweep_seed >> 24) % 16) - 8;
+    }
+}
+
+// Prints x/100 with two decimals
+static void print_hundredths(uint64_t x) {
+    printf("%llu.%02llu", (unsigned long long)(x / 100), (unsigned long long)(x % 100));
+}
+
+static int conv_out_dim(const struct ConvShape * shape) {
+    return (shape->in_dim + 2*shape->padding - shape->kernel_dim) / shape->stride + 1;
+}
+
+static int conv_pool_out_dim(const struct ConvShape * shape) {
+    const int out_dim = conv_out_dim(shape);
+    if (shape->pool_stride == 0)
+        return out_dim;
+    return (out_dim + 2*shape->pool_padding - shape->pool_size) / shape->pool_stride + 1;
+}
+
+// Keeps the outputs of random data from mostly saturating
+static size_t conv_shift(const struct ConvShape * shape) {
+    const int patch_size = shape->kernel_dim * shape->kernel_dim * shape->in_channels;
+    size_t shift = 0;
+    for (int k = 1; k < patch_size; k *= 4)
+        shift++;
+    return shift;
+}
+
+// Returns the cycles that the CPU spent on im2col and pooling in *cpu_cycles
+static void conv_with_matmul(const struct ConvShape * shape, elem_t * output, uint64_t * cpu_cycles) {
+    const int out_dim = conv_out_dim(shape);
+    const int pool_out_dim = conv_pool_out_dim(shape);
+    const bool pooled = shape->pool_stride != 0;
+
+    struct ConvParams params = {
+        .batch_size = shape->batch_size,
+        .in_dim = shape->in_dim, .out_dim = out_dim,
+        .kernel_size = shape->kernel_dim,
+        .in_channels = shape->in_channels, .out_channels = shape->out_channels,
+        .stride = shape->stride, .padding = shape->padding,
+        .bias = true,
+        .pool_size = shape->pool_size, .pool_stride = shape->pool_stride,
+        .pool_padding = shape->pool_padding, .out_dim_pooled = pool_out_dim,
+        .I = shape->batch_size * out_dim * out_dim,
+        .J = shape->out_channels,
+        .K = shape->kernel_dim * shape->kernel_dim * shape->in_channels,
+    };
+
+    uint64_t start, end;
+    *cpu_cycles = 0;
+
+    // 1x1 convs with a stride of 1 read the input as it is
+    const elem_t * A = input;
+    if (shape->kernel_dim != 1 || shape->stride != 1 || shape->padding != 0) {
+        start = read_cycles();
+        im2col_rows(shape->in_channels, params.K, input, im2col_buffer, &params);
+        end = read_cycles();
+        *cpu_cycles += end - start;
+
+        A = im2col_buffer;
+    }
+
+    elem_t * C = pooled ? matmul_buffer : output;
+
+    tiled_matmul_auto(params.I, params.J, params.K,
+        A, weights, bias, C,
+        params.K, params.J, params.J, params.J,
+        MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+        RELU, conv_shift(shape), 0, NULL, NULL, true,
+        WS);
+
+    if (pooled) {
+        start = read_cycles();
+        pool(shape->batch_size, shape->out_channels, out_dim, pool_out_dim,
+            (elem_t (*)[out_dim][out_dim][shape->out_channels]) matmul_buffer,
+            (elem_t (*)[pool_out_dim][pool_out_dim][shape->out_channels]) output,
+            &params);
+        end = read_cycles();
+        *cpu_cycles += end - start;
+    }
+}
+
+static void conv_run_once(const struct ConvShape * shape, enum conv_method_t method, elem_t * output,
+        uint64_t * cpu_cycles) {
+    *cpu_cycles = 0;
+
+    if (method == CONV_METHOD_MATMUL) {
+        conv_with_matmul(shape, output, cpu_cycles);
+        return;
+    }
+
+    tiled_conv_auto(
+        shape->batch_size, shape->in_dim, shape->in_channels,
+        shape->out_channels, conv_out_dim(shape),
+        shape->stride, shape->padding, shape->kernel_dim,
+        input, weights, bias, output,
+        RELU, conv_shift(shape), 0, NULL, NULL,
+        shape->pool_size, shape->pool_stride, shape->pool_padding,
+        method == CONV_METHOD_CPU ? CPU : WS);
+}
+
+static struct SweepResult sweep_run(const struct ConvShape * shape, enum conv_method_t method) {
+    struct SweepResult result;
+    uint64_t cpu_cycles;
+
+    memset(&result, 0, sizeof(result));
+
+    if (method != CONV_METHOD_CPU) {
+        memset(&gemmini_counters, 0, sizeof(gemmini_counters));
+        gemmini_counting = true;
+
+        conv_run_once(shape, method, outputs[method], &cpu_cycles);
+
+        gemmini_counting = false;
+        result.counters = gemmini_counters;
+    }
+
+    const uint64_t start = read_cycles();
+    conv_run_once(shape, method, outputs[method], &cpu_cycles);
+    const uint64_t end = read_cycles();
+
+    result.cycles = end - start;
+    result.cpu_cycles = cpu_cycles;
+
+    return result;
+}
+
+static void print_csv_row(const struct ConvShape * shape, const char * method_name,
+        const struct SweepResult * r) {
+    const int out_dim = conv_out_dim(shape);
+    const uint64_t macs = (uint64_t)shape->batch_size * out_dim * out_dim * shape->out_channels *
+        shape->kernel_dim * shape->kernel_dim * shape->in_channels;
+    const uint64_t cycles = r->cycles > 0 ? r->cycles : 1;
+    const uint64_t * commands = r->counters.commands;
+
+    printf("%s,%s,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%llu,%llu,%llu,",
+        shape->name, method_name,
+        shape->batch_size, shape->in_dim, shape->in_channels, shape->out_channels,
+        shape->kernel_dim, shape->stride, shape->padding,
+        shape->pool_size, shape->pool_stride, shape->pool_padding,
+        (unsigned long long)r->cycles, (unsigned long long)r->cpu_cycles, (unsigned long long)macs);
+    print_hundredths((macs * 100) / cycles);
+    printf(",");
+    print_hundredths((macs * 10000) / (cycles * PEAK_MACS_PER_CYCLE));
+    printf(",%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+        (unsigned long long)gemmini_counted_commands(&r->counters),
+        (unsigned long long)commands[k_CONFIG], (unsigned long long)commands[k_MVIN],
+        (unsigned long long)commands[k_MVOUT], (unsigned long long)commands[k_PRELOAD],
+        (unsigned long long)(commands[k_COMPUTE_PRELOADED] + commands[k_COMPUTE_ACCUMULATE]),
+        (unsigned long long)r->counters.mvin_bytes, (unsigned long long)r->counters.mvout_bytes);
+}
+
+int main (int argc, char * argv[]) {
+#ifndef BAREMETAL
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      perror("mlockall failed");
+      exit(1);
+    }
+#endif
+
+    gemmini_flush(0);
+
+    // Every method is run, unless one is picked. The outputs are only
+    // compared when they all are.
+    bool run_method[N_CONV_METHODS] = {true, true, true};
+    if (argc >= 2) {
+        bool found = false;
+        for (int m = 0; m < N_CONV_METHODS; m++) {
+            run_method[m] = strcmp(argv[1], method_names[m]) == 0;
+            found = found || run_method[m];
+        }
+
+        if (!found) {
+            printf("usage: %s [method]\n  method may be 'conv', 'matmul', or 'cpu'\n", argv[0]);
+            exit(strcmp(argv[1], "-h") == 0 ? 0 : 1);
+        }
+    }
+
+    sweep_fill(input, MAX_INPUT_ELEMS);
+    sweep_fill(weights, MAX_WEIGHT_ELEMS);
+    for (int och = 0; och < MAX_OUT_CHANNELS; och++)
+        bias[och] = (och % 64) * 16 - 512;
+
+    printf("name,method,batch_size,in_dim,in_channels,out_channels,kernel_dim,stride,padding,pool_size,pool_stride,pool_padding,cycles,cpu_cycles,macs,macs_per_cycle,compute_utilization_pct,commands,config,mvin,mvout,preload,compute,mvin_bytes,mvout_bytes\n");
+
+    bool failed = false;
+
+    for (size_t s = 0; s < N_SHAPES; s++) {
+        const struct ConvShape * shape = &shapes[s];
+        const int pool_out_dim = conv_pool_out_dim(shape);
+        const int out_dim = conv_out_dim(shape);
+        const size_t output_elems = (size_t)shape->batch_size * pool_out_dim * pool_out_dim * shape->out_channels;
+        const size_t patch_size = (size_t)shape->kernel_dim * shape->kernel_dim * shape->in_channels;
+
+        if ((size_t)shape->batch_size * shape->in_dim * shape->in_dim * shape->in_channels > MAX_INPUT_ELEMS ||
+                patch_size * shape->out_channels > MAX_WEIGHT_ELEMS ||
+                (size_t)shape->batch_size * out_dim * out_dim * shape->out_channels > MAX_OUTPUT_ELEMS ||
+                (size_t)shape->batch_size * out_dim * out_dim * patch_size > MAX_IM2COL_ELEMS ||
+                shape->out_channels > MAX_OUT_CHANNELS) {
+            printf("%s doesn't fit in the sweep's buffers\n", shape->name);
+            exit(1);
+        }
+
+        for (int m = 0; m < N_CONV_METHODS; m++) {
+            if (!run_method[m])
+                continue;
+
+            const struct SweepResult result = sweep_run(shape, m);
+            print_csv_row(shape, method_names[m], &result);
+        }
+
+        if (!run_method[CONV_METHOD_CONV] || !run_method[CONV_METHOD_MATMUL] || !run_method[CONV_METHOD_CPU])
+            continue;
+
+        for (int m = 0; m < N_CONV_METHODS; m++) {
+            if (m != CONV_METHOD_CPU && memcmp(outputs[m], outputs[CONV_METHOD_CPU], output_elems) != 0) {
+                printf("%s: the %s output doesn't match the CPU's\n", shape->name, method_names[m]);
+                failed = true;
+            }
+        }
+    }
+
+    if (failed) {
+        printf("FAIL\n");
+        exit(1);
+    }
+
+    return 0;
+}
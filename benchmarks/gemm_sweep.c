@@ -0,0 +1,325 @@
+// Runs a catalog of GEMM shapes from production models with every dataflow,
+// and reports how close each one gets to Gemmini's peak compute and to its
+// DMA bandwidth, as CSV rows and a roofline plot. The plot's lines start with
+// '#', so that the output can be read as CSV as it is.
+//
+// Each Gemmini run is done twice: once with the command counters on, to
+// count the bytes that it moves (which also warms up the caches), and once
+// with them off, which is the one that is timed. CPU runs don't move any data
+// with the DMA, so their bytes are just the bytes of A, B, D and C, and they
+// have no roof: their utilization and roofline columns are left empty, and
+// they aren't plotted.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#ifndef BAREMETAL
+#include <sys/mman.h>
+#endif
+#include "include/gemmini.h"
+#include "include/gemmini_testutils.h"
+
+#ifndef GEMMINI_COUNTERS
+#error "the GEMM sweep needs -DGEMMINI_COUNTERS"
+#endif
+
+// The width of the system bus that Gemmini's DMA moves data over
+#ifndef GEMMINI_DMA_BYTES_PER_CYCLE
+#define GEMMINI_DMA_BYTES_PER_CYCLE 16
+#endif
+
+#define PEAK_MACS_PER_CYCLE (DIM * DIM)
+
+struct GemmShape {
+    const char * name;
+    size_t I, J, K;
+};
+
+static const struct GemmShape shapes[] = {
+    // ResNet-50's convs as im2col matmuls, for one image
+    {"resnet50_conv1", 12544, 64, 147},
+    {"resnet50_conv2_1x1", 3136, 256, 64},
+    {"resnet50_conv2_3x3", 3136, 64, 576},
+    {"resnet50_conv3_3x3", 784, 128, 1152},
+    {"resnet50_conv4_3x3", 196, 256, 2304},
+    {"resnet50_conv4_1x1", 196, 1024, 256},
+    {"resnet50_conv5_3x3", 49, 512, 4608},
+    {"resnet50_conv5_1x1", 49, 2048, 512},
+
+    // The layers of the mlp1 benchmark
+    {"mlp1_fc1", 64, 2560, 832},
+    {"mlp1_fc2", 64, 2048, 2560},
+    {"mlp1_fc3", 64, 1536, 2048},
+
+    // BERT-base, on one 128-token sequence
+    {"bert_qkv", 128, 2304, 768},
+    {"bert_qk", 128, 128, 64},
+    {"bert_av", 128, 64, 128},
+    {"bert_out", 128, 768, 768},
+    {"bert_ffn1", 128, 3072, 768},
+    {"bert_ffn2", 128, 768, 3072},
+
+    // Fully-connected layers with tiny batches, which are almost GEMVs
+    {"resnet50_fc", 1, 1000, 2048},
+    {"fc_batch1", 1, 4096, 1024},
+    {"fc_batch4", 4, 1024, 4096},
+    {"fc_batch16", 16, 4096, 1024},
+};
+
+#define N_SHAPES (sizeof(shapes)/sizeof(shapes[0]))
+
+// Big enough for the largest A, B and C in the catalog
+#define MAX_A_ELEMS (2 * 1024 * 1024)
+#define MAX_B_ELEMS (4 * 1024 * 1024)
+#define MAX_C_ELEMS (1024 * 1024)
+#define MAX_J 4096
+
+static elem_t A[MAX_A_ELEMS] row_align(1);
+static elem_t B[MAX_B_ELEMS] row_align(1);
+static elem_t C[MAX_C_ELEMS] row_align(1);
+static acc_t D[MAX_J] row_align_acc(1);
+
+static const enum tiled_matmul_type_t types[] = {OS, WS, CPU};
+static const char * type_names[] = {"os", "ws", "cpu"};
+
+#define N_TYPES (sizeof(types)/sizeof(types[0]))
+
+struct SweepResult {
+    uint64_t cycles, macs, bytes, commands;
+};
+
+static struct SweepResult results[N_TYPES][N_SHAPES];
+
+static uint32_t sweep_seed = 1;
+
+static void sweep_fill(elem_t * x, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        sweep_seed = sweep_seed * 1664525 + 1013904223;
+        x[i] = (int)((sweep_seed >> 24) % 16) - 8;
+    }
+}
+
+// Prints x/100 with two decimals
+static void print_hundredths(uint64_t x) {
+    printf("%llu.%02llu", (unsigned long long)(x / 100), (unsigned long long)(x % 100));
+}
+
+static struct SweepResult sweep_run(const struct GemmShape * shape, enum tiled_matmul_type_t type) {
+    struct SweepResult result;
+
+    result.macs = (uint64_t)shape->I * shape->J * shape->K;
+    result.bytes = ((uint64_t)shape->I * shape->K + (uint64_t)shape->K * shape->J +
+        (uint64_t)shape->I * shape->J) * sizeof(elem_t) + shape->J * sizeof(acc_t);
+    result.commands = 0;
+
+    if (type != CPU) {
+        memset(&gemmini_counters, 0, sizeof(gemmini_counters));
+        gemmini_counting = true;
+
+        tiled_matmul_auto(shape->I, shape->J, shape->K,
+            A, B, D, C,
+            shape->K, shape->J, shape->J, shape->J,
+            MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+            NO_ACTIVATION, 8, 0, NULL, NULL, true,
+            type);
+
+        gemmini_counting = false;
+
+        result.bytes = gemmini_counters.mvin_bytes + gemmini_counters.mvout_bytes;
+        result.commands = gemmini_counted_commands(&gemmini_counters);
+    }
+
+    const uint64_t start = read_cycles();
+
+    tiled_matmul_auto(shape->I, shape->J, shape->K,
+        A, B, D, C,
+        shape->K, shape->J, shape->J, shape->J,
+        MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+        NO_ACTIVATION, 8, 0, NULL, NULL, true,
+        type);
+
+    const uint64_t end = read_cycles();
+
+    result.cycles = end - start;
+
+    return result;
+}
+
+static void print_csv_row(const struct GemmShape * shape, enum tiled_matmul_type_t type,
+        const char * type_name, const struct SweepResult * r) {
+    const uint64_t cycles = r->cycles > 0 ? r->cycles : 1;
+    const uint64_t intensity = (r->macs * 100) / r->bytes;
+    const uint64_t bandwidth_bound = intensity * GEMMINI_DMA_BYTES_PER_CYCLE;
+    const uint64_t roof = bandwidth_bound < PEAK_MACS_PER_CYCLE * 100 ?
+        bandwidth_bound : PEAK_MACS_PER_CYCLE * 100;
+
+    printf("%s,%s,%llu,%llu,%llu,%llu,%llu,",
+        shape->name, type_name,
+        (unsigned long long)shape->I, (unsigned long long)shape->J, (unsigned long long)shape->K,
+        (unsigned long long)r->cycles, (unsigned long long)r->macs);
+    print_hundredths((r->macs * 100) / cycles);
+    printf(",");
+    if (type != CPU)
+        print_hundredths((r->macs * 10000) / (cycles * PEAK_MACS_PER_CYCLE));
+    printf(",%llu,", (unsigned long long)r->bytes);
+    print_hundredths((r->bytes * 100) / cycles);
+    printf(",");
+    if (type != CPU)
+        print_hundredths((r->bytes * 10000) / (cycles * GEMMINI_DMA_BYTES_PER_CYCLE));
+    printf(",");
+    print_hundredths(intensity);
+    printf(",");
+    if (type != CPU)
+        print_hundredths(roof);
+    printf(",%llu\n", (unsigned long long)r->commands);
+}
+
+// floor(4 * log2(num / den)), for positive num and den
+static int log2_quarters(uint64_t num, uint64_t den) {
+    int e = 0;
+    while (num >= 2 * den) {
+        den <<= 1;
+        e++;
+    }
+    while (num < den) {
+        num <<= 1;
+        e--;
+    }
+
+    // num / den is in [1, 2) now, and 2^(1/4), 2^(2/4) and 2^(3/4) are
+    // 1.1892..., 1.4142... and 1.6818...
+    int q = 4 * e;
+    if (num * 10000 >= den * 11893) q++;
+    if (num * 10000 >= den * 14143) q++;
+    if (num * 10000 >= den * 16819) q++;
+    return q;
+}
+
+// The plot spans intensities from 2^PLOT_X_MIN to 2^(PLOT_X_MIN + PLOT_COLS/4)
+// MACs per byte, with one column per quarter-octave, and rates from
+// 2^(PLOT_Y_MAX - PLOT_ROWS/2) to 2^PLOT_Y_MAX MACs per cycle, with one row
+// per half-octave
+#define PLOT_X_MIN (-1)
+#define PLOT_COLS 52
+#define PLOT_Y_MAX 9
+#define PLOT_ROWS 26
+
+static void print_roofline(const char * type_name, const struct SweepResult * r) {
+    char grid[PLOT_ROWS][PLOT_COLS + 1];
+    const int peak_q = log2_quarters(PEAK_MACS_PER_CYCLE, 1);
+    const int bandwidth_q = log2_quarters(GEMMINI_DMA_BYTES_PER_CYCLE, 1);
+
+    for (int row = 0; row < PLOT_ROWS; row++) {
+        memset(grid[row], ' ', PLOT_COLS);
+        grid[row][PLOT_COLS] = '\0';
+    }
+
+    for (int col = 0; col < PLOT_COLS; col++) {
+        const int x_q = 4 * PLOT_X_MIN + col;
+        const bool flat = x_q + bandwidth_q >= peak_q;
+        const int roof_q = flat ? peak_q : x_q + bandwidth_q;
+        const int row = 2 * PLOT_Y_MAX - (roof_q >> 1);
+
+        if (row >= 0 && row < PLOT_ROWS)
+            grid[row][col] = flat ? '-' : '/';
+    }
+
+    for (size_t s = 0; s < N_SHAPES; s++) {
+        if (r[s].cycles == 0 || r[s].bytes == 0)
+            continue;
+
+        const int col = log2_quarters(r[s].macs, r[s].bytes) - 4 * PLOT_X_MIN;
+        const int row = 2 * PLOT_Y_MAX - (log2_quarters(r[s].macs, r[s].cycles) >> 1);
+
+        // Points that land on top of each other are drawn as a '*'
+        if (col >= 0 && col < PLOT_COLS && row >= 0 && row < PLOT_ROWS) {
+            const char c = grid[row][col];
+            const bool taken = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '*';
+            grid[row][col] = taken ? '*' : (s < 26 ? 'a' + s : 'A' + (s - 26));
+        }
+    }
+
+    printf("#\n# Roofline (%s): MACs per cycle against MACs per byte, on log scales\n#\n", type_name);
+
+    for (int row = 0; row < PLOT_ROWS; row++) {
+        // Label every octave
+        if (row % 2 == 0) {
+            const int y = PLOT_Y_MAX - row / 2;
+            if (y >= 0)
+                printf("# %6llu |%s\n", 1ULL << y, grid[row]);
+            else
+                printf("#  1/%-3llu |%s\n", 1ULL << -y, grid[row]);
+        } else {
+            printf("#        |%s\n", grid[row]);
+        }
+    }
+
+    printf("#        +");
+    for (int col = 0; col < PLOT_COLS; col++)
+        printf(col % 8 == 0 ? "+" : "-");
+    printf("\n#         ");
+    for (int col = 0; col < PLOT_COLS; col += 8) {
+        const int x = PLOT_X_MIN + col / 4;
+        if (x >= 0)
+            printf("%-8llu", 1ULL << x);
+        else
+            printf("1/%-6llu", 1ULL << -x);
+    }
+    printf("\n");
+}
+
+int main (int argc, char * argv[]) {
+#ifndef BAREMETAL
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      perror("mlockall failed");
+      exit(1);
+    }
+#endif
+
+    gemmini_flush(0);
+
+    // Every dataflow is swept, unless one is picked
+    bool run_type[N_TYPES] = {true, true, true};
+    if (argc >= 2) {
+        bool found = false;
+        for (size_t t = 0; t < N_TYPES; t++) {
+            run_type[t] = strcmp(argv[1], type_names[t]) == 0;
+            found = found || run_type[t];
+        }
+
+        if (!found) {
+            printf("usage: %s [matmul_option]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
+            exit(strcmp(argv[1], "-h") == 0 ? 0 : 1);
+        }
+    }
+
+    sweep_fill(A, MAX_A_ELEMS);
+    sweep_fill(B, MAX_B_ELEMS);
+    for (size_t j = 0; j < MAX_J; j++)
+        D[j] = (int)(j % 256) - 128;
+
+    printf("name,type,I,J,K,cycles,macs,macs_per_cycle,compute_utilization_pct,bytes,bytes_per_cycle,bandwidth_utilization_pct,macs_per_byte,roofline_macs_per_cycle,commands\n");
+
+    for (size_t t = 0; t < N_TYPES; t++) {
+        if (!run_type[t])
+            continue;
+
+        for (size_t s = 0; s < N_SHAPES; s++) {
+            results[t][s] = sweep_run(&shapes[s], types[t]);
+            print_csv_row(&shapes[s], types[t], type_names[t], &results[t][s]);
+        }
+    }
+
+    printf("#\n# Peak: %d MACs per cycle (DIM^2), %d bytes per cycle (DMA)\n",
+        PEAK_MACS_PER_CYCLE, GEMMINI_DMA_BYTES_PER_CYCLE);
+    for (size_t s = 0; s < N_SHAPES; s++)
+        printf("# %c: %s\n", s < 26 ? 'a' + (int)s : 'A' + (int)(s - 26), shapes[s].name);
+
+    // Gemmini's roof says nothing about the CPU, so only its dataflows are
+    // plotted
+    for (size_t t = 0; t < N_TYPES; t++)
+        if (run_type[t] && types[t] != CPU)
+            print_roofline(type_names[t], results[t]);
+
+    return 0;
+}
@@ -6,6 +6,8 @@
 #endif
 #include "include/gemmini.h"
 #include "include/gemmini_nn.h"
+#include "include/gemmini_net.h"
+#include "include/gemmini_model.h"
 
 #include "mobilenet_params.h"
 #include "images.h"
@@ -20,6 +22,16 @@ int main (int argc, char * argv[]) {
 
     gemmini_flush(0);
 
+#ifndef BAREMETAL
+    // "export path" writes the model to a file that the model runner can load,
+    // instead of running it
+    const char * export_path = NULL;
+    if (argc == 3 && strcmp(argv[1], "export") == 0) {
+        export_path = argv[2];
+        argc = 1;
+    }
+#endif
+
     enum tiled_matmul_type_t tiled_matmul_type;
     if (argc < 2) {
         tiled_matmul_type = WS;
@@ -30,24 +42,29 @@ int main (int argc, char * argv[]) {
     } else if (strcmp(argv[1], "ws") == 0) {
         tiled_matmul_type = WS;
     } else if (strcmp(argv[1], "-h") == 0) {
-        printf("usage: %s [-h] matmul_option [check]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
+        printf("usage: %s [-h] matmul_option [check [golden_cache]]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
         exit(0);
     } else {
         printf("Unknown command-line argument\n");
-        printf("usage: %s [-h] matmul_option [check]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
+        printf("usage: %s [-h] matmul_option [check [golden_cache]]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
         exit(1);
     }
 
-    bool conv;
+    // "auto" times every conv each way in a calibration run first, and then
+    // runs each one the fastest way
+    bool conv, select_strategies = false;
     if (argc < 3) {
         conv = false;
     } else if (strcmp(argv[2], "conv") == 0) {
         conv = true;
     } else if (strcmp(argv[2], "matmul") == 0) {
         conv = false;
+    } else if (strcmp(argv[2], "auto") == 0) {
+        conv = false;
+        select_strategies = true;
     } else {
         printf("Unknown command-line argument\n");
-        printf("usage: %s [-h] matmul_option [check] [conv]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
+        printf("usage: %s [-h] matmul_option [conv|matmul|auto] [check [golden_cache]]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
         exit(1);
     }
 
@@ -58,1213 +75,305 @@ int main (int argc, char * argv[]) {
         check = true;
     } else {
         printf("Unknown command-line argument\n");
-        printf("usage: %s [-h] matmul_option [check]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
+        printf("usage: %s [-h] matmul_option [check [golden_cache]]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
         exit(1);
     }
 
-    uint64_t start, end;
-    uint64_t im2col_cycles = 0, matmul_cycles = 0, conv_cycles = 0, pool_cycles = 0, conv_dw_cycles = 0, res_add_cycles = 0, other_cycles = 0;
-
-    // conv_1
-    if (!conv) {
-      start = read_cycles();
-
-        im2col(conv_1_params.batch_size, conv_1_params.in_channels, conv_1_params.in_dim,
-            conv_1_params.I, conv_1_params.K,
-            images, conv_1_in, &conv_1_params);
-
-        end = read_cycles();
-        im2col_cycles += end - start;
-
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_1_params.I, conv_1_params.J, conv_1_params.K,
-            conv_1_in, conv_1_w, conv_1_b, conv_1_out,
-            RELU, conv_1_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_1");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_conv_auto(
-            conv_1_params.batch_size, conv_1_params.in_dim, conv_1_params.in_channels,
-            conv_1_params.out_channels, conv_1_params.out_dim,
-            conv_1_params.stride, conv_1_params.padding, conv_1_params.kernel_size,
-
-            (elem_t*)images, (elem_t*)conv_1_w, (acc_t*)conv_1_b, (elem_t*)conv_1_out,
-
-            RELU, conv_1_params.output_scale, 0,
-            conv_1_params.pool_size, 0, conv_1_params.pool_padding,
-
-            tiled_matmul_type);
-
-        end = read_cycles();
-        conv_cycles += end - start;
-    }
-
-    // conv_dw_2
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_1_params.I, conv_1_params.J, conv_dw_2_params.I, conv_dw_2_params.J,
-        conv_dw_2_params.batch_size, conv_dw_2_params.in_channels, conv_dw_2_params.out_dim, conv_dw_2_params.kernel_size,
-        conv_1_out, conv_dw_2_w, conv_dw_2_b, conv_dw_2_out, &conv_dw_2_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_3
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_3_params.I, conv_3_params.J, conv_3_params.K,
-            conv_dw_2_out, conv_3_w, conv_3_b, conv_3_out,
-            NO_ACTIVATION, conv_3_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_3");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_3_params.I, conv_3_params.J, conv_3_params.K,
-            conv_dw_2_out, conv_3_w, conv_3_b, conv_3_out,
-            NO_ACTIVATION, conv_3_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_3");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_4
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_4_params.I, conv_4_params.J, conv_4_params.K,
-            conv_3_out, conv_4_w, conv_4_b, conv_4_out,
-            RELU, conv_4_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_4");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_4_params.I, conv_4_params.J, conv_4_params.K,
-            conv_3_out, conv_4_w, conv_4_b, conv_4_out,
-            RELU, conv_4_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_4");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_5
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_4_params.I, conv_4_params.J, conv_dw_5_params.I, conv_dw_5_params.J,
-        conv_dw_5_params.batch_size, conv_dw_5_params.in_channels, conv_dw_5_params.out_dim, conv_dw_5_params.kernel_size,
-        conv_4_out, conv_dw_5_w, conv_dw_5_b, conv_dw_5_out, &conv_dw_5_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_6
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_6_params.I, conv_6_params.J, conv_6_params.K,
-            conv_dw_5_out, conv_6_w, conv_6_b, conv_6_out,
-            NO_ACTIVATION, conv_6_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_6");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_6_params.I, conv_6_params.J, conv_6_params.K,
-            conv_dw_5_out, conv_6_w, conv_6_b, conv_6_out,
-            NO_ACTIVATION, conv_6_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_6");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_7
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_7_params.I, conv_7_params.J, conv_7_params.K,
-            conv_6_out, conv_7_w, conv_7_b, conv_7_out,
-            RELU, conv_7_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_7");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_7_params.I, conv_7_params.J, conv_7_params.K,
-            conv_6_out, conv_7_w, conv_7_b, conv_7_out,
-            RELU, conv_7_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_7");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_8
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_7_params.I, conv_7_params.J, conv_dw_8_params.I, conv_dw_8_params.J,
-        conv_dw_8_params.batch_size, conv_dw_8_params.in_channels, conv_dw_8_params.out_dim, conv_dw_8_params.kernel_size,
-        conv_7_out, conv_dw_8_w, conv_dw_8_b, conv_dw_8_out, &conv_dw_8_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_9
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_9_params.I, conv_9_params.J, conv_9_params.K,
-            conv_dw_8_out, conv_9_w, conv_9_b, conv_9_out,
-            NO_ACTIVATION, conv_9_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_9");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_9_params.I, conv_9_params.J, conv_9_params.K,
-            conv_dw_8_out, conv_9_w, conv_9_b, conv_9_out,
-            NO_ACTIVATION, conv_9_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_9");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // Add residuals
-    start = read_cycles();
-
-    tiled_resadd_auto(conv_9_params.I, conv_9_params.J,
-        conv_9_params.res_scale,
-        conv_6_out,
-        conv_9_out,
-        conv_9_out,
-        false,
-        tiled_matmul_type == CPU ? CPU : WS);
-
-    end = read_cycles();
-    res_add_cycles += end - start;
-    
-    // conv_10
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_10_params.I, conv_10_params.J, conv_10_params.K,
-            conv_9_out, conv_10_w, conv_10_b, conv_10_out,
-            RELU, conv_10_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_10");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_10_params.I, conv_10_params.J, conv_10_params.K,
-            conv_9_out, conv_10_w, conv_10_b, conv_10_out,
-            RELU, conv_10_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_10");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_11
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_10_params.I, conv_10_params.J, conv_dw_11_params.I, conv_dw_11_params.J,
-        conv_dw_11_params.batch_size, conv_dw_11_params.in_channels, conv_dw_11_params.out_dim, conv_dw_11_params.kernel_size,
-        conv_10_out, conv_dw_11_w, conv_dw_11_b, conv_dw_11_out, &conv_dw_11_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_12
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_12_params.I, conv_12_params.J, conv_12_params.K,
-            conv_dw_11_out, conv_12_w, conv_12_b, conv_12_out,
-            NO_ACTIVATION, conv_12_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_12");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_12_params.I, conv_12_params.J, conv_12_params.K,
-            conv_dw_11_out, conv_12_w, conv_12_b, conv_12_out,
-            NO_ACTIVATION, conv_12_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_12");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_13
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_13_params.I, conv_13_params.J, conv_13_params.K,
-            conv_12_out, conv_13_w, conv_13_b, conv_13_out,
-            RELU, conv_13_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_13");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_13_params.I, conv_13_params.J, conv_13_params.K,
-            conv_12_out, conv_13_w, conv_13_b, conv_13_out,
-            RELU, conv_13_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_13");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_14
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_13_params.I, conv_13_params.J, conv_dw_14_params.I, conv_dw_14_params.J,
-        conv_dw_14_params.batch_size, conv_dw_14_params.in_channels, conv_dw_14_params.out_dim, conv_dw_14_params.kernel_size,
-        conv_13_out, conv_dw_14_w, conv_dw_14_b, conv_dw_14_out, &conv_dw_14_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_15
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_15_params.I, conv_15_params.J, conv_15_params.K,
-            conv_dw_14_out, conv_15_w, conv_15_b, conv_15_out,
-            NO_ACTIVATION, conv_15_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_15");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_15_params.I, conv_15_params.J, conv_15_params.K,
-            conv_dw_14_out, conv_15_w, conv_15_b, conv_15_out,
-            NO_ACTIVATION, conv_15_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_15");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // Add residuals
-    start = read_cycles();
-
-    tiled_resadd_auto(conv_15_params.I, conv_15_params.J,
-        conv_15_params.res_scale,
-        conv_12_out,
-        conv_15_out,
-        conv_15_out,
-        false,
-        tiled_matmul_type == CPU ? CPU : WS);
-
-    end = read_cycles();
-    res_add_cycles += end - start;
-    
-    // conv_16
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_16_params.I, conv_16_params.J, conv_16_params.K,
-            conv_15_out, conv_16_w, conv_16_b, conv_16_out,
-            RELU, conv_16_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_16");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_16_params.I, conv_16_params.J, conv_16_params.K,
-            conv_15_out, conv_16_w, conv_16_b, conv_16_out,
-            RELU, conv_16_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_16");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_17
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_16_params.I, conv_16_params.J, conv_dw_17_params.I, conv_dw_17_params.J,
-        conv_dw_17_params.batch_size, conv_dw_17_params.in_channels, conv_dw_17_params.out_dim, conv_dw_17_params.kernel_size,
-        conv_16_out, conv_dw_17_w, conv_dw_17_b, conv_dw_17_out, &conv_dw_17_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_18
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_18_params.I, conv_18_params.J, conv_18_params.K,
-            conv_dw_17_out, conv_18_w, conv_18_b, conv_18_out,
-            NO_ACTIVATION, conv_18_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_18");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_18_params.I, conv_18_params.J, conv_18_params.K,
-            conv_dw_17_out, conv_18_w, conv_18_b, conv_18_out,
-            NO_ACTIVATION, conv_18_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_18");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // Add residuals
-    start = read_cycles();
-
-    tiled_resadd_auto(conv_18_params.I, conv_18_params.J,
-        conv_18_params.res_scale,
-        conv_15_out,
-        conv_18_out,
-        conv_18_out,
-        false,
-        tiled_matmul_type == CPU ? CPU : WS);
-
-    end = read_cycles();
-    res_add_cycles += end - start;
-    
-    // conv_19
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_19_params.I, conv_19_params.J, conv_19_params.K,
-            conv_18_out, conv_19_w, conv_19_b, conv_19_out,
-            RELU, conv_19_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_19");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_19_params.I, conv_19_params.J, conv_19_params.K,
-            conv_18_out, conv_19_w, conv_19_b, conv_19_out,
-            RELU, conv_19_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_19");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_20
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_19_params.I, conv_19_params.J, conv_dw_20_params.I, conv_dw_20_params.J,
-        conv_dw_20_params.batch_size, conv_dw_20_params.in_channels, conv_dw_20_params.out_dim, conv_dw_20_params.kernel_size,
-        conv_19_out, conv_dw_20_w, conv_dw_20_b, conv_dw_20_out, &conv_dw_20_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_21
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_21_params.I, conv_21_params.J, conv_21_params.K,
-            conv_dw_20_out, conv_21_w, conv_21_b, conv_21_out,
-            NO_ACTIVATION, conv_21_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_21");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_21_params.I, conv_21_params.J, conv_21_params.K,
-            conv_dw_20_out, conv_21_w, conv_21_b, conv_21_out,
-            NO_ACTIVATION, conv_21_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_21");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_22
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_22_params.I, conv_22_params.J, conv_22_params.K,
-            conv_21_out, conv_22_w, conv_22_b, conv_22_out,
-            RELU, conv_22_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_22");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_22_params.I, conv_22_params.J, conv_22_params.K,
-            conv_21_out, conv_22_w, conv_22_b, conv_22_out,
-            RELU, conv_22_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_22");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_23
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_22_params.I, conv_22_params.J, conv_dw_23_params.I, conv_dw_23_params.J,
-        conv_dw_23_params.batch_size, conv_dw_23_params.in_channels, conv_dw_23_params.out_dim, conv_dw_23_params.kernel_size,
-        conv_22_out, conv_dw_23_w, conv_dw_23_b, conv_dw_23_out, &conv_dw_23_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_24
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_24_params.I, conv_24_params.J, conv_24_params.K,
-            conv_dw_23_out, conv_24_w, conv_24_b, conv_24_out,
-            NO_ACTIVATION, conv_24_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_24");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_24_params.I, conv_24_params.J, conv_24_params.K,
-            conv_dw_23_out, conv_24_w, conv_24_b, conv_24_out,
-            NO_ACTIVATION, conv_24_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_24");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // Add residuals
-    start = read_cycles();
-
-    tiled_resadd_auto(conv_24_params.I, conv_24_params.J,
-        conv_24_params.res_scale,
-        conv_21_out,
-        conv_24_out,
-        conv_24_out,
-        false,
-        tiled_matmul_type == CPU ? CPU : WS);
-
-    end = read_cycles();
-    res_add_cycles += end - start;
-    
-    // conv_25
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_25_params.I, conv_25_params.J, conv_25_params.K,
-            conv_24_out, conv_25_w, conv_25_b, conv_25_out,
-            RELU, conv_25_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_25");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_25_params.I, conv_25_params.J, conv_25_params.K,
-            conv_24_out, conv_25_w, conv_25_b, conv_25_out,
-            RELU, conv_25_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_25");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_26
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_25_params.I, conv_25_params.J, conv_dw_26_params.I, conv_dw_26_params.J,
-        conv_dw_26_params.batch_size, conv_dw_26_params.in_channels, conv_dw_26_params.out_dim, conv_dw_26_params.kernel_size,
-        conv_25_out, conv_dw_26_w, conv_dw_26_b, conv_dw_26_out, &conv_dw_26_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_27
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_27_params.I, conv_27_params.J, conv_27_params.K,
-            conv_dw_26_out, conv_27_w, conv_27_b, conv_27_out,
-            NO_ACTIVATION, conv_27_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_27");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_27_params.I, conv_27_params.J, conv_27_params.K,
-            conv_dw_26_out, conv_27_w, conv_27_b, conv_27_out,
-            NO_ACTIVATION, conv_27_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_27");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // Add residuals
-    start = read_cycles();
-
-    tiled_resadd_auto(conv_27_params.I, conv_27_params.J,
-        conv_27_params.res_scale,
-        conv_24_out,
-        conv_27_out,
-        conv_27_out,
-        false,
-        tiled_matmul_type == CPU ? CPU : WS);
-
-    end = read_cycles();
-    res_add_cycles += end - start;
-    
-    // conv_28
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_28_params.I, conv_28_params.J, conv_28_params.K,
-            conv_27_out, conv_28_w, conv_28_b, conv_28_out,
-            RELU, conv_28_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_28");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_28_params.I, conv_28_params.J, conv_28_params.K,
-            conv_27_out, conv_28_w, conv_28_b, conv_28_out,
-            RELU, conv_28_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_28");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_29
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_28_params.I, conv_28_params.J, conv_dw_29_params.I, conv_dw_29_params.J,
-        conv_dw_29_params.batch_size, conv_dw_29_params.in_channels, conv_dw_29_params.out_dim, conv_dw_29_params.kernel_size,
-        conv_28_out, conv_dw_29_w, conv_dw_29_b, conv_dw_29_out, &conv_dw_29_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_30
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_30_params.I, conv_30_params.J, conv_30_params.K,
-            conv_dw_29_out, conv_30_w, conv_30_b, conv_30_out,
-            NO_ACTIVATION, conv_30_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_30");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_30_params.I, conv_30_params.J, conv_30_params.K,
-            conv_dw_29_out, conv_30_w, conv_30_b, conv_30_out,
-            NO_ACTIVATION, conv_30_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_30");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // Add residuals
-    start = read_cycles();
-
-    tiled_resadd_auto(conv_30_params.I, conv_30_params.J,
-        conv_30_params.res_scale,
-        conv_27_out,
-        conv_30_out,
-        conv_30_out,
-        false,
-        tiled_matmul_type == CPU ? CPU : WS);
-
-    end = read_cycles();
-    res_add_cycles += end - start;
-    
-    // conv_31
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_31_params.I, conv_31_params.J, conv_31_params.K,
-            conv_30_out, conv_31_w, conv_31_b, conv_31_out,
-            RELU, conv_31_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_31");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_31_params.I, conv_31_params.J, conv_31_params.K,
-            conv_30_out, conv_31_w, conv_31_b, conv_31_out,
-            RELU, conv_31_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_31");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_32
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_31_params.I, conv_31_params.J, conv_dw_32_params.I, conv_dw_32_params.J,
-        conv_dw_32_params.batch_size, conv_dw_32_params.in_channels, conv_dw_32_params.out_dim, conv_dw_32_params.kernel_size,
-        conv_31_out, conv_dw_32_w, conv_dw_32_b, conv_dw_32_out, &conv_dw_32_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_33
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_33_params.I, conv_33_params.J, conv_33_params.K,
-            conv_dw_32_out, conv_33_w, conv_33_b, conv_33_out,
-            NO_ACTIVATION, conv_33_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_33");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_33_params.I, conv_33_params.J, conv_33_params.K,
-            conv_dw_32_out, conv_33_w, conv_33_b, conv_33_out,
-            NO_ACTIVATION, conv_33_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_33");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_34
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_34_params.I, conv_34_params.J, conv_34_params.K,
-            conv_33_out, conv_34_w, conv_34_b, conv_34_out,
-            RELU, conv_34_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_34");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_34_params.I, conv_34_params.J, conv_34_params.K,
-            conv_33_out, conv_34_w, conv_34_b, conv_34_out,
-            RELU, conv_34_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_34");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_35
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_34_params.I, conv_34_params.J, conv_dw_35_params.I, conv_dw_35_params.J,
-        conv_dw_35_params.batch_size, conv_dw_35_params.in_channels, conv_dw_35_params.out_dim, conv_dw_35_params.kernel_size,
-        conv_34_out, conv_dw_35_w, conv_dw_35_b, conv_dw_35_out, &conv_dw_35_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_36
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_36_params.I, conv_36_params.J, conv_36_params.K,
-            conv_dw_35_out, conv_36_w, conv_36_b, conv_36_out,
-            NO_ACTIVATION, conv_36_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_36");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_36_params.I, conv_36_params.J, conv_36_params.K,
-            conv_dw_35_out, conv_36_w, conv_36_b, conv_36_out,
-            NO_ACTIVATION, conv_36_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_36");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // Add residuals
-    start = read_cycles();
-
-    tiled_resadd_auto(conv_36_params.I, conv_36_params.J,
-        conv_36_params.res_scale,
-        conv_33_out,
-        conv_36_out,
-        conv_36_out,
-        false,
-        tiled_matmul_type == CPU ? CPU : WS);
-
-    end = read_cycles();
-    res_add_cycles += end - start;
-    
-    // conv_37
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_37_params.I, conv_37_params.J, conv_37_params.K,
-            conv_36_out, conv_37_w, conv_37_b, conv_37_out,
-            RELU, conv_37_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_37");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_37_params.I, conv_37_params.J, conv_37_params.K,
-            conv_36_out, conv_37_w, conv_37_b, conv_37_out,
-            RELU, conv_37_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_37");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_38
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_37_params.I, conv_37_params.J, conv_dw_38_params.I, conv_dw_38_params.J,
-        conv_dw_38_params.batch_size, conv_dw_38_params.in_channels, conv_dw_38_params.out_dim, conv_dw_38_params.kernel_size,
-        conv_37_out, conv_dw_38_w, conv_dw_38_b, conv_dw_38_out, &conv_dw_38_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_39
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_39_params.I, conv_39_params.J, conv_39_params.K,
-            conv_dw_38_out, conv_39_w, conv_39_b, conv_39_out,
-            NO_ACTIVATION, conv_39_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_39");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_39_params.I, conv_39_params.J, conv_39_params.K,
-            conv_dw_38_out, conv_39_w, conv_39_b, conv_39_out,
-            NO_ACTIVATION, conv_39_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_39");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // Add residuals
-    start = read_cycles();
-
-    tiled_resadd_auto(conv_39_params.I, conv_39_params.J,
-        conv_39_params.res_scale,
-        conv_36_out,
-        conv_39_out,
-        conv_39_out,
-        false,
-        tiled_matmul_type == CPU ? CPU : WS);
-
-    end = read_cycles();
-    res_add_cycles += end - start;
-    
-    // conv_40
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_40_params.I, conv_40_params.J, conv_40_params.K,
-            conv_39_out, conv_40_w, conv_40_b, conv_40_out,
-            RELU, conv_40_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_40");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_40_params.I, conv_40_params.J, conv_40_params.K,
-            conv_39_out, conv_40_w, conv_40_b, conv_40_out,
-            RELU, conv_40_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_40");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_41
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_40_params.I, conv_40_params.J, conv_dw_41_params.I, conv_dw_41_params.J,
-        conv_dw_41_params.batch_size, conv_dw_41_params.in_channels, conv_dw_41_params.out_dim, conv_dw_41_params.kernel_size,
-        conv_40_out, conv_dw_41_w, conv_dw_41_b, conv_dw_41_out, &conv_dw_41_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_42
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_42_params.I, conv_42_params.J, conv_42_params.K,
-            conv_dw_41_out, conv_42_w, conv_42_b, conv_42_out,
-            NO_ACTIVATION, conv_42_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_42");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_42_params.I, conv_42_params.J, conv_42_params.K,
-            conv_dw_41_out, conv_42_w, conv_42_b, conv_42_out,
-            NO_ACTIVATION, conv_42_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_42");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_43
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_43_params.I, conv_43_params.J, conv_43_params.K,
-            conv_42_out, conv_43_w, conv_43_b, conv_43_out,
-            RELU, conv_43_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_43");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_43_params.I, conv_43_params.J, conv_43_params.K,
-            conv_42_out, conv_43_w, conv_43_b, conv_43_out,
-            RELU, conv_43_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_43");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_44
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_43_params.I, conv_43_params.J, conv_dw_44_params.I, conv_dw_44_params.J,
-        conv_dw_44_params.batch_size, conv_dw_44_params.in_channels, conv_dw_44_params.out_dim, conv_dw_44_params.kernel_size,
-        conv_43_out, conv_dw_44_w, conv_dw_44_b, conv_dw_44_out, &conv_dw_44_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_45
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_45_params.I, conv_45_params.J, conv_45_params.K,
-            conv_dw_44_out, conv_45_w, conv_45_b, conv_45_out,
-            NO_ACTIVATION, conv_45_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_45");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_45_params.I, conv_45_params.J, conv_45_params.K,
-            conv_dw_44_out, conv_45_w, conv_45_b, conv_45_out,
-            NO_ACTIVATION, conv_45_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_45");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // Add residuals
-    start = read_cycles();
-
-    tiled_resadd_auto(conv_45_params.I, conv_45_params.J,
-        conv_45_params.res_scale,
-        conv_42_out,
-        conv_45_out,
-        conv_45_out,
-        false,
-        tiled_matmul_type == CPU ? CPU : WS);
-
-    end = read_cycles();
-    res_add_cycles += end - start;
-    
-    // conv_46
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_46_params.I, conv_46_params.J, conv_46_params.K,
-            conv_45_out, conv_46_w, conv_46_b, conv_46_out,
-            RELU, conv_46_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_46");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_46_params.I, conv_46_params.J, conv_46_params.K,
-            conv_45_out, conv_46_w, conv_46_b, conv_46_out,
-            RELU, conv_46_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_46");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_47
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_46_params.I, conv_46_params.J, conv_dw_47_params.I, conv_dw_47_params.J,
-        conv_dw_47_params.batch_size, conv_dw_47_params.in_channels, conv_dw_47_params.out_dim, conv_dw_47_params.kernel_size,
-        conv_46_out, conv_dw_47_w, conv_dw_47_b, conv_dw_47_out, &conv_dw_47_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_48
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_48_params.I, conv_48_params.J, conv_48_params.K,
-            conv_dw_47_out, conv_48_w, conv_48_b, conv_48_out,
-            NO_ACTIVATION, conv_48_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_48");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_48_params.I, conv_48_params.J, conv_48_params.K,
-            conv_dw_47_out, conv_48_w, conv_48_b, conv_48_out,
-            NO_ACTIVATION, conv_48_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_48");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // Add residuals
-    start = read_cycles();
-
-    tiled_resadd_auto(conv_48_params.I, conv_48_params.J,
-        conv_48_params.res_scale,
-        conv_45_out,
-        conv_48_out,
-        conv_48_out,
-        false,
-        tiled_matmul_type == CPU ? CPU : WS);
-
-    end = read_cycles();
-    res_add_cycles += end - start;
-    
-    // conv_49
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_49_params.I, conv_49_params.J, conv_49_params.K,
-            conv_48_out, conv_49_w, conv_49_b, conv_49_out,
-            RELU, conv_49_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_49");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_49_params.I, conv_49_params.J, conv_49_params.K,
-            conv_48_out, conv_49_w, conv_49_b, conv_49_out,
-            RELU, conv_49_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_49");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-    }
-
-    // conv_dw_50
-    start = read_cycles();
-
-    conv_dw_with_col2im(conv_49_params.I, conv_49_params.J, conv_dw_50_params.I, conv_dw_50_params.J,
-        conv_dw_50_params.batch_size, conv_dw_50_params.in_channels, conv_dw_50_params.out_dim, conv_dw_50_params.kernel_size,
-        conv_49_out, conv_dw_50_w, conv_dw_50_b, conv_dw_50_out, &conv_dw_50_params);
-
-    end = read_cycles();
-    conv_dw_cycles += end - start;
-
-    // conv_51
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_51_params.I, conv_51_params.J, conv_51_params.K,
-            conv_dw_50_out, conv_51_w, conv_51_b, conv_51_out,
-            NO_ACTIVATION, conv_51_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_51");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_51_params.I, conv_51_params.J, conv_51_params.K,
-            conv_dw_50_out, conv_51_w, conv_51_b, conv_51_out,
-            NO_ACTIVATION, conv_51_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_51");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
+#ifndef BAREMETAL
+    // Check mode can compare against a golden cache instead of checksums
+    const char * golden_path = NULL;
+    if (argc >= 5 && check) {
+        golden_path = argv[4];
+        if (!golden_open(golden_path))
+            exit(1);
+    } else if (argc >= 5) {
+        printf("Unknown command-line argument\n");
+        exit(1);
     }
+#endif
 
-    // conv_52
-    if (!conv) {
-        start = read_cycles();
-
-        tiled_matmul_nn_auto(conv_52_params.I, conv_52_params.J, conv_52_params.K,
-            conv_51_out, conv_52_w, conv_52_b, conv_52_out,
-            RELU, conv_52_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_52");
-
-        end = read_cycles();
-        matmul_cycles += end - start;
-
-    } else {
-        start = read_cycles();
+    // Every activation except the input images and the final predictions only
+    // gets memory once net_plan_arena() places it
+    static struct {
+        NetActivation conv_1_in, conv_1_out, conv_dw_2_out, conv_3_out, conv_4_out, conv_dw_5_out,
+            conv_6_out, conv_7_out, conv_dw_8_out, conv_9_out, conv_10_out, conv_dw_11_out,
+            conv_12_out, conv_13_out, conv_dw_14_out, conv_15_out, conv_16_out, conv_dw_17_out,
+            conv_18_out, conv_19_out, conv_dw_20_out, conv_21_out, conv_22_out, conv_dw_23_out,
+            conv_24_out, conv_25_out, conv_dw_26_out, conv_27_out, conv_28_out, conv_dw_29_out,
+            conv_30_out, conv_31_out, conv_dw_32_out, conv_33_out, conv_34_out, conv_dw_35_out,
+            conv_36_out, conv_37_out, conv_dw_38_out, conv_39_out, conv_40_out, conv_dw_41_out,
+            conv_42_out, conv_43_out, conv_dw_44_out, conv_45_out, conv_46_out, conv_dw_47_out,
+            conv_48_out, conv_49_out, conv_dw_50_out, conv_51_out, conv_52_out, average;
+    } act;
+
+    struct NetLayer layers[] = {
+        // conv_1
+        {.type = NET_CONV, .name = "conv_1", .conv_params = &conv_1_params,
+            .input = images, .weights = conv_1_w, .bias = conv_1_b, .output = &act.conv_1_out,
+            .act = RELU, .im2col_buffer = &act.conv_1_in},
+        // conv_dw_2
+        {.type = NET_CONV_DW, .name = "conv_dw_2", .conv_params = &conv_dw_2_params,
+            .input = &act.conv_1_out, .weights = conv_dw_2_w, .bias = conv_dw_2_b, .output = &act.conv_dw_2_out},
+        // conv_3
+        {.type = NET_CONV, .name = "conv_3", .conv_params = &conv_3_params,
+            .input = &act.conv_dw_2_out, .weights = conv_3_w, .bias = conv_3_b, .output = &act.conv_3_out,
+            .act = NO_ACTIVATION},
+        // conv_4
+        {.type = NET_CONV, .name = "conv_4", .conv_params = &conv_4_params,
+            .input = &act.conv_3_out, .weights = conv_4_w, .bias = conv_4_b, .output = &act.conv_4_out,
+            .act = RELU},
+        // conv_dw_5
+        {.type = NET_CONV_DW, .name = "conv_dw_5", .conv_params = &conv_dw_5_params,
+            .input = &act.conv_4_out, .weights = conv_dw_5_w, .bias = conv_dw_5_b, .output = &act.conv_dw_5_out},
+        // conv_6
+        {.type = NET_CONV, .name = "conv_6", .conv_params = &conv_6_params,
+            .input = &act.conv_dw_5_out, .weights = conv_6_w, .bias = conv_6_b, .output = &act.conv_6_out,
+            .act = NO_ACTIVATION},
+        // conv_7
+        {.type = NET_CONV, .name = "conv_7", .conv_params = &conv_7_params,
+            .input = &act.conv_6_out, .weights = conv_7_w, .bias = conv_7_b, .output = &act.conv_7_out,
+            .act = RELU},
+        // conv_dw_8
+        {.type = NET_CONV_DW, .name = "conv_dw_8", .conv_params = &conv_dw_8_params,
+            .input = &act.conv_7_out, .weights = conv_dw_8_w, .bias = conv_dw_8_b, .output = &act.conv_dw_8_out},
+        // conv_9
+        {.type = NET_CONV, .name = "conv_9", .conv_params = &conv_9_params,
+            .input = &act.conv_dw_8_out, .weights = conv_9_w, .bias = conv_9_b, .output = &act.conv_9_out,
+            .act = NO_ACTIVATION},
+        // Add residuals
+        {.type = NET_RESADD, .name = "resadd", .conv_params = &conv_9_params,
+            .input = &act.conv_9_out, .residual = &act.conv_6_out, .output = &act.conv_9_out,
+            .act = NO_ACTIVATION},
+        // conv_10
+        {.type = NET_CONV, .name = "conv_10", .conv_params = &conv_10_params,
+            .input = &act.conv_9_out, .weights = conv_10_w, .bias = conv_10_b, .output = &act.conv_10_out,
+            .act = RELU},
+        // conv_dw_11
+        {.type = NET_CONV_DW, .name = "conv_dw_11", .conv_params = &conv_dw_11_params,
+            .input = &act.conv_10_out, .weights = conv_dw_11_w, .bias = conv_dw_11_b, .output = &act.conv_dw_11_out},
+        // conv_12
+        {.type = NET_CONV, .name = "conv_12", .conv_params = &conv_12_params,
+            .input = &act.conv_dw_11_out, .weights = conv_12_w, .bias = conv_12_b, .output = &act.conv_12_out,
+            .act = NO_ACTIVATION},
+        // conv_13
+        {.type = NET_CONV, .name = "conv_13", .conv_params = &conv_13_params,
+            .input = &act.conv_12_out, .weights = conv_13_w, .bias = conv_13_b, .output = &act.conv_13_out,
+            .act = RELU},
+        // conv_dw_14
+        {.type = NET_CONV_DW, .name = "conv_dw_14", .conv_params = &conv_dw_14_params,
+            .input = &act.conv_13_out, .weights = conv_dw_14_w, .bias = conv_dw_14_b, .output = &act.conv_dw_14_out},
+        // conv_15
+        {.type = NET_CONV, .name = "conv_15", .conv_params = &conv_15_params,
+            .input = &act.conv_dw_14_out, .weights = conv_15_w, .bias = conv_15_b, .output = &act.conv_15_out,
+            .act = NO_ACTIVATION},
+        // Add residuals
+        {.type = NET_RESADD, .name = "resadd", .conv_params = &conv_15_params,
+            .input = &act.conv_15_out, .residual = &act.conv_12_out, .output = &act.conv_15_out,
+            .act = NO_ACTIVATION},
+        // conv_16
+        {.type = NET_CONV, .name = "conv_16", .conv_params = &conv_16_params,
+            .input = &act.conv_15_out, .weights = conv_16_w, .bias = conv_16_b, .output = &act.conv_16_out,
+            .act = RELU},
+        // conv_dw_17
+        {.type = NET_CONV_DW, .name = "conv_dw_17", .conv_params = &conv_dw_17_params,
+            .input = &act.conv_16_out, .weights = conv_dw_17_w, .bias = conv_dw_17_b, .output = &act.conv_dw_17_out},
+        // conv_18
+        {.type = NET_CONV, .name = "conv_18", .conv_params = &conv_18_params,
+            .input = &act.conv_dw_17_out, .weights = conv_18_w, .bias = conv_18_b, .output = &act.conv_18_out,
+            .act = NO_ACTIVATION},
+        // Add residuals
+        {.type = NET_RESADD, .name = "resadd", .conv_params = &conv_18_params,
+            .input = &act.conv_18_out, .residual = &act.conv_15_out, .output = &act.conv_18_out,
+            .act = NO_ACTIVATION},
+        // conv_19
+        {.type = NET_CONV, .name = "conv_19", .conv_params = &conv_19_params,
+            .input = &act.conv_18_out, .weights = conv_19_w, .bias = conv_19_b, .output = &act.conv_19_out,
+            .act = RELU},
+        // conv_dw_20
+        {.type = NET_CONV_DW, .name = "conv_dw_20", .conv_params = &conv_dw_20_params,
+            .input = &act.conv_19_out, .weights = conv_dw_20_w, .bias = conv_dw_20_b, .output = &act.conv_dw_20_out},
+        // conv_21
+        {.type = NET_CONV, .name = "conv_21", .conv_params = &conv_21_params,
+            .input = &act.conv_dw_20_out, .weights = conv_21_w, .bias = conv_21_b, .output = &act.conv_21_out,
+            .act = NO_ACTIVATION},
+        // conv_22
+        {.type = NET_CONV, .name = "conv_22", .conv_params = &conv_22_params,
+            .input = &act.conv_21_out, .weights = conv_22_w, .bias = conv_22_b, .output = &act.conv_22_out,
+            .act = RELU},
+        // conv_dw_23
+        {.type = NET_CONV_DW, .name = "conv_dw_23", .conv_params = &conv_dw_23_params,
+            .input = &act.conv_22_out, .weights = conv_dw_23_w, .bias = conv_dw_23_b, .output = &act.conv_dw_23_out},
+        // conv_24
+        {.type = NET_CONV, .name = "conv_24", .conv_params = &conv_24_params,
+            .input = &act.conv_dw_23_out, .weights = conv_24_w, .bias = conv_24_b, .output = &act.conv_24_out,
+            .act = NO_ACTIVATION},
+        // Add residuals
+        {.type = NET_RESADD, .name = "resadd", .conv_params = &conv_24_params,
+            .input = &act.conv_24_out, .residual = &act.conv_21_out, .output = &act.conv_24_out,
+            .act = NO_ACTIVATION},
+        // conv_25
+        {.type = NET_CONV, .name = "conv_25", .conv_params = &conv_25_params,
+            .input = &act.conv_24_out, .weights = conv_25_w, .bias = conv_25_b, .output = &act.conv_25_out,
+            .act = RELU},
+        // conv_dw_26
+        {.type = NET_CONV_DW, .name = "conv_dw_26", .conv_params = &conv_dw_26_params,
+            .input = &act.conv_25_out, .weights = conv_dw_26_w, .bias = conv_dw_26_b, .output = &act.conv_dw_26_out},
+        // conv_27
+        {.type = NET_CONV, .name = "conv_27", .conv_params = &conv_27_params,
+            .input = &act.conv_dw_26_out, .weights = conv_27_w, .bias = conv_27_b, .output = &act.conv_27_out,
+            .act = NO_ACTIVATION},
+        // Add residuals
+        {.type = NET_RESADD, .name = "resadd", .conv_params = &conv_27_params,
+            .input = &act.conv_27_out, .residual = &act.conv_24_out, .output = &act.conv_27_out,
+            .act = NO_ACTIVATION},
+        // conv_28
+        {.type = NET_CONV, .name = "conv_28", .conv_params = &conv_28_params,
+            .input = &act.conv_27_out, .weights = conv_28_w, .bias = conv_28_b, .output = &act.conv_28_out,
+            .act = RELU},
+        // conv_dw_29
+        {.type = NET_CONV_DW, .name = "conv_dw_29", .conv_params = &conv_dw_29_params,
+            .input = &act.conv_28_out, .weights = conv_dw_29_w, .bias = conv_dw_29_b, .output = &act.conv_dw_29_out},
+        // conv_30
+        {.type = NET_CONV, .name = "conv_30", .conv_params = &conv_30_params,
+            .input = &act.conv_dw_29_out, .weights = conv_30_w, .bias = conv_30_b, .output = &act.conv_30_out,
+            .act = NO_ACTIVATION},
+        // Add residuals
+        {.type = NET_RESADD, .name = "resadd", .conv_params = &conv_30_params,
+            .input = &act.conv_30_out, .residual = &act.conv_27_out, .output = &act.conv_30_out,
+            .act = NO_ACTIVATION},
+        // conv_31
+        {.type = NET_CONV, .name = "conv_31", .conv_params = &conv_31_params,
+            .input = &act.conv_30_out, .weights = conv_31_w, .bias = conv_31_b, .output = &act.conv_31_out,
+            .act = RELU},
+        // conv_dw_32
+        {.type = NET_CONV_DW, .name = "conv_dw_32", .conv_params = &conv_dw_32_params,
+            .input = &act.conv_31_out, .weights = conv_dw_32_w, .bias = conv_dw_32_b, .output = &act.conv_dw_32_out},
+        // conv_33
+        {.type = NET_CONV, .name = "conv_33", .conv_params = &conv_33_params,
+            .input = &act.conv_dw_32_out, .weights = conv_33_w, .bias = conv_33_b, .output = &act.conv_33_out,
+            .act = NO_ACTIVATION},
+        // conv_34
+        {.type = NET_CONV, .name = "conv_34", .conv_params = &conv_34_params,
+            .input = &act.conv_33_out, .weights = conv_34_w, .bias = conv_34_b, .output = &act.conv_34_out,
+            .act = RELU},
+        // conv_dw_35
+        {.type = NET_CONV_DW, .name = "conv_dw_35", .conv_params = &conv_dw_35_params,
+            .input = &act.conv_34_out, .weights = conv_dw_35_w, .bias = conv_dw_35_b, .output = &act.conv_dw_35_out},
+        // conv_36
+        {.type = NET_CONV, .name = "conv_36", .conv_params = &conv_36_params,
+            .input = &act.conv_dw_35_out, .weights = conv_36_w, .bias = conv_36_b, .output = &act.conv_36_out,
+            .act = NO_ACTIVATION},
+        // Add residuals
+        {.type = NET_RESADD, .name = "resadd", .conv_params = &conv_36_params,
+            .input = &act.conv_36_out, .residual = &act.conv_33_out, .output = &act.conv_36_out,
+            .act = NO_ACTIVATION},
+        // conv_37
+        {.type = NET_CONV, .name = "conv_37", .conv_params = &conv_37_params,
+            .input = &act.conv_36_out, .weights = conv_37_w, .bias = conv_37_b, .output = &act.conv_37_out,
+            .act = RELU},
+        // conv_dw_38
+        {.type = NET_CONV_DW, .name = "conv_dw_38", .conv_params = &conv_dw_38_params,
+            .input = &act.conv_37_out, .weights = conv_dw_38_w, .bias = conv_dw_38_b, .output = &act.conv_dw_38_out},
+        // conv_39
+        {.type = NET_CONV, .name = "conv_39", .conv_params = &conv_39_params,
+            .input = &act.conv_dw_38_out, .weights = conv_39_w, .bias = conv_39_b, .output = &act.conv_39_out,
+            .act = NO_ACTIVATION},
+        // Add residuals
+        {.type = NET_RESADD, .name = "resadd", .conv_params = &conv_39_params,
+            .input = &act.conv_39_out, .residual = &act.conv_36_out, .output = &act.conv_39_out,
+            .act = NO_ACTIVATION},
+        // conv_40
+        {.type = NET_CONV, .name = "conv_40", .conv_params = &conv_40_params,
+            .input = &act.conv_39_out, .weights = conv_40_w, .bias = conv_40_b, .output = &act.conv_40_out,
+            .act = RELU},
+        // conv_dw_41
+        {.type = NET_CONV_DW, .name = "conv_dw_41", .conv_params = &conv_dw_41_params,
+            .input = &act.conv_40_out, .weights = conv_dw_41_w, .bias = conv_dw_41_b, .output = &act.conv_dw_41_out},
+        // conv_42
+        {.type = NET_CONV, .name = "conv_42", .conv_params = &conv_42_params,
+            .input = &act.conv_dw_41_out, .weights = conv_42_w, .bias = conv_42_b, .output = &act.conv_42_out,
+            .act = NO_ACTIVATION},
+        // conv_43
+        {.type = NET_CONV, .name = "conv_43", .conv_params = &conv_43_params,
+            .input = &act.conv_42_out, .weights = conv_43_w, .bias = conv_43_b, .output = &act.conv_43_out,
+            .act = RELU},
+        // conv_dw_44
+        {.type = NET_CONV_DW, .name = "conv_dw_44", .conv_params = &conv_dw_44_params,
+            .input = &act.conv_43_out, .weights = conv_dw_44_w, .bias = conv_dw_44_b, .output = &act.conv_dw_44_out},
+        // conv_45
+        {.type = NET_CONV, .name = "conv_45", .conv_params = &conv_45_params,
+            .input = &act.conv_dw_44_out, .weights = conv_45_w, .bias = conv_45_b, .output = &act.conv_45_out,
+            .act = NO_ACTIVATION},
+        // Add residuals
+        {.type = NET_RESADD, .name = "resadd", .conv_params = &conv_45_params,
+            .input = &act.conv_45_out, .residual = &act.conv_42_out, .output = &act.conv_45_out,
+            .act = NO_ACTIVATION},
+        // conv_46
+        {.type = NET_CONV, .name = "conv_46", .conv_params = &conv_46_params,
+            .input = &act.conv_45_out, .weights = conv_46_w, .bias = conv_46_b, .output = &act.conv_46_out,
+            .act = RELU},
+        // conv_dw_47
+        {.type = NET_CONV_DW, .name = "conv_dw_47", .conv_params = &conv_dw_47_params,
+            .input = &act.conv_46_out, .weights = conv_dw_47_w, .bias = conv_dw_47_b, .output = &act.conv_dw_47_out},
+        // conv_48
+        {.type = NET_CONV, .name = "conv_48", .conv_params = &conv_48_params,
+            .input = &act.conv_dw_47_out, .weights = conv_48_w, .bias = conv_48_b, .output = &act.conv_48_out,
+            .act = NO_ACTIVATION},
+        // Add residuals
+        {.type = NET_RESADD, .name = "resadd", .conv_params = &conv_48_params,
+            .input = &act.conv_48_out, .residual = &act.conv_45_out, .output = &act.conv_48_out,
+            .act = NO_ACTIVATION},
+        // conv_49
+        {.type = NET_CONV, .name = "conv_49", .conv_params = &conv_49_params,
+            .input = &act.conv_48_out, .weights = conv_49_w, .bias = conv_49_b, .output = &act.conv_49_out,
+            .act = RELU},
+        // conv_dw_50
+        {.type = NET_CONV_DW, .name = "conv_dw_50", .conv_params = &conv_dw_50_params,
+            .input = &act.conv_49_out, .weights = conv_dw_50_w, .bias = conv_dw_50_b, .output = &act.conv_dw_50_out},
+        // conv_51
+        {.type = NET_CONV, .name = "conv_51", .conv_params = &conv_51_params,
+            .input = &act.conv_dw_50_out, .weights = conv_51_w, .bias = conv_51_b, .output = &act.conv_51_out,
+            .act = NO_ACTIVATION},
+        // conv_52
+        {.type = NET_CONV, .name = "conv_52", .conv_params = &conv_52_params,
+            .input = &act.conv_51_out, .weights = conv_52_w, .bias = conv_52_b, .output = &act.conv_52_out,
+            .act = RELU},
+        // Global averaging
+        {.type = NET_AVGPOOL, .name = "average", .conv_params = &conv_52_params,
+            .input = &act.conv_52_out, .output = &act.average},
+        // fc_53
+        {.type = NET_FC, .name = "fc_53", .fc_params = &fc_53_params,
+            .input = &act.average, .weights = fc_53_w, .bias = fc_53_b, .output = fc_53_out,
+            .act = NO_ACTIVATION},
+    };
+
+    const size_t n_layers = sizeof(layers)/sizeof(layers[0]);
+
+    struct NetPlan plan;
+    void * activations = net_plan_arena(layers, n_layers, &plan);
 
-        tiled_matmul_nn_auto(conv_52_params.I, conv_52_params.J, conv_52_params.K,
-            conv_51_out, conv_52_w, conv_52_b, conv_52_out,
-            RELU, conv_52_params.output_scale, 0, true,
-            tiled_matmul_type, check, "conv_52");
+#ifndef BAREMETAL
+    if (export_path != NULL) {
+        if (!gemmini_model_write(export_path, layers, n_layers, images, sizeof(images), activations, plan.arena_bytes))
+            exit(1);
 
-        end = read_cycles();
-        matmul_cycles += end - start;
+        printf("Wrote %s\n", export_path);
+        exit(0);
     }
+#endif
 
-    // Global averaging
-    static elem_t average[1280][4] row_align(1);
-
-    start = read_cycles();
-
-    for (int batch = 0; batch < conv_52_params.batch_size; batch++) {
-        for (int channel = 0; channel < conv_52_params.out_channels; channel++) {
-            int sum = 0;
-            for (int row = 0; row < conv_52_params.out_dim; row++) {
-                for (int col = 0; col < conv_52_params.out_dim; col++) {
-                    size_t r = batch * conv_52_params.out_dim * conv_52_params.out_dim + row * conv_52_params.out_dim + col;
-
-                    sum += conv_52_out[r][channel];
-                }
-            }
-            const int count = conv_52_params.out_dim * conv_52_params.out_dim;
-
-            average[channel][batch] = (sum + count/2) / count;
-        }
+    if (select_strategies) {
+        const uint64_t calibration_cycles = net_select_strategies(layers, n_layers, tiled_matmul_type, conv);
+        printf("Calibration cycles: %llu\n", (unsigned long long)calibration_cycles);
     }
 
-    end = read_cycles();
-    other_cycles += end - start;
-
-    // fc_53
-    start = read_cycles();
+    struct NetCycles cycles = {0};
+    net_run(layers, n_layers, tiled_matmul_type, conv, check, &cycles);
 
-    tiled_matmul_nn_auto(fc_53_params.I, fc_53_params.J, fc_53_params.K,
-        fc_53_w, average, fc_53_b, fc_53_out,
-        NO_ACTIVATION, fc_53_params.output_scale, 0, false,
-        tiled_matmul_type, check, "fc_53");
-
-    end = read_cycles();
-    matmul_cycles += end - start;
+#ifndef BAREMETAL
+    if (golden_path != NULL && !golden_save(golden_path))
+        exit(1);
+#endif
 
     // Find highest probs
     int preds[fc_53_params.batch_size];
@@ -1280,19 +389,13 @@ int main (int argc, char * argv[]) {
         }
 
         preds[batch] = max_idx;
-        printf("Prediction: %u (score: %d)\n", max_idx, max_prob);
+        printf("Prediction: %d (score: %d)\n", (int)max_idx, max_prob);
     }
 
-    uint64_t total_cycles = im2col_cycles + matmul_cycles + pool_cycles + conv_cycles + conv_dw_cycles + res_add_cycles + other_cycles;
-
-    printf("\nTotal cycles: %llu (100%%)\n", total_cycles);
-    printf("Matmul cycles: %llu (%d%%)\n", matmul_cycles, (matmul_cycles * 100) / total_cycles);
-    printf("Im2col cycles: %llu (%d%%)\n", im2col_cycles, (im2col_cycles * 100) / total_cycles);
-    printf("Conv cycles: %llu (%d%%)\n", conv_cycles, (conv_cycles * 100) / total_cycles);
-    printf("Pooling cycles: %llu (%d%%)\n", pool_cycles, (pool_cycles * 100) / total_cycles);
-    printf("Depthwise convolution cycles: %llu (%d%%)\n", conv_dw_cycles, (conv_dw_cycles * 100) / total_cycles);
-    printf("Res add cycles: %llu (%d%%)\n", res_add_cycles, (res_add_cycles * 100) / total_cycles);
-    printf("Other cycles: %llu (%d%%)\n", other_cycles, (other_cycles * 100) / total_cycles);
+    net_print_cycles(&cycles);
+    if (select_strategies)
+        net_print_strategies(layers, n_layers, conv);
+    net_print_plan(&plan);
 
     int correct[] = {75, 900, 125, 897};
     for (int i = 0; i < fc_53_params.batch_size; i++) {
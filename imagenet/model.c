@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#ifndef BAREMETAL
+#include <sys/mman.h>
+#endif
+#include "include/gemmini.h"
+#include "include/gemmini_nn.h"
+#include "include/gemmini_net.h"
+#include "include/gemmini_model.h"
+
+#include "images.h"
+
+// Runs a model file written by "resnet50-linux export path" or
+// "mobilenet-linux export path" on the images. On Linux, the model is mapped
+// from the file named on the command line. On baremetal, it is linked in from
+// GEMMINI_MODEL_PATH.
+
+#define ACTIVATION_ARENA_BYTES (16 * 1024 * 1024)
+#define OUTPUT_BYTES (64 * 1024)
+#define MAX_LAYERS 256
+
+#ifdef BAREMETAL
+GEMMINI_MODEL_INCBIN(model_image, GEMMINI_MODEL_PATH)
+#endif
+
+int main (int argc, char * argv[]) {
+#ifndef BAREMETAL
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      perror("mlockall failed");
+      exit(1);
+    }
+#endif
+
+    gemmini_flush(0);
+
+#ifdef BAREMETAL
+    const void * image = model_image;
+    const size_t image_bytes = model_image_end - model_image;
+#else
+    if (argc < 2 || strcmp(argv[1], "-h") == 0) {
+        printf("usage: %s model_file [matmul_option] [conv|matmul|auto] [check [golden_cache]]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
+        exit(argc < 2);
+    }
+
+    size_t image_bytes;
+    const void * image = gemmini_model_map(argv[1], &image_bytes);
+    if (image == NULL)
+        exit(1);
+
+    argc--;
+    argv++;
+#endif
+
+    enum tiled_matmul_type_t tiled_matmul_type;
+    if (argc < 2) {
+        tiled_matmul_type = WS;
+    } else if (strcmp(argv[1], "cpu") == 0) {
+        tiled_matmul_type = CPU;
+    } else if (strcmp(argv[1], "os") == 0) {
+        tiled_matmul_type = OS;
+    } else if (strcmp(argv[1], "ws") == 0) {
+        tiled_matmul_type = WS;
+    } else {
+        printf("Unknown command-line argument\n");
+        exit(1);
+    }
+
+    // "auto" times every conv each way in a calibration run first, and then
+    // runs each one the fastest way
+    bool conv, select_strategies = false;
+    if (argc < 3) {
+        conv = false;
+    } else if (strcmp(argv[2], "conv") == 0) {
+        conv = true;
+    } else if (strcmp(argv[2], "matmul") == 0) {
+        conv = false;
+    } else if (strcmp(argv[2], "auto") == 0) {
+        conv = false;
+        select_strategies = true;
+    } else {
+        printf("Unknown command-line argument\n");
+        exit(1);
+    }
+
+    bool check;
+    if (argc < 4) {
+        check = false;
+    } else if (strcmp(argv[3], "check") == 0) {
+        check = true;
+    } else {
+        printf("Unknown command-line argument\n");
+        exit(1);
+    }
+
+#ifndef BAREMETAL
+    // Check mode can compare against a golden cache instead of checksums
+    const char * golden_path = NULL;
+    if (argc >= 5 && check) {
+        golden_path = argv[4];
+        if (!golden_open(golden_path))
+            exit(1);
+    } else if (argc >= 5) {
+        printf("Unknown command-line argument\n");
+        exit(1);
+    }
+#endif
+
+    static elem_t activations[ACTIVATION_ARENA_BYTES] row_align(1);
+    static elem_t output[OUTPUT_BYTES] row_align(1);
+    static struct NetLayer layers[MAX_LAYERS];
+
+    struct GemminiModel model;
+    if (!gemmini_model_open(image, image_bytes, &model))
+        exit(1);
+
+    if (model.n_layers == 0 || model.n_layers > MAX_LAYERS ||
+            model.input_bytes != sizeof(images) ||
+            model.output_bytes > sizeof(output) ||
+            model.arena_bytes > sizeof(activations)) {
+        printf("The model doesn't fit: %llu layers, %llu input bytes, %llu output bytes, %llu activation bytes\n",
+            (unsigned long long)model.n_layers, (unsigned long long)model.input_bytes,
+            (unsigned long long)model.output_bytes, (unsigned long long)model.arena_bytes);
+        exit(1);
+    }
+
+    if (!gemmini_model_layers(&model, images, output, activations, layers))
+        exit(1);
+
+    printf("Loaded %llu layers\n", (unsigned long long)model.n_layers);
+
+    if (select_strategies) {
+        const uint64_t calibration_cycles = net_select_strategies(layers, model.n_layers, tiled_matmul_type, conv);
+        printf("Calibration cycles: %llu\n", (unsigned long long)calibration_cycles);
+    }
+
+    struct NetCycles cycles = {0};
+    net_run(layers, model.n_layers, tiled_matmul_type, conv, check, &cycles);
+
+#ifndef BAREMETAL
+    if (golden_path != NULL && !golden_save(golden_path))
+        exit(1);
+#endif
+
+    // Find highest probs, if the network ends with a classifier
+    const struct FcParams * fc_params = layers[model.n_layers-1].fc_params;
+    if (fc_params != NULL) {
+        const elem_t (* probs)[fc_params->batch_size] = (const elem_t (*)[fc_params->batch_size]) output;
+
+        for (int batch = 0; batch < fc_params->batch_size; batch++) {
+            elem_t max_prob = probs[0][batch];
+            size_t max_idx = 0;
+
+            for (int i = 1; i < fc_params->out_features; i++) {
+                if (probs[i][batch] > max_prob) {
+                    max_prob = probs[i][batch];
+                    max_idx = i;
+                }
+            }
+
+            printf("Prediction: %d (score: %d)\n", (int)max_idx, max_prob);
+        }
+    }
+
+    net_print_cycles(&cycles);
+    if (select_strategies)
+        net_print_strategies(layers, model.n_layers, conv);
+
+    printf("\nPeak activation memory: %llu bytes\n", (unsigned long long)model.arena_bytes);
+
+    exit(0);
+}
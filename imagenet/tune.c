@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#ifndef BAREMETAL
+#include <sys/mman.h>
+#endif
+#include "include/gemmini.h"
+#include "include/gemmini_nn.h"
+#include "include/gemmini_net.h"
+#include "include/gemmini_model.h"
+
+#include "images.h"
+
+// Autotunes the tiling factors of every matmul and conv in a model file, and
+// records the fastest ones in a tuning database (see "Tuning database" in
+// gemmini.h). On Linux, the model and the database are named on the command
+// line, and the database is updated in place. On baremetal, the model is linked
+// in from GEMMINI_MODEL_PATH, and the new entries are printed, to be saved to a
+// file and compiled in with GEMMINI_TUNING_DB.
+//
+// Each shape's feasible tilings are swept. Along each dimension, only the
+// largest tile that splits it into a given number of tiles is tried, the
+// reduction factor (tile_K, or kchs) is made as large as fits, and tilings in
+// which one factor could grow to its next candidate and still fit are skipped.
+// Every tiling, including the one the heuristic picks, is timed TUNE_REPEATS
+// times on the model's own buffers, and its fastest run counts. Shapes that
+// are already in the database are skipped, so delete the database to retune.
+
+#define ACTIVATION_ARENA_BYTES (16 * 1024 * 1024)
+#define OUTPUT_BYTES (64 * 1024)
+#define MAX_LAYERS 256
+#define TUNE_REPEATS 2
+#define TUNE_MAX_CANDIDATES 256
+
+#ifdef BAREMETAL
+GEMMINI_MODEL_INCBIN(model_image, GEMMINI_MODEL_PATH)
+#endif
+
+// The largest tiles that split n into 1, 2, 3, ... tiles, from largest to
+// smallest, each rounded up to a multiple of unit
+static size_t tune_candidates(size_t n, size_t unit, size_t * candidates)
+{
+    const size_t units = (n + unit - 1) / unit;
+    size_t count = 0;
+
+    for (size_t tiles = 1; tiles <= units && count < TUNE_MAX_CANDIDATES; tiles++) {
+        size_t size = (units + tiles - 1) / tiles * unit;
+        if (size > n)
+            size = n;
+
+        if (count == 0 || size < candidates[count-1])
+            candidates[count++] = size;
+    }
+
+    return count;
+}
+
+struct tune_matmul {
+    size_t dim_I, dim_J, dim_K;
+    const elem_t * A;
+    const elem_t * B;
+    const acc_t * D;
+    elem_t * C;
+    bool repeating_bias;
+};
+
+static uint64_t tune_time_matmul(const struct tune_matmul * mm,
+        size_t tile_I, size_t tile_J, size_t tile_K,
+        enum tiled_matmul_type_t tiled_matmul_type)
+{
+    uint64_t best = UINT64_MAX;
+
+    for (int r = 0; r < TUNE_REPEATS; r++) {
+        const uint64_t start = read_cycles();
+
+        tiled_matmul(mm->dim_I, mm->dim_J, mm->dim_K,
+            mm->A, mm->B, mm->D, mm->C,
+            mm->dim_K, mm->dim_J, mm->dim_J, mm->dim_J,
+            MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+            NO_ACTIVATION, 0, 0, NULL, NULL, mm->repeating_bias,
+            tile_I, tile_J, tile_K,
+            tiled_matmul_type);
+
+        const uint64_t end = read_cycles();
+        if (end - start < best)
+            best = end - start;
+    }
+
+    return best;
+}
+
+static void tune_matmul(const char * name, const struct tune_matmul * mm,
+        enum tiled_matmul_type_t tiled_matmul_type)
+{
+    if (gemmini_tune_find_matmul(mm->dim_I, mm->dim_J, mm->dim_K, tiled_matmul_type) != NULL)
+        return;
+
+    static size_t cands_I[TUNE_MAX_CANDIDATES], cands_J[TUNE_MAX_CANDIDATES], cands_K[TUNE_MAX_CANDIDATES];
+    const size_t n_I = tune_candidates((mm->dim_I + DIM - 1) / DIM, 1, cands_I);
+    const size_t n_J = tune_candidates((mm->dim_J + DIM - 1) / DIM, 1, cands_J);
+    const size_t n_K = tune_candidates((mm->dim_K + DIM - 1) / DIM, 1, cands_K);
+
+    struct gemmini_tune_matmul_entry best = {
+        .dim_I = mm->dim_I, .dim_J = mm->dim_J, .dim_K = mm->dim_K,
+        .type = tiled_matmul_type,
+    };
+    tiled_matmul_auto_tiles(mm->dim_I, mm->dim_J, mm->dim_K, &best.tile_I, &best.tile_J, &best.tile_K);
+
+    const uint64_t heuristic_cycles = tune_time_matmul(mm, best.tile_I, best.tile_J, best.tile_K, tiled_matmul_type);
+    uint64_t best_cycles = heuristic_cycles;
+    size_t tried = 1;
+
+#define FITS(i, j, k) tiled_matmul_tiles_fit(mm->dim_I, mm->dim_J, mm->dim_K, cands_I[i], cands_J[j], cands_K[k])
+
+    for (size_t i = 0; i < n_I; i++) {
+        for (size_t j = 0; j < n_J; j++) {
+            size_t k = 0;
+            while (k < n_K && !FITS(i, j, k))
+                k++;
+
+            if (k == n_K || (i > 0 && FITS(i-1, j, k)) || (j > 0 && FITS(i, j-1, k)))
+                continue;
+
+            const uint64_t cycles = tune_time_matmul(mm, cands_I[i], cands_J[j], cands_K[k], tiled_matmul_type);
+            tried++;
+
+            if (cycles < best_cycles) {
+                best_cycles = cycles;
+                best.tile_I = cands_I[i];
+                best.tile_J = cands_J[j];
+                best.tile_K = cands_K[k];
+            }
+        }
+    }
+
+#undef FITS
+
+    if (!gemmini_tune_set_matmul(&best)) {
+        printf("The tuning database is full\n");
+        exit(1);
+    }
+
+    printf("%s: %llux%llux%llu matmul, %llu tilings, %llu cycles -> %llu cycles with tiles %llu, %llu, %llu\n",
+        name, (unsigned long long)mm->dim_I, (unsigned long long)mm->dim_J, (unsigned long long)mm->dim_K,
+        (unsigned long long)tried, (unsigned long long)heuristic_cycles, (unsigned long long)best_cycles,
+        (unsigned long long)best.tile_I, (unsigned long long)best.tile_J, (unsigned long long)best.tile_K);
+}
+
+static uint64_t tune_time_conv(const struct NetLayer * layer, const int args[7])
+{
+    const struct ConvParams * params = layer->conv_params;
+    uint64_t best = UINT64_MAX;
+
+    for (int r = 0; r < TUNE_REPEATS; r++) {
+        const uint64_t start = read_cycles();
+
+        tiled_conv(
+            params->batch_size, params->in_dim, params->in_channels,
+            params->out_channels, params->out_dim,
+            params->stride, params->padding, params->kernel_size,
+
+            args[0],
+            args[1], args[2], args[3],
+            args[4], args[5], args[6],
+
+            (elem_t*)layer->input, (elem_t*)layer->weights, (acc_t*)layer->bias, (elem_t*)layer->output,
+
+            layer->act, params->output_scale, 0, NULL, NULL,
+            params->pool_size, layer->pool_buffer != NULL ? params->pool_stride : 0, params->pool_padding,
+
+            WS);
+
+        const uint64_t end = read_cycles();
+        if (end - start < best)
+            best = end - start;
+    }
+
+    return best;
+}
+
+static void tune_conv(const struct NetLayer * layer)
+{
+    const struct ConvParams * params = layer->conv_params;
+    const bool pooled = layer->pool_buffer != NULL;
+
+    struct gemmini_tune_conv_entry best = {
+        .batch_size = params->batch_size, .in_dim = params->in_dim, .in_channels = params->in_channels,
+        .out_channels = params->out_channels, .out_dim = params->out_dim,
+        .stride = params->stride, .padding = params->padding, .kernel_dim = params->kernel_size,
+        .pool_size = pooled ? params->pool_size : 1, .pool_stride = pooled ? params->pool_stride : 1,
+        .pool_padding = pooled ? params->pool_padding : 0,
+    };
+
+    if (gemmini_tune_find_conv(&best) != NULL)
+        return;
+
+    const int pool_out_dim = (best.out_dim + 2*best.pool_padding - best.pool_size) / best.pool_stride + 1;
+
+#define FITS(args) tiled_conv_args_fit(best.batch_size, pool_out_dim, best.out_channels, best.kernel_dim, best.in_channels, \
+        best.stride, best.pool_size, best.pool_stride, args)
+
+    static size_t cands_b[TUNE_MAX_CANDIDATES], cands_r[TUNE_MAX_CANDIDATES], cands_o[TUNE_MAX_CANDIDATES], cands_k[TUNE_MAX_CANDIDATES];
+    const size_t n_b = tune_candidates(best.batch_size, 1, cands_b);
+    const size_t n_r = tune_candidates(pool_out_dim, 1, cands_r);
+    const size_t n_o = tune_candidates(best.out_channels, DIM, cands_o);
+    const size_t n_k = tune_candidates(best.in_channels, DIM, cands_k);
+
+    tiled_conv_auto_args(best.batch_size, pool_out_dim, best.out_channels, best.kernel_dim, best.in_channels,
+        best.stride, best.pool_size, best.pool_stride, best.args);
+
+    const uint64_t heuristic_cycles = tune_time_conv(layer, best.args);
+    uint64_t best_cycles = heuristic_cycles;
+    size_t tried = 1;
+
+    // Tiles always cover the whole kernel
+    for (size_t b = 0; b < n_b; b++) {
+        for (size_t r = 0; r < n_r; r++) {
+            for (size_t c = 0; c < n_r; c++) {
+                for (size_t o = 0; o < n_o; o++) {
+                    int args[7] = {cands_b[b], cands_r[r], cands_r[c], cands_o[o], best.kernel_dim, best.kernel_dim, 0};
+
+                    size_t k = 0;
+                    for (; k < n_k; k++) {
+                        args[6] = cands_k[k];
+                        if (FITS(args))
+                            break;
+                    }
+                    if (k == n_k)
+                        continue;
+
+                    // Skip tilings in which one factor could grow
+                    const size_t * cands[] = {cands_b, cands_r, cands_r, cands_o};
+                    const size_t idx[] = {b, r, c, o};
+                    bool dominated = false;
+
+                    for (int d = 0; d < 4 && !dominated; d++) {
+                        if (idx[d] > 0) {
+                            int larger[7];
+                            memcpy(larger, args, sizeof(larger));
+                            larger[d] = cands[d][idx[d]-1];
+                            dominated = FITS(larger);
+                        }
+                    }
+                    if (dominated)
+                        continue;
+
+                    const uint64_t cycles = tune_time_conv(layer, args);
+                    tried++;
+
+                    if (cycles < best_cycles) {
+                        best_cycles = cycles;
+                        memcpy(best.args, args, sizeof(args));
+                    }
+                }
+            }
+        }
+    }
+
+#undef FITS
+
+    if (!gemmini_tune_set_conv(&best)) {
+        printf("The tuning database is full\n");
+        exit(1);
+    }
+
+    printf("%s: conv, %llu tilings, %llu cycles -> %llu cycles with tiles %d, %d, %d, %d, %d, %d, %d\n",
+        layer->name, (unsigned long long)tried, (unsigned long long)heuristic_cycles, (unsigned long long)best_cycles,
+        best.args[0], best.args[1], best.args[2], best.args[3], best.args[4], best.args[5], best.args[6]);
+}
+
+int main (int argc, char * argv[]) {
+#ifndef BAREMETAL
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      perror("mlockall failed");
+      exit(1);
+    }
+#endif
+
+    gemmini_flush(0);
+
+    enum tiled_matmul_type_t tiled_matmul_type = WS;
+
+#ifdef BAREMETAL
+    const void * image = model_image;
+    const size_t image_bytes = model_image_end - model_image;
+#else
+    if (argc < 3 || strcmp(argv[1], "-h") == 0) {
+        printf("usage: %s model_file tuning_db [matmul_option]\n  matmul_option may be 'os' or 'ws'\n", argv[0]);
+        exit(argc < 3);
+    }
+
+    if (argc < 4 || strcmp(argv[3], "ws") == 0) {
+        tiled_matmul_type = WS;
+    } else if (strcmp(argv[3], "os") == 0) {
+        tiled_matmul_type = OS;
+    } else {
+        printf("Unknown command-line argument\n");
+        exit(1);
+    }
+
+    const char * db_path = argv[2];
+    FILE * db = fopen(db_path, "r");
+    if (db != NULL) {
+        fclose(db);
+        if (!gemmini_tune_load(db_path))
+            exit(1);
+    }
+
+    size_t image_bytes;
+    const void * image = gemmini_model_map(argv[1], &image_bytes);
+    if (image == NULL)
+        exit(1);
+#endif
+
+    static elem_t activations[ACTIVATION_ARENA_BYTES] row_align(1);
+    static elem_t output[OUTPUT_BYTES] row_align(1);
+    static struct NetLayer layers[MAX_LAYERS];
+
+    struct GemminiModel model;
+    if (!gemmini_model_open(image, image_bytes, &model))
+        exit(1);
+
+    if (model.n_layers == 0 || model.n_layers > MAX_LAYERS ||
+            model.input_bytes != sizeof(images) ||
+            model.output_bytes > sizeof(output) ||
+            model.arena_bytes > sizeof(activations)) {
+        printf("The model doesn't fit: %llu layers, %llu input bytes, %llu output bytes, %llu activation bytes\n",
+            (unsigned long long)model.n_layers, (unsigned long long)model.input_bytes,
+            (unsigned long long)model.output_bytes, (unsigned long long)model.arena_bytes);
+        exit(1);
+    }
+
+    if (!gemmini_model_layers(&model, images, output, activations, layers))
+        exit(1);
+
+    for (size_t l = 0; l < model.n_layers; l++) {
+        const struct NetLayer * layer = &layers[l];
+
+        if (layer->type == NET_CONV) {
+            const struct ConvParams * params = layer->conv_params;
+
+            if (net_strategy_ok(layer, NET_STRATEGY_MATMUL, tiled_matmul_type)) {
+                const struct tune_matmul mm = {
+                    .dim_I = params->I, .dim_J = params->J, .dim_K = params->K,
+                    .A = (const elem_t *)(layer->im2col_buffer != NULL ? layer->im2col_buffer : layer->input),
+                    .B = (const elem_t *)layer->weights,
+                    .D = (const acc_t *)layer->bias,
+                    .C = (elem_t *)(layer->pool_buffer != NULL ? layer->pool_buffer : layer->output),
+                    .repeating_bias = true,
+                };
+                tune_matmul(layer->name, &mm, tiled_matmul_type);
+            }
+
+            if (net_strategy_ok(layer, NET_STRATEGY_CONV, tiled_matmul_type))
+                tune_conv(layer);
+        } else if (layer->type == NET_FC) {
+            const struct FcParams * params = layer->fc_params;
+
+            const struct tune_matmul mm = {
+                .dim_I = params->I, .dim_J = params->J, .dim_K = params->K,
+                .A = (const elem_t *)layer->weights,
+                .B = (const elem_t *)layer->input,
+                .D = (const acc_t *)layer->bias,
+                .C = (elem_t *)layer->output,
+                .repeating_bias = false,
+            };
+            tune_matmul(layer->name, &mm, tiled_matmul_type);
+        }
+    }
+
+#ifdef BAREMETAL
+    printf("\nTuning database:\n");
+    gemmini_tune_print();
+#else
+    if (!gemmini_tune_save(db_path))
+        exit(1);
+
+    printf("Wrote %s\n", db_path);
+#endif
+
+    exit(0);
+}
@@ -11,8 +11,10 @@
 #include <math.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "include/gemmini_params.h"
+#include "include/gemmini_threads.h"
 
 #define GEMMINI_ASSERTIONS
 
@@ -157,8 +159,73 @@ scale_acc_t_bits scale_acc_t_to_scale_acc_t_bits(scale_acc_t x) {
 }
 #endif
 
+// Command counters
+//
+// Building with GEMMINI_COUNTERS counts the commands sent to Gemmini while
+// gemmini_counting is set, by funct, along with the bytes that its mvins and
+// mvouts move. Each of those moves rows x cols elements, which are acc_ts when
+// an mvin's target is in the accumulator, except that a pooled mvout moves
+// the porows x pocols pixels that the last CONFIG_ST set up. Counting takes a
+// few instructions per command, so benchmarks should time their runs with it
+// off.
+#ifdef GEMMINI_COUNTERS
+#define GEMMINI_N_FUNCTS 16
+
+struct gemmini_counters {
+  uint64_t commands[GEMMINI_N_FUNCTS];
+  uint64_t mvin_bytes, mvout_bytes;
+};
+
+static struct gemmini_counters gemmini_counters;
+static bool gemmini_counting = false;
+
+// How many pixels each pooled mvout moves, or 0 when mvouts aren't pooled
+static uint64_t gemmini_counted_pool_pixels = 0;
+
+static inline void gemmini_count(uint64_t rs1, uint64_t rs2, int funct) {
+  if (!gemmini_counting)
+    return;
+
+  gemmini_counters.commands[funct]++;
+
+  if (funct == k_CONFIG && (rs1 & 3) == CONFIG_ST) {
+    const bool pooled = ((rs1 >> 4) & 3) != 0;
+    gemmini_counted_pool_pixels = pooled ? ((rs1 >> 32) & 0xff) * ((rs1 >> 40) & 0xff) : 0;
+  }
+
+  if (funct == k_MVIN || funct == k_MVOUT) {
+    const uint64_t rows = (rs2 >> (ADDR_LEN + 16)) & 0xffff;
+    const uint64_t cols = (rs2 >> ADDR_LEN) & 0xffff;
+
+    if (funct == k_MVOUT && gemmini_counted_pool_pixels != 0)
+      gemmini_counters.mvout_bytes += gemmini_counted_pool_pixels * cols * sizeof(elem_t);
+    else if (funct == k_MVOUT)
+      gemmini_counters.mvout_bytes += rows * cols * sizeof(elem_t);
+    else if ((rs2 >> 31) & 1)
+      gemmini_counters.mvin_bytes += rows * cols * sizeof(acc_t);
+    else
+      gemmini_counters.mvin_bytes += rows * cols * sizeof(elem_t);
+  }
+}
+
+static uint64_t gemmini_counted_commands(const struct gemmini_counters * counters) {
+  uint64_t commands = 0;
+  for (int funct = 0; funct < GEMMINI_N_FUNCTS; funct++)
+    commands += counters->commands[funct];
+  return commands;
+}
+
+#define ROCC_INSTRUCTION_RS1_RS2(x, rs1, rs2, funct) \
+  { \
+    const uint64_t gemmini_rs1 = (uint64_t)(rs1); \
+    const uint64_t gemmini_rs2 = (uint64_t)(rs2); \
+    gemmini_count(gemmini_rs1, gemmini_rs2, funct); \
+    ROCC_INSTRUCTION_0_R_R(x, gemmini_rs1, gemmini_rs2, funct); \
+  }
+#else
 #define ROCC_INSTRUCTION_RS1_RS2(x, rs1, rs2, funct) \
   ROCC_INSTRUCTION_0_R_R(x, rs1, rs2, funct)
+#endif
 
 // mvin and mvout
 #define gemmini_extended_mvin(dram_addr, spad_addr, cols, rows) \
@@ -234,12 +301,60 @@ scale_acc_t_bits scale_acc_t_to_scale_acc_t_bits(scale_acc_t x) {
 // fence
 #define gemmini_fence() asm volatile("fence")
 
+// Per-output-channel requantization
+//
+// Output channel ch is requantized as
+//   sat(ROUNDING_RIGHT_SHIFT((full_t)acc * per_channel_mult[ch], per_channel_shift[ch]))
+// A NULL per_channel_mult stands for a multiplier of 1, and a NULL
+// per_channel_shift stands for the layer-wide shift.
+//
+// Gemmini's accumulator applies a single rounding right-shift to every mvout,
+// and mvouts always start from the first column of an accumulator row. On
+// Gemmini, the multipliers must therefore be powers of two (they are folded
+// into the shift), and each DIM-wide block of output channels must end up with
+// a single shift. The CPU supports arbitrary multipliers and shifts.
+
+// Returns the accumulator shift which implements channel ch's requantization
+// on Gemmini, or -1 if Gemmini cannot implement it
+static int gemmini_channel_acc_shift(const acc_t * per_channel_mult,
+        const uint8_t * per_channel_shift, size_t ch, size_t shift) {
+  int acc_shift = per_channel_shift == NULL ? shift : per_channel_shift[ch];
+
+  if (per_channel_mult != NULL) {
+    acc_t mult = per_channel_mult[ch];
+
+    if (mult <= 0 || (mult & (mult - 1)) != 0)
+      return -1;
+
+    for (; mult > 1; mult >>= 1)
+      acc_shift--;
+  }
+
+  return acc_shift < 0 ? -1 : acc_shift;
+}
+
+// Returns the accumulator shift shared by channels ch to ch+cols-1, or -1 if
+// they do not share one
+static int gemmini_channel_block_acc_shift(const acc_t * per_channel_mult,
+        const uint8_t * per_channel_shift, size_t ch, size_t cols, size_t shift) {
+  const int acc_shift = gemmini_channel_acc_shift(per_channel_mult, per_channel_shift, ch, shift);
+
+  for (size_t c = 1; c < cols; c++) {
+    if (gemmini_channel_acc_shift(per_channel_mult, per_channel_shift, ch + c, shift) != acc_shift)
+      return -1;
+  }
+
+  return acc_shift;
+}
+
 // Tiling functions
 static void sp_tiled_matmul_os(const elem_t * A, const elem_t * B, const acc_t * D, elem_t * C,
         scale_t A_scale_factor, scale_t B_scale_factor, scale_acc_t D_scale_factor,
         size_t I, size_t J, size_t K, size_t pad_I, size_t pad_J, size_t pad_K,
         size_t A_row_stride, size_t B_row_stride, size_t D_row_stride, size_t C_row_stride,
-        bool no_bias, bool repeating_bias) {
+        bool no_bias, bool repeating_bias,
+        int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift) {
 
   const uint32_t A_sp_addr_start = 0;
   const uint32_t B_sp_addr_start = BANK_NUM * BANK_ROWS - K * J * DIM;
@@ -335,7 +450,7 @@ static void sp_tiled_matmul_os(const elem_t * A, const elem_t * B, const acc_t *
   }
 
   // Move-out C
-  if (C != NULL) {
+  if (C != NULL && per_channel_mult == NULL && per_channel_shift == NULL) {
     for (size_t i = 0; i < I; i++) {
       for (size_t j = 0; j < J; j++) {
         elem_t * const C_dram_addr = C + (i*C_row_stride + j)*DIM;
@@ -347,6 +462,32 @@ static void sp_tiled_matmul_os(const elem_t * A, const elem_t * B, const acc_t *
         gemmini_extended_mvout(C_dram_addr, C_sp_addr, C_cols, C_rows);
       }
     }
+  } else if (C != NULL) {
+    // Every column block gets its own accumulator shift, so we move out
+    // column-by-column and only reconfigure when the shift changes
+    int last_acc_shift = -1;
+
+    for (size_t j = 0; j < J; j++) {
+      const size_t C_cols = DIM - (j == J - 1 ? pad_J : 0);
+      const int acc_shift = gemmini_channel_block_acc_shift(
+          per_channel_mult, per_channel_shift, j*DIM, C_cols, shift);
+
+      if (acc_shift != last_acc_shift) {
+        gemmini_config_ex(OUTPUT_STATIONARY, act, 0, acc_shift, relu6_shift);
+        last_acc_shift = acc_shift;
+      }
+
+      for (size_t i = 0; i < I; i++) {
+        elem_t * const C_dram_addr = C + (i*C_row_stride + j)*DIM;
+        const uint32_t C_sp_addr = C_sp_addr_start + (i*J + j)*DIM;
+
+        const size_t C_rows = DIM - (i == I - 1 ? pad_I : 0);
+
+        gemmini_extended_mvout(C_dram_addr, C_sp_addr, C_cols, C_rows);
+      }
+    }
+
+    gemmini_config_ex(OUTPUT_STATIONARY, act, 0, shift, relu6_shift);
   }
 }
 
@@ -355,7 +496,9 @@ static void sp_tiled_matmul_ws(const elem_t * A, const elem_t * B,
         scale_t A_scale_factor, scale_t B_scale_factor, scale_acc_t D_scale_factor,
         size_t I, size_t J, size_t K, size_t pad_I, size_t pad_J, size_t pad_K,
         size_t A_row_stride, size_t B_row_stride, size_t D_row_stride, size_t C_row_stride,
-        bool no_bias, bool repeating_bias) {
+        bool no_bias, bool repeating_bias,
+        int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift) {
 
   const uint32_t A_sp_addr_start = 0;
   const uint32_t B_sp_addr_start = BANK_NUM * BANK_ROWS - K * J * DIM;
@@ -455,7 +598,7 @@ static void sp_tiled_matmul_ws(const elem_t * A, const elem_t * B,
   }
 
   // Move-out C
-  if (C != NULL) {
+  if (C != NULL && per_channel_mult == NULL && per_channel_shift == NULL) {
     for (size_t i = 0; i < I; i++) {
       for (size_t j = 0; j < J; j++) {
         elem_t * const C_dram_addr = C + (i*C_row_stride + j)*DIM;
@@ -467,17 +610,88 @@ static void sp_tiled_matmul_ws(const elem_t * A, const elem_t * B,
         gemmini_extended_mvout(C_dram_addr, C_sp_addr, C_cols, C_rows);
       }
     }
+  } else if (C != NULL) {
+    // Every column block gets its own accumulator shift, so we move out
+    // column-by-column and only reconfigure when the shift changes
+    int last_acc_shift = -1;
+
+    for (size_t j = 0; j < J; j++) {
+      const size_t C_cols = DIM - (j == J - 1 ? pad_J : 0);
+      const int acc_shift = gemmini_channel_block_acc_shift(
+          per_channel_mult, per_channel_shift, j*DIM, C_cols, shift);
+
+      if (acc_shift != last_acc_shift) {
+        gemmini_config_ex(WEIGHT_STATIONARY, act, 0, acc_shift, relu6_shift);
+        last_acc_shift = acc_shift;
+      }
+
+      for (size_t i = 0; i < I; i++) {
+        elem_t * const C_dram_addr = C + (i*C_row_stride + j)*DIM;
+        const uint32_t C_sp_addr = C_sp_addr_start + (i*J + j)*DIM;
+
+        const size_t C_rows = DIM - (i == I - 1 ? pad_I : 0);
+
+        gemmini_extended_mvout(C_dram_addr, C_sp_addr, C_cols, C_rows);
+      }
+    }
+
+    gemmini_config_ex(WEIGHT_STATIONARY, act, 0, shift, relu6_shift);
   }
 }
 
+// Completion tokens
+//
+// Gemmini runs the commands it is sent in the background, so a matmul or conv
+// only has to wait for Gemmini at its very end, before the CPU may use its
+// output. The async versions of tiled_matmul_auto and tiled_conv_auto skip
+// that wait, and return a token for the work instead. gemmini_wait(token)
+// blocks until the work is done. Until then, the CPU must neither write to the
+// work's inputs nor touch its output, and neither may later Gemmini work that
+// reads the output, since Gemmini doesn't order its own DRAM accesses.
+//
+// Gemmini can only wait for all the work it was sent, so tokens are numbered
+// in the order the work was issued, and waiting for one token completes every
+// token up to the newest one. Work that runs on the CPU is done by the time
+// its token is returned, as is everything before a blocking call.
+
+typedef uint64_t gemmini_token_t;
+
+// A token for work that is already done
+#define GEMMINI_TOKEN_DONE 0
+
+static gemmini_token_t gemmini_token_issued = GEMMINI_TOKEN_DONE;
+static gemmini_token_t gemmini_token_completed = GEMMINI_TOKEN_DONE;
+static bool gemmini_async = false;
+
+static void gemmini_complete() {
+  gemmini_fence();
+  gemmini_token_completed = gemmini_token_issued;
+}
+
+// Ends a Gemmini matmul or conv, by waiting for it unless it's async
+static void gemmini_end_op() {
+  if (!gemmini_async)
+    gemmini_complete();
+}
+
+static bool gemmini_done(gemmini_token_t token) {
+  return token <= gemmini_token_completed;
+}
+
+static void gemmini_wait(gemmini_token_t token) {
+  if (!gemmini_done(token))
+    gemmini_complete();
+}
+
 static void tiled_matmul_outer(size_t dim_I, size_t dim_J, size_t dim_K,
         const elem_t* A, const elem_t* B,
         const acc_t * D, elem_t* C,
         size_t stride_A, size_t stride_B, size_t stride_D, size_t stride_C,
         scale_t A_scale_factor, scale_t B_scale_factor, scale_acc_t D_scale_factor,
         size_t tile_I, size_t tile_J, size_t tile_K,
-        int act, int shift, size_t relu6_shift, bool repeating_bias,
-        int dataflow) {
+        int act, int shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift,
+        bool repeating_bias, int dataflow) {
 
   const size_t dim_I_padded = (dim_I / DIM + (dim_I % DIM != 0)) * DIM;
   const size_t dim_J_padded = (dim_J / DIM + (dim_J % DIM != 0)) * DIM;
@@ -529,6 +743,9 @@ static void tiled_matmul_outer(size_t dim_I, size_t dim_J, size_t dim_K,
         const size_t pad_J = j0 == J0-1 ? padding_J : 0;
         const size_t pad_K = k0 == K0-1 ? padding_K : 0;
 
+        const acc_t * mult = per_channel_mult == NULL ? NULL : per_channel_mult + j0*tile_J*DIM;
+        const uint8_t * mult_shift = per_channel_shift == NULL ? NULL : per_channel_shift + j0*tile_J*DIM;
+
         if (dataflow == OUTPUT_STATIONARY) {
           sp_tiled_matmul_os(A + i0*tile_I*DIM*stride_A + k0*tile_K*DIM,
               B + k0*tile_K*DIM*stride_B + j0*tile_J*DIM,
@@ -537,7 +754,9 @@ static void tiled_matmul_outer(size_t dim_I, size_t dim_J, size_t dim_K,
               I, J, K,
               pad_I, pad_J, pad_K,
               stride_A, stride_B, stride_D, stride_C,
-              no_bias, repeating_bias);
+              no_bias, repeating_bias,
+              act, shift, relu6_shift,
+              mult, mult_shift);
         } else {
           sp_tiled_matmul_ws(A + i0*tile_I*DIM*stride_A + k0*tile_K*DIM,
               B + k0*tile_K*DIM*stride_B + j0*tile_J*DIM,
@@ -546,11 +765,13 @@ static void tiled_matmul_outer(size_t dim_I, size_t dim_J, size_t dim_K,
               I, J, K,
               pad_I, pad_J, pad_K,
               stride_A, stride_B, stride_D, stride_C,
-              no_bias, repeating_bias);
+              no_bias, repeating_bias,
+              act, shift, relu6_shift,
+              mult, mult_shift);
         }
       }
 
-  gemmini_fence();
+  gemmini_end_op();
 }
 
 /*
@@ -610,141 +831,589 @@ static elem_t scale_and_sat(acc_t x, int act, size_t shift, size_t relu6_shift)
   return x;
 }
 
+// Same as scale_and_sat, but applies output channel ch's requantization
+// multiplier and shift, if there are any
+static elem_t scale_and_sat_per_channel(acc_t x, size_t ch, int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift) {
+  if (per_channel_mult == NULL && per_channel_shift == NULL)
+    return scale_and_sat(x, act, shift, relu6_shift);
+
+  full_t y = per_channel_mult == NULL ? x : (full_t)x * per_channel_mult[ch];
+  const int ch_shift = per_channel_shift == NULL ? shift : per_channel_shift[ch];
+
+  // Scale value down and round it
+  y = ROUNDING_RIGHT_SHIFT(y, ch_shift);
+  // Clip result
+  y = y > elem_t_max ? elem_t_max : (y < elem_t_min ? elem_t_min : y);
+  // Apply activation function
+  if (act == RELU) {
+    y = y < 0 ? 0 : y;
+  }
+  return y;
+}
+
 #ifdef HAS_MVIN_SCALE
 #define GEMMINI_SCALE(x, scale) ((x) * (scale))
 #else
 #define GEMMINI_SCALE(x, scale) x
 #endif
 
+// CPU matmul kernel
+//
+// matmul_cpu is cache-blocked in the usual way: a panel of B with NC columns
+// is packed once, A is packed in MC x KC blocks, and a register-blocked MR x NR
+// micro-kernel accumulates into an MC x NC tile of 32-bit partial sums. The
+// elem_t x elem_t products are summed in acc_t, exactly like the scalar loop,
+// so the results are bit-exact with scale_and_sat.
+//
+// Packed panels store KG consecutive k values next to each other. On x86 hosts
+// with SSE2 or AVX2, KG is 2 and the panels are widened to 16 bits so that the
+// micro-kernel can use pmaddwd. Elsewhere, the panels stay in elem_t and the
+// micro-kernel is plain C.
+#ifndef ELEM_T_IS_FLOAT
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+typedef int16_t matmul_cpu_pack_t;
+#define MATMUL_CPU_KG 2
+#define MATMUL_CPU_MR 4
+#if defined(__AVX2__)
+#define MATMUL_CPU_NR 16
+#else
+#define MATMUL_CPU_NR 8
+#endif
+#else
+typedef elem_t matmul_cpu_pack_t;
+#define MATMUL_CPU_KG 1
+#define MATMUL_CPU_MR 4
+#define MATMUL_CPU_NR 4
+#endif
+
+#define MATMUL_CPU_MC 64
+#define MATMUL_CPU_KC 256
+#define MATMUL_CPU_NC 256
+#define MATMUL_CPU_B_PACK_ELEMS (64 * 1024)
+
+#define MATMUL_CPU_ROUND_UP(x, n) (((x) + (n) - 1) / (n) * (n))
+
+// Packs rows [k0, k0+kc) and columns [j0, j0+nc) of B into NR-wide strips.
+// Every strip holds all kc rows, and out-of-bounds entries are zero.
+static void matmul_cpu_pack_B(const elem_t * B, size_t stride_B,
+        size_t k0, size_t kc, size_t j0, size_t nc,
+        matmul_cpu_pack_t * Bp) {
+  const size_t kc_padded = MATMUL_CPU_ROUND_UP(kc, MATMUL_CPU_KG);
+
+  for (size_t jr = 0; jr < nc; jr += MATMUL_CPU_NR) {
+    matmul_cpu_pack_t * strip = Bp + jr * kc_padded;
+    const size_t cols = nc - jr < MATMUL_CPU_NR ? nc - jr : MATMUL_CPU_NR;
+
+    for (size_t k = 0; k < kc_padded; k++) {
+      matmul_cpu_pack_t * dst = strip + (k / MATMUL_CPU_KG) * MATMUL_CPU_NR * MATMUL_CPU_KG + k % MATMUL_CPU_KG;
+      const elem_t * src = B + (k0 + k) * stride_B + j0 + jr;
+
+      size_t n = 0;
+      if (k < kc) {
+        for (; n < cols; n++)
+          dst[n * MATMUL_CPU_KG] = src[n];
+      }
+      for (; n < MATMUL_CPU_NR; n++)
+        dst[n * MATMUL_CPU_KG] = 0;
+    }
+  }
+}
+
+// Packs rows [i0, i0+mc) and columns [k0, k0+kc) of A into MR-tall strips
+static void matmul_cpu_pack_A(const elem_t * A, size_t stride_A,
+        size_t i0, size_t mc, size_t k0, size_t kc,
+        matmul_cpu_pack_t * Ap) {
+  const size_t kc_padded = MATMUL_CPU_ROUND_UP(kc, MATMUL_CPU_KG);
+
+  for (size_t ir = 0; ir < mc; ir += MATMUL_CPU_MR) {
+    matmul_cpu_pack_t * strip = Ap + ir * kc_padded;
+    const size_t rows = mc - ir < MATMUL_CPU_MR ? mc - ir : MATMUL_CPU_MR;
+
+    for (size_t r = 0; r < MATMUL_CPU_MR; r++) {
+      matmul_cpu_pack_t * dst = strip + r * MATMUL_CPU_KG;
+      const elem_t * src = A + (i0 + ir + r) * stride_A + k0;
+
+      for (size_t k = 0; k < kc_padded; k++) {
+        dst[(k / MATMUL_CPU_KG) * MATMUL_CPU_MR * MATMUL_CPU_KG + k % MATMUL_CPU_KG] =
+          r < rows && k < kc ? src[k] : 0;
+      }
+    }
+  }
+}
+
+// Adds the product of one packed strip of A and one packed strip of B to an
+// MR x NR block of the accumulator tile
+static void matmul_cpu_micro_kernel(size_t kc_padded,
+        const matmul_cpu_pack_t * Ap, const matmul_cpu_pack_t * Bp,
+        acc_t * acc, size_t stride_acc) {
+#if defined(__AVX2__)
+  __m256i c[MATMUL_CPU_MR][2];
+  for (size_t r = 0; r < MATMUL_CPU_MR; r++) {
+    c[r][0] = _mm256_setzero_si256();
+    c[r][1] = _mm256_setzero_si256();
+  }
+
+  for (size_t k = 0; k < kc_padded; k += 2) {
+    const __m256i b0 = _mm256_loadu_si256((const __m256i *)Bp);
+    const __m256i b1 = _mm256_loadu_si256((const __m256i *)(Bp + 16));
+
+    for (size_t r = 0; r < MATMUL_CPU_MR; r++) {
+      int32_t a_pair;
+      memcpy(&a_pair, Ap + 2*r, sizeof(a_pair));
+      const __m256i a = _mm256_set1_epi32(a_pair);
+
+      c[r][0] = _mm256_add_epi32(c[r][0], _mm256_madd_epi16(a, b0));
+      c[r][1] = _mm256_add_epi32(c[r][1], _mm256_madd_epi16(a, b1));
+    }
+
+    Ap += MATMUL_CPU_MR * 2;
+    Bp += MATMUL_CPU_NR * 2;
+  }
+
+  for (size_t r = 0; r < MATMUL_CPU_MR; r++) {
+    __m256i * row = (__m256i *)(acc + r * stride_acc);
+    _mm256_storeu_si256(row, _mm256_add_epi32(_mm256_loadu_si256(row), c[r][0]));
+    _mm256_storeu_si256(row + 1, _mm256_add_epi32(_mm256_loadu_si256(row + 1), c[r][1]));
+  }
+#elif defined(__SSE2__)
+  __m128i c[MATMUL_CPU_MR][2];
+  for (size_t r = 0; r < MATMUL_CPU_MR; r++) {
+    c[r][0] = _mm_setzero_si128();
+    c[r][1] = _mm_setzero_si128();
+  }
+
+  for (size_t k = 0; k < kc_padded; k += 2) {
+    const __m128i b0 = _mm_loadu_si128((const __m128i *)Bp);
+    const __m128i b1 = _mm_loadu_si128((const __m128i *)(Bp + 8));
+
+    for (size_t r = 0; r < MATMUL_CPU_MR; r++) {
+      int32_t a_pair;
+      memcpy(&a_pair, Ap + 2*r, sizeof(a_pair));
+      const __m128i a = _mm_set1_epi32(a_pair);
+
+      c[r][0] = _mm_add_epi32(c[r][0], _mm_madd_epi16(a, b0));
+      c[r][1] = _mm_add_epi32(c[r][1], _mm_madd_epi16(a, b1));
+    }
+
+    Ap += MATMUL_CPU_MR * 2;
+    Bp += MATMUL_CPU_NR * 2;
+  }
+
+  for (size_t r = 0; r < MATMUL_CPU_MR; r++) {
+    __m128i * row = (__m128i *)(acc + r * stride_acc);
+    _mm_storeu_si128(row, _mm_add_epi32(_mm_loadu_si128(row), c[r][0]));
+    _mm_storeu_si128(row + 1, _mm_add_epi32(_mm_loadu_si128(row + 1), c[r][1]));
+  }
+#else
+  acc_t c[MATMUL_CPU_MR][MATMUL_CPU_NR] = {{0}};
+
+  for (size_t k = 0; k < kc_padded; k++) {
+    for (size_t r = 0; r < MATMUL_CPU_MR; r++)
+      for (size_t n = 0; n < MATMUL_CPU_NR; n++)
+        c[r][n] += Ap[r] * Bp[n];
+
+    Ap += MATMUL_CPU_MR;
+    Bp += MATMUL_CPU_NR;
+  }
+
+  for (size_t r = 0; r < MATMUL_CPU_MR; r++)
+    for (size_t n = 0; n < MATMUL_CPU_NR; n++)
+      acc[r * stride_acc + n] += c[r][n];
+#endif
+}
+
+// Multiplies rows [i0, i0+mc) of A with an already-packed panel of B, which
+// covers columns [j0, j0+nc), and writes the scaled results into C
+static void matmul_cpu_block(size_t i0, size_t mc, size_t j0, size_t nc, size_t dim_K,
+        const elem_t* A, const matmul_cpu_pack_t * Bp, const acc_t * D, elem_t* C,
+        size_t stride_A, size_t stride_D, size_t stride_C,
+        acc_t AB_scale, scale_acc_t D_scale_factor,
+        int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift,
+        bool repeating_bias,
+        matmul_cpu_pack_t * Ap, acc_t * acc) {
+
+  const size_t dim_K_padded = MATMUL_CPU_ROUND_UP(dim_K, MATMUL_CPU_KG);
+  const size_t stride_acc = MATMUL_CPU_ROUND_UP(nc, MATMUL_CPU_NR);
+
+  for (size_t i = 0; i < mc; i++)
+    for (size_t j = 0; j < stride_acc; j++)
+      acc[i * stride_acc + j] = 0;
+
+  for (size_t k0 = 0; k0 < dim_K; k0 += MATMUL_CPU_KC) {
+    const size_t kc = dim_K - k0 < MATMUL_CPU_KC ? dim_K - k0 : MATMUL_CPU_KC;
+    const size_t kc_padded = MATMUL_CPU_ROUND_UP(kc, MATMUL_CPU_KG);
+
+    matmul_cpu_pack_A(A, stride_A, i0, mc, k0, kc, Ap);
+
+    for (size_t jr = 0; jr < nc; jr += MATMUL_CPU_NR) {
+      const matmul_cpu_pack_t * B_strip = Bp + jr * dim_K_padded + k0 * MATMUL_CPU_NR;
+
+      for (size_t ir = 0; ir < mc; ir += MATMUL_CPU_MR) {
+        acc_t * acc_block = acc + ir * stride_acc + jr;
+
+        if (ir + MATMUL_CPU_MR <= mc) {
+          matmul_cpu_micro_kernel(kc_padded, Ap + ir * kc_padded, B_strip, acc_block, stride_acc);
+        } else {
+          // Edge rows go through a scratch block, so that the micro-kernel
+          // never writes past the end of the accumulator tile
+          acc_t edge[MATMUL_CPU_MR * MATMUL_CPU_NR] = {0};
+          matmul_cpu_micro_kernel(kc_padded, Ap + ir * kc_padded, B_strip, edge, MATMUL_CPU_NR);
+
+          for (size_t r = 0; r < mc - ir; r++)
+            for (size_t n = 0; n < MATMUL_CPU_NR; n++)
+              acc_block[r * stride_acc + n] += edge[r * MATMUL_CPU_NR + n];
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < mc; i++) {
+    const size_t bias_row = repeating_bias ? 0 : i0 + i;
+
+    for (size_t j = 0; j < nc; j++) {
+      // The products were summed before being scaled, so we do the scaling in
+      // unsigned arithmetic to wrap around exactly like the scalar loop would
+      const uint32_t bias = D == NULL ? 0 :
+        (uint32_t)GEMMINI_SCALE(*(D + bias_row * stride_D + j0 + j), D_scale_factor);
+      const acc_t result = (acc_t)(bias + (uint32_t)acc[i * stride_acc + j] * (uint32_t)AB_scale);
+
+      *(C + (i0 + i)*stride_C + j0 + j) = scale_and_sat_per_channel(result, j0 + j, act, shift, relu6_shift,
+          per_channel_mult, per_channel_shift);
+    }
+  }
+}
+
+struct matmul_cpu_args {
+  size_t DIM_I, DIM_K;
+  const elem_t * A;
+  const elem_t * B;
+  const acc_t * D;
+  elem_t * C;
+  size_t stride_A, stride_B, stride_D, stride_C;
+  acc_t AB_scale;
+  scale_acc_t D_scale_factor;
+  int act;
+  size_t shift, relu6_shift;
+  const acc_t * per_channel_mult;
+  const uint8_t * per_channel_shift;
+  bool repeating_bias;
+
+  // The panel of B that is currently being worked on
+  matmul_cpu_pack_t * Bp;
+  size_t j0, nc;
+  size_t mc;
+};
+
+// B panels are per-thread too, so that several threads can each run a whole
+// matmul_cpu of their own at once (see tiled_matmul's WS_CPU mode)
+static matmul_cpu_pack_t matmul_cpu_Bp[GEMMINI_MAX_THREADS][MATMUL_CPU_B_PACK_ELEMS];
+static matmul_cpu_pack_t matmul_cpu_Ap[GEMMINI_MAX_THREADS][MATMUL_CPU_MC * MATMUL_CPU_ROUND_UP(MATMUL_CPU_KC, MATMUL_CPU_KG)];
+static acc_t matmul_cpu_acc[GEMMINI_MAX_THREADS][MATMUL_CPU_MC * MATMUL_CPU_NC];
+
+// Packs NR-wide strips [start, end) of the current panel of B
+static void matmul_cpu_pack_B_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  struct matmul_cpu_args * args = (struct matmul_cpu_args *)args_;
+  const size_t dim_K_padded = MATMUL_CPU_ROUND_UP(args->DIM_K, MATMUL_CPU_KG);
+
+  const size_t jr = start * MATMUL_CPU_NR;
+  const size_t cols = end * MATMUL_CPU_NR < args->nc ? (end - start) * MATMUL_CPU_NR : args->nc - jr;
+
+  matmul_cpu_pack_B(args->B, args->stride_B, 0, args->DIM_K, args->j0 + jr, cols,
+      args->Bp + jr * dim_K_padded);
+}
+
+// Computes MC-tall row blocks [start, end) of the current panel of C
+static void matmul_cpu_block_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  struct matmul_cpu_args * args = (struct matmul_cpu_args *)args_;
+
+  for (size_t block = start; block < end; block++) {
+    const size_t i0 = block * args->mc;
+    const size_t mc = args->DIM_I - i0 < args->mc ? args->DIM_I - i0 : args->mc;
+
+    matmul_cpu_block(i0, mc, args->j0, args->nc, args->DIM_K,
+        args->A, args->Bp, args->D, args->C,
+        args->stride_A, args->stride_D, args->stride_C,
+        args->AB_scale, args->D_scale_factor,
+        args->act, args->shift, args->relu6_shift,
+        args->per_channel_mult, args->per_channel_shift,
+        args->repeating_bias,
+        matmul_cpu_Ap[thread_id], matmul_cpu_acc[thread_id]);
+  }
+}
+
+#endif // ELEM_T_IS_FLOAT
+
 static void matmul_cpu(size_t DIM_I, size_t DIM_J, size_t DIM_K,
         const elem_t* A, const elem_t* B, const acc_t * D,
         elem_t* C,
         size_t stride_A, size_t stride_B, size_t stride_D, size_t stride_C,
         scale_t A_scale_factor, scale_t B_scale_factor, scale_acc_t D_scale_factor,
-        int act, size_t shift, size_t relu6_shift, bool repeating_bias) {
+        int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift,
+        bool repeating_bias) {
+
+#ifndef ELEM_T_IS_FLOAT
+  matmul_cpu_pack_t * Bp = matmul_cpu_Bp[gemmini_pool_thread_id];
+
+  const size_t dim_K_padded = MATMUL_CPU_ROUND_UP(DIM_K, MATMUL_CPU_KG);
+
+  // The whole K extent of a panel of B is packed at once, so the panel gets
+  // narrower as K gets larger
+  size_t max_nc = MATMUL_CPU_B_PACK_ELEMS / (dim_K_padded == 0 ? 1 : dim_K_padded);
+  max_nc = max_nc / MATMUL_CPU_NR * MATMUL_CPU_NR;
+  if (max_nc > MATMUL_CPU_NC)
+    max_nc = MATMUL_CPU_NC;
+
+  if (max_nc > 0) {
+    struct matmul_cpu_args args = {
+      .DIM_I = DIM_I, .DIM_K = DIM_K,
+      .A = A, .B = B, .D = D, .C = C,
+      .stride_A = stride_A, .stride_B = stride_B, .stride_D = stride_D, .stride_C = stride_C,
+      .AB_scale = GEMMINI_SCALE(GEMMINI_SCALE(1, A_scale_factor), B_scale_factor),
+      .D_scale_factor = D_scale_factor,
+      .act = act, .shift = shift, .relu6_shift = relu6_shift,
+      .per_channel_mult = per_channel_mult, .per_channel_shift = per_channel_shift,
+      .repeating_bias = repeating_bias,
+      .Bp = Bp,
+    };
+
+    // Short matrices are cut into shorter row blocks, so that every thread
+    // still gets some of them
+    const size_t threads = gemmini_num_threads();
+    args.mc = MATMUL_CPU_ROUND_UP((DIM_I + threads - 1) / threads, MATMUL_CPU_MR);
+    if (args.mc > MATMUL_CPU_MC)
+      args.mc = MATMUL_CPU_MC;
+    else if (args.mc == 0)
+      args.mc = MATMUL_CPU_MR;
+
+    for (size_t j0 = 0; j0 < DIM_J; j0 += max_nc) {
+      args.j0 = j0;
+      args.nc = DIM_J - j0 < max_nc ? DIM_J - j0 : max_nc;
+
+      gemmini_parallel_for((args.nc + MATMUL_CPU_NR - 1) / MATMUL_CPU_NR, 1,
+          matmul_cpu_pack_B_task, &args);
+
+      gemmini_parallel_for((DIM_I + args.mc - 1) / args.mc, 1,
+          matmul_cpu_block_task, &args);
+    }
+
+    return;
+  }
+#endif
 
+  // Fallback for float types, or for a K too large to pack even one strip of B
   const int no_bias = D == NULL;
-  if (/* TODO */ false && DIM_I % 4 == 0 && DIM_J % 4 == 0) {
-    for (size_t i = 0; i < DIM_I; i += 4) {
-      for (size_t j = 0; j < DIM_J; j += 4) {
 
-        acc_t result[4][4]; // = {{0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}};
+  for (size_t i = 0; i < DIM_I; i++) {
+    for (size_t j = 0; j < DIM_J; j++) {
 
-        for (size_t ii = 0; ii < 4; ii++)
-          for (size_t jj = 0; jj < 4; jj++) {
-            const size_t bias_row = repeating_bias ? 0 : i + ii;
-            result[ii][jj] = no_bias ? 0 :
-              GEMMINI_SCALE(*(D + bias_row*stride_D + j + jj), D_scale_factor);
-          }
+      const size_t bias_row = repeating_bias ? 0 : i;
 
-        for (size_t k = 0; k < DIM_K; k++) {
-          result[0][0] +=
-                GEMMINI_SCALE(*(A + i*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j), B_scale_factor);
-          result[0][1] +=
-                GEMMINI_SCALE(*(A + i*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j+1), B_scale_factor);
-          result[0][2] +=
-                GEMMINI_SCALE(*(A + i*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j+2), B_scale_factor);
-          result[0][3] +=
-                GEMMINI_SCALE(*(A + i*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j+3), B_scale_factor);
-          result[1][0] +=
-                GEMMINI_SCALE(*(A + (i+1)*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j), B_scale_factor);
-          result[1][1] +=
-                GEMMINI_SCALE(*(A + (i+1)*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j+1), B_scale_factor);
-          result[1][2] +=
-                GEMMINI_SCALE(*(A + (i+1)*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j+2), B_scale_factor);
-          result[1][3] +=
-                GEMMINI_SCALE(*(A + (i+1)*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j+3), B_scale_factor);
-          result[2][0] +=
-                GEMMINI_SCALE(*(A + (i+2)*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j), B_scale_factor);
-          result[2][1] +=
-                GEMMINI_SCALE(*(A + (i+2)*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j+1), B_scale_factor);
-          result[2][2] +=
-                GEMMINI_SCALE(*(A + (i+2)*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j+2), B_scale_factor);
-          result[2][3] +=
-                GEMMINI_SCALE(*(A + (i+2)*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j+3), B_scale_factor);
-          result[3][0] +=
-                GEMMINI_SCALE(*(A + (i+3)*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j), B_scale_factor);
-          result[3][1] +=
-                GEMMINI_SCALE(*(A + (i+3)*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j+1), B_scale_factor);
-          result[3][2] +=
-                GEMMINI_SCALE(*(A + (i+3)*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j+2), B_scale_factor);
-          result[3][3] +=
-                GEMMINI_SCALE(*(A + (i+3)*stride_A + k), A_scale_factor) *
-                GEMMINI_SCALE(*(B + k*stride_B + j+3), B_scale_factor);
-        }
+      acc_t result = no_bias ? 0 : GEMMINI_SCALE(*(D + bias_row * stride_D + j), D_scale_factor);
 
-        *(C + i*stride_C + j) =
-             scale_and_sat(result[0][0], act, shift, relu6_shift);
-        *(C + i*stride_C + j+1) =
-             scale_and_sat(result[0][1], act, shift, relu6_shift);
-        *(C + i*stride_C + j+2) =
-             scale_and_sat(result[0][2], act, shift, relu6_shift);
-        *(C + i*stride_C + j+3) =
-             scale_and_sat(result[0][3], act, shift, relu6_shift);
-        *(C + (i+1)*stride_C + j) =
-             scale_and_sat(result[1][0], act, shift, relu6_shift);
-        *(C + (i+1)*stride_C + j+1) =
-             scale_and_sat(result[1][1], act, shift, relu6_shift);
-        *(C + (i+1)*stride_C + j+2) =
-             scale_and_sat(result[1][2], act, shift, relu6_shift);
-        *(C + (i+1)*stride_C + j+3) =
-             scale_and_sat(result[1][3], act, shift, relu6_shift);
-        *(C + (i+2)*stride_C + j) =
-             scale_and_sat(result[2][0], act, shift, relu6_shift);
-        *(C + (i+2)*stride_C + j+1) =
-             scale_and_sat(result[2][1], act, shift, relu6_shift);
-        *(C + (i+2)*stride_C + j+2) =
-             scale_and_sat(result[2][2], act, shift, relu6_shift);
-        *(C + (i+2)*stride_C + j+3) =
-             scale_and_sat(result[2][3], act, shift, relu6_shift);
-        *(C + (i+3)*stride_C + j) =
-             scale_and_sat(result[3][0], act, shift, relu6_shift);
-        *(C + (i+3)*stride_C + j+1) =
-             scale_and_sat(result[3][1], act, shift, relu6_shift);
-        *(C + (i+3)*stride_C + j+2) =
-             scale_and_sat(result[3][2], act, shift, relu6_shift);
-        *(C + (i+3)*stride_C + j+3) =
-             scale_and_sat(result[3][3], act, shift, relu6_shift);
+      for (size_t k = 0; k < DIM_K; k++) {
+        result += GEMMINI_SCALE(*(A + i*stride_A + k), A_scale_factor) * GEMMINI_SCALE(*((elem_t*)B + k*stride_B + j), B_scale_factor);
       }
+
+      *(C + i*stride_C + j) = scale_and_sat_per_channel(result, j, act, shift, relu6_shift,
+          per_channel_mult, per_channel_shift);
     }
-  } else {
-    for (size_t i = 0; i < DIM_I; i++) {
-      for (size_t j = 0; j < DIM_J; j++) {
+  }
+}
 
-        const size_t bias_row = repeating_bias ? 0 : i;
+#undef GEMMINI_SCALE
 
-        acc_t result = no_bias ? 0 : GEMMINI_SCALE(*(D + bias_row * stride_D + j), D_scale_factor);
+// General matmul which can be run with different dataflows, or on the CPU
+enum tiled_matmul_type_t {OS, WS, CPU, WS_CPU}; // TODO rename this so it's name also applies to convs
 
-        for (size_t k = 0; k < DIM_K; k++) {
-          acc_t past_opixel = result;
-          result += GEMMINI_SCALE(*(A + i*stride_A + k), A_scale_factor) * GEMMINI_SCALE(*((elem_t*)B + k*stride_B + j), B_scale_factor);
-        }
+uint64_t read_cycles() {
+    uint64_t cycles;
+    asm volatile ("rdcycle %0" : "=r" (cycles));
+    return cycles;
 
-        *(C + i*stride_C + j) = scale_and_sat(result, act, shift, relu6_shift);
-      }
+    // const uint32_t * mtime = (uint32_t *)(33554432 + 0xbff8);
+    // const uint32_t * mtime = (uint32_t *)(33554432 + 0xbffc);
+    // return *mtime;
+}
+
+// Heterogeneous matmuls
+//
+// In WS_CPU mode, tiled_matmul gives the first rows of C to Gemmini, which
+// runs them in the weight-stationary dataflow, and hands the remaining rows
+// to the worker threads, which run matmul_cpu on them. The share of rows that
+// goes to the CPU is tuned online for every matmul shape. After each call, the
+// rows per cycle measured on both sides give the split at which both sides
+// would have finished together, and the share moves halfway towards it.
+#define HETERO_SHARE_ONE 1024
+#define HETERO_SHARE_INIT (HETERO_SHARE_ONE / 8)
+#define HETERO_SHARE_MIN (HETERO_SHARE_ONE / 64)
+#define HETERO_SHARE_MAX (HETERO_SHARE_ONE - HETERO_SHARE_MIN)
+#define HETERO_TABLE_SIZE 16
+
+struct tiled_matmul_hetero_entry {
+  size_t dim_I, dim_J, dim_K;
+  size_t cpu_share; // Out of HETERO_SHARE_ONE
+};
+
+static struct tiled_matmul_hetero_entry tiled_matmul_hetero_table[HETERO_TABLE_SIZE];
+
+static struct tiled_matmul_hetero_entry * tiled_matmul_hetero_entry(size_t dim_I, size_t dim_J, size_t dim_K) {
+  const size_t hash = (dim_I * 31 + dim_J) * 31 + dim_K;
+  struct tiled_matmul_hetero_entry * entry = &tiled_matmul_hetero_table[hash % HETERO_TABLE_SIZE];
+
+  if (entry->dim_I != dim_I || entry->dim_J != dim_J || entry->dim_K != dim_K || entry->cpu_share == 0) {
+    entry->dim_I = dim_I;
+    entry->dim_J = dim_J;
+    entry->dim_K = dim_K;
+    entry->cpu_share = HETERO_SHARE_INIT;
+  }
+
+  return entry;
+}
+
+struct tiled_matmul_hetero_args {
+  size_t row0, rows, chunk_rows;
+  size_t dim_J, dim_K;
+  const elem_t * A;
+  const elem_t * B;
+  const acc_t * D;
+  elem_t * C;
+  size_t stride_A, stride_B, stride_D, stride_C;
+  scale_t A_scale_factor, B_scale_factor;
+  scale_acc_t D_scale_factor;
+  int act;
+  size_t shift, relu6_shift;
+  const acc_t * per_channel_mult;
+  const uint8_t * per_channel_shift;
+  bool repeating_bias;
+
+  // Summed over all the chunks the worker threads computed
+  uint64_t cpu_cycles;
+  size_t cpu_rows;
+};
+
+// Computes chunks [start, end) of the CPU's rows
+static void tiled_matmul_hetero_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  struct tiled_matmul_hetero_args * args = (struct tiled_matmul_hetero_args *)args_;
+
+  for (size_t chunk = start; chunk < end; chunk++) {
+    const size_t i0 = args->row0 + chunk * args->chunk_rows;
+    const size_t rows = args->row0 + args->rows - i0 < args->chunk_rows ?
+      args->row0 + args->rows - i0 : args->chunk_rows;
+
+    const uint64_t start_cycles = read_cycles();
+
+    matmul_cpu(rows, args->dim_J, args->dim_K,
+        args->A + i0 * args->stride_A, args->B,
+        args->D == NULL || args->repeating_bias ? args->D : args->D + i0 * args->stride_D,
+        args->C + i0 * args->stride_C,
+        args->stride_A, args->stride_B, args->stride_D, args->stride_C,
+        args->A_scale_factor, args->B_scale_factor, args->D_scale_factor,
+        args->act, args->shift, args->relu6_shift,
+        args->per_channel_mult, args->per_channel_shift,
+        args->repeating_bias);
+
+    // Chunks that the caller picks up in gemmini_parallel_join(), after
+    // finishing its Gemmini rows, are left out, since the rates below are
+    // those of the worker threads alone
+    if (thread_id != 0) {
+      __atomic_fetch_add(&args->cpu_cycles, read_cycles() - start_cycles, __ATOMIC_RELAXED);
+      __atomic_fetch_add(&args->cpu_rows, rows, __ATOMIC_RELAXED);
     }
   }
 }
 
-#undef GEMMINI_SCALE
+static void tiled_matmul_hetero(size_t dim_I, size_t dim_J, size_t dim_K,
+        const elem_t* A, const elem_t* B,
+        const acc_t * D, elem_t* C,
+        size_t stride_A, size_t stride_B, size_t stride_D, size_t stride_C,
+        scale_t A_scale_factor, scale_t B_scale_factor, scale_acc_t D_scale_factor,
+        size_t tile_I, size_t tile_J, size_t tile_K,
+        int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift,
+        bool repeating_bias) {
 
-// General matmul which can be run with different dataflows, or on the CPU
-enum tiled_matmul_type_t {OS, WS, CPU}; // TODO rename this so it's name also applies to convs
+  const size_t workers = gemmini_num_threads() - 1;
+
+  struct tiled_matmul_hetero_entry * entry = tiled_matmul_hetero_entry(dim_I, dim_J, dim_K);
+
+  // matmul_cpu doesn't implement RELU6, so those matmuls stay on Gemmini
+  // to keep all rows consistent
+  size_t gemmini_rows = dim_I;
+  if (workers > 0 && act != RELU6) {
+    const size_t cpu_rows = dim_I * entry->cpu_share / HETERO_SHARE_ONE;
+
+    // Gemmini gets whole DIM-row blocks
+    gemmini_rows = (dim_I - cpu_rows + DIM - 1) / DIM * DIM;
+    if (gemmini_rows > dim_I)
+      gemmini_rows = dim_I;
+  }
+
+  if (gemmini_rows == dim_I) {
+    tiled_matmul_outer(dim_I, dim_J, dim_K,
+        A, B, D, C,
+        stride_A, stride_B, stride_D, stride_C,
+        A_scale_factor, B_scale_factor, D_scale_factor,
+        tile_I, tile_J, tile_K,
+        act, shift, relu6_shift,
+        per_channel_mult, per_channel_shift,
+        repeating_bias, WEIGHT_STATIONARY);
+    return;
+  }
+
+  struct tiled_matmul_hetero_args args = {
+    .row0 = gemmini_rows, .rows = dim_I - gemmini_rows,
+    .dim_J = dim_J, .dim_K = dim_K,
+    .A = A, .B = B, .D = D, .C = C,
+    .stride_A = stride_A, .stride_B = stride_B, .stride_D = stride_D, .stride_C = stride_C,
+    .A_scale_factor = A_scale_factor, .B_scale_factor = B_scale_factor, .D_scale_factor = D_scale_factor,
+    .act = act, .shift = shift, .relu6_shift = relu6_shift,
+    .per_channel_mult = per_channel_mult, .per_channel_shift = per_channel_shift,
+    .repeating_bias = repeating_bias,
+  };
+
+  args.chunk_rows = (args.rows + workers - 1) / workers;
+  const size_t chunks = (args.rows + args.chunk_rows - 1) / args.chunk_rows;
+
+  const uint64_t start_cycles = read_cycles();
+
+  gemmini_parallel_fork(chunks, 1, tiled_matmul_hetero_task, &args);
+
+  if (gemmini_rows > 0) {
+    const size_t gemmini_tile_I = (gemmini_rows + DIM - 1) / DIM;
+
+    tiled_matmul_outer(gemmini_rows, dim_J, dim_K,
+        A, B, D, C,
+        stride_A, stride_B, stride_D, stride_C,
+        A_scale_factor, B_scale_factor, D_scale_factor,
+        tile_I < gemmini_tile_I ? tile_I : gemmini_tile_I, tile_J, tile_K,
+        act, shift, relu6_shift,
+        per_channel_mult, per_channel_shift,
+        repeating_bias, WEIGHT_STATIONARY);
+  }
+
+  const uint64_t gemmini_cycles = read_cycles() - start_cycles;
+
+  gemmini_parallel_join();
+
+  // Rows per cycle on each side, scaled to keep some precision in integers
+  if (gemmini_rows > 0 && gemmini_cycles > 0 && args.cpu_rows > 0 && args.cpu_cycles > 0) {
+    const uint64_t gemmini_rate = ((uint64_t)gemmini_rows << 20) / gemmini_cycles;
+    const uint64_t cpu_rate = ((uint64_t)args.cpu_rows << 20) * workers / args.cpu_cycles;
+
+    if (gemmini_rate + cpu_rate > 0) {
+      size_t target = cpu_rate * HETERO_SHARE_ONE / (gemmini_rate + cpu_rate);
+      target = target < HETERO_SHARE_MIN ? HETERO_SHARE_MIN :
+        (target > HETERO_SHARE_MAX ? HETERO_SHARE_MAX : target);
+
+      entry->cpu_share = (entry->cpu_share + target) / 2;
+    }
+  }
+}
 
 // This function runs a tiled matrix multiplication, with hardcoded tiling
 // factors
@@ -753,7 +1422,9 @@ void tiled_matmul(size_t dim_I, size_t dim_J, size_t dim_K,
         const acc_t * D, elem_t* C,
         size_t stride_A, size_t stride_B, size_t stride_D, size_t stride_C,
         scale_t A_scale_factor, scale_t B_scale_factor, scale_acc_t D_scale_factor,
-        int act, size_t shift, size_t relu6_shift, bool repeating_bias,
+        int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift,
+        bool repeating_bias,
         size_t tile_I, size_t tile_J, size_t tile_K,
         enum tiled_matmul_type_t tiled_matmul_type) {
 
@@ -806,35 +1477,68 @@ void tiled_matmul(size_t dim_I, size_t dim_J, size_t dim_K,
     printf("I, J, and K tiling factors must be less than 65535, to fit within the bounds of the LOOP_WS function");
     exit(1);
   }
+
+  if (tiled_matmul_type != CPU &&
+      (per_channel_mult != NULL || per_channel_shift != NULL)) {
+    for (size_t j = 0; j < dim_J; j += DIM) {
+      const size_t cols = dim_J - j > DIM ? DIM : dim_J - j;
+
+      if (gemmini_channel_block_acc_shift(per_channel_mult, per_channel_shift, j, cols, shift) < 0) {
+        printf("Per-channel scales of output channels %d to %d can't be applied on Gemmini\n", (int)j, (int)(j + cols - 1));
+        exit(1);
+      }
+    }
+  }
 #endif
 
-  // Run a tiled matrix multiplication on either Gemmini or the CPU
-  if (tiled_matmul_type == OS || tiled_matmul_type == WS) {
+  // Run a tiled matrix multiplication on either Gemmini or the CPU, or on both
+  if (tiled_matmul_type == WS_CPU) {
+      tiled_matmul_hetero(dim_I, dim_J, dim_K,
+              A, B, D, C,
+              stride_A, stride_B, stride_D, stride_C,
+              A_scale_factor, B_scale_factor, D_scale_factor,
+              tile_I, tile_J, tile_K,
+              act, shift, relu6_shift,
+              per_channel_mult, per_channel_shift,
+              repeating_bias);
+  } else if (tiled_matmul_type == OS || tiled_matmul_type == WS) {
       tiled_matmul_outer(dim_I, dim_J, dim_K,
               A, B, D, C,
               stride_A, stride_B, stride_D, stride_C,
               A_scale_factor, B_scale_factor, D_scale_factor,
               tile_I, tile_J, tile_K,
-              act, shift, relu6_shift, repeating_bias,
-              (int)tiled_matmul_type);
+              act, shift, relu6_shift,
+              per_channel_mult, per_channel_shift,
+              repeating_bias, (int)tiled_matmul_type);
   } else /*if (tiled_matmul_type == CPU)*/ {
       matmul_cpu(dim_I, dim_J, dim_K,
               A, B, D, C,
               stride_A, stride_B, stride_D, stride_C,
               A_scale_factor, B_scale_factor, D_scale_factor,
-              act, shift, relu6_shift, repeating_bias);
+              act, shift, relu6_shift,
+              per_channel_mult, per_channel_shift,
+              repeating_bias);
   }
 }
 
-// This function runs a tiled matrix multiplication, with automatically
-// calculated tiling factors
-void tiled_matmul_auto(size_t dim_I, size_t dim_J, size_t dim_K,
-        const elem_t* A, const elem_t* B,
-        const acc_t * D, elem_t* C,
-        size_t stride_A, size_t stride_B, size_t stride_D, size_t stride_C,
-        scale_t A_scale_factor, scale_t B_scale_factor, scale_acc_t D_scale_factor,
-        int act, size_t shift, size_t relu6_shift, bool repeating_bias,
-        enum tiled_matmul_type_t tiled_matmul_type) {
+// Whether tiled_matmul can run a matmul with these tiling factors
+static bool tiled_matmul_tiles_fit(size_t dim_I, size_t dim_J, size_t dim_K,
+        size_t tile_I, size_t tile_J, size_t tile_K) {
+  const size_t tiles_I = dim_I / DIM + (dim_I % DIM != 0);
+  const size_t tiles_J = dim_J / DIM + (dim_J % DIM != 0);
+  const size_t tiles_K = dim_K / DIM + (dim_K % DIM != 0);
+
+  return tile_I > 0 && tile_J > 0 && tile_K > 0 &&
+    tile_I <= tiles_I && tile_J <= tiles_J && tile_K <= tiles_K &&
+    tile_I <= 65535 && tile_J <= 65535 && tile_K <= 65535 &&
+    (tile_I * tile_K + tile_K * tile_J) * DIM <= BANK_NUM * BANK_ROWS &&
+    tile_I * tile_J * DIM <= ACC_ROWS;
+}
+
+// The tiling factors that tiled_matmul_auto picks when the tuning database has
+// none for a matmul
+static void tiled_matmul_auto_tiles(size_t dim_I, size_t dim_J, size_t dim_K,
+        size_t * tile_I, size_t * tile_J, size_t * tile_K) {
 #define partition_rows (BANK_NUM * BANK_ROWS / 2)
 #define mats_in_partition (partition_rows / DIM)
 #define mats_in_acc (ACC_ROWS / DIM)
@@ -845,17 +1549,9 @@ void tiled_matmul_auto(size_t dim_I, size_t dim_J, size_t dim_K,
     const size_t dim_J_padded = (dim_J / DIM + (dim_J % DIM != 0)) * DIM;
     const size_t dim_K_padded = (dim_K / DIM + (dim_K % DIM != 0)) * DIM;
 
-    const size_t tile_I = dim_I_padded/DIM < max_tile_i_j ? dim_I_padded/DIM : max_tile_i_j;
-    const size_t tile_J = dim_J_padded/DIM < max_tile_i_j ? dim_J_padded/DIM : max_tile_i_j;
-    const size_t tile_K = dim_K_padded/DIM < max_tile_k ? dim_K_padded/DIM : max_tile_k;
-
-    tiled_matmul(dim_I, dim_J, dim_K,
-        A, B, D, C, 
-        stride_A, stride_B, stride_D, stride_C,
-        A_scale_factor, B_scale_factor, D_scale_factor,
-        act, shift, relu6_shift, repeating_bias,
-        tile_I, tile_J, tile_K,
-        tiled_matmul_type);
+    *tile_I = dim_I_padded/DIM < max_tile_i_j ? dim_I_padded/DIM : max_tile_i_j;
+    *tile_J = dim_J_padded/DIM < max_tile_i_j ? dim_J_padded/DIM : max_tile_i_j;
+    *tile_K = dim_K_padded/DIM < max_tile_k ? dim_K_padded/DIM : max_tile_k;
 
 #undef partition_rows
 #undef mats_in_partition
@@ -864,17 +1560,511 @@ void tiled_matmul_auto(size_t dim_I, size_t dim_J, size_t dim_K,
 #undef max_tile_k
 }
 
-void sp_tiled_conv(
-        int batch_size, int in_dim, int in_channels,
-        int out_channels, int out_dim, int pool_out_dim,
+// Tuning database
+//
+// The tiling factors that tiled_matmul_auto and tiled_conv_auto calculate
+// just fill up the scratchpad and accumulator, and are often well off the
+// fastest ones for a shape. Both first look their shape up in a tuning
+// database, which imagenet/tune.c fills in with the tilings it measured to be
+// fastest, and only calculate tiling factors for shapes that aren't in it, or
+// whose entries don't fit this Gemmini's scratchpad and accumulator.
+//
+// A tuning database is a file of GEMMINI_TUNE_MATMUL and GEMMINI_TUNE_CONV
+// lines, which is valid C as well as easy to parse. Building with
+// -DGEMMINI_TUNING_DB=\"path\" compiles one in, which is the only way to use
+// one on baremetal. On Linux, gemmini_tune_load() also reads one at runtime.
+// Entries that were loaded or set at runtime take precedence over compiled-in
+// ones.
+#define GEMMINI_TUNE_MAX_ENTRIES 256
+
+struct gemmini_tune_matmul_entry {
+  size_t dim_I, dim_J, dim_K;
+  int type; // An enum tiled_matmul_type_t
+  size_t tile_I, tile_J, tile_K;
+};
+
+struct gemmini_tune_conv_entry {
+  // The pooling params are the ones tiled_conv uses, i.e. 1, 1, 0 without
+  // pooling
+  int batch_size, in_dim, in_channels, out_channels, out_dim;
+  int stride, padding, kernel_dim;
+  int pool_size, pool_stride, pool_padding;
+
+  // batches, porows, pocols, pochs, krows, kcols, kchs
+  int args[7];
+};
+
+#define GEMMINI_TUNE_MATMUL_FORMAT "GEMMINI_TUNE_MATMUL(%llu, %llu, %llu, %s, %llu, %llu, %llu)\n"
+#define GEMMINI_TUNE_CONV_FORMAT "GEMMINI_TUNE_CONV(%d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d)\n"
+
+#ifdef GEMMINI_TUNING_DB
+#define GEMMINI_TUNE_MATMUL(dim_I, dim_J, dim_K, type, tile_I, tile_J, tile_K) \
+  {dim_I, dim_J, dim_K, type, tile_I, tile_J, tile_K},
+#define GEMMINI_TUNE_CONV(...)
+static const struct gemmini_tune_matmul_entry gemmini_tune_builtin_matmuls[] = {
+#include GEMMINI_TUNING_DB
+  {0}
+};
+#undef GEMMINI_TUNE_MATMUL
+#undef GEMMINI_TUNE_CONV
+
+#define GEMMINI_TUNE_MATMUL(...)
+#define GEMMINI_TUNE_CONV(batch_size, in_dim, in_channels, out_channels, out_dim, stride, padding, kernel_dim, \
+    pool_size, pool_stride, pool_padding, batches, porows, pocols, pochs, krows, kcols, kchs) \
+  {batch_size, in_dim, in_channels, out_channels, out_dim, stride, padding, kernel_dim, \
+    pool_size, pool_stride, pool_padding, {batches, porows, pocols, pochs, krows, kcols, kchs}},
+static const struct gemmini_tune_conv_entry gemmini_tune_builtin_convs[] = {
+#include GEMMINI_TUNING_DB
+  {0}
+};
+#undef GEMMINI_TUNE_MATMUL
+#undef GEMMINI_TUNE_CONV
+
+#define GEMMINI_TUNE_BUILTIN_MATMULS (sizeof(gemmini_tune_builtin_matmuls)/sizeof(gemmini_tune_builtin_matmuls[0]) - 1)
+#define GEMMINI_TUNE_BUILTIN_CONVS (sizeof(gemmini_tune_builtin_convs)/sizeof(gemmini_tune_builtin_convs[0]) - 1)
+#else
+static const struct gemmini_tune_matmul_entry * gemmini_tune_builtin_matmuls = NULL;
+static const struct gemmini_tune_conv_entry * gemmini_tune_builtin_convs = NULL;
+#define GEMMINI_TUNE_BUILTIN_MATMULS 0
+#define GEMMINI_TUNE_BUILTIN_CONVS 0
+#endif
 
-        int stride, int padding, int kernel_dim,
+static struct gemmini_tune_matmul_entry gemmini_tune_matmuls[GEMMINI_TUNE_MAX_ENTRIES];
+static size_t gemmini_tune_n_matmuls = 0;
+static struct gemmini_tune_conv_entry gemmini_tune_convs[GEMMINI_TUNE_MAX_ENTRIES];
+static size_t gemmini_tune_n_convs = 0;
+
+static const char * gemmini_tune_type_name(int type) {
+  switch (type) {
+    case OS: return "OS";
+    case WS: return "WS";
+    case CPU: return "CPU";
+    case WS_CPU: return "WS_CPU";
+  }
+  return "?";
+}
 
-        int pool_size, int pool_stride, int pool_padding,
+static bool gemmini_tune_same_conv(const struct gemmini_tune_conv_entry * a,
+        const struct gemmini_tune_conv_entry * b) {
+  return a->batch_size == b->batch_size && a->in_dim == b->in_dim &&
+    a->in_channels == b->in_channels && a->out_channels == b->out_channels &&
+    a->out_dim == b->out_dim && a->stride == b->stride &&
+    a->padding == b->padding && a->kernel_dim == b->kernel_dim &&
+    a->pool_size == b->pool_size && a->pool_stride == b->pool_stride &&
+    a->pool_padding == b->pool_padding;
+}
 
-        int batches,
-        int porows, int pocols, int pochs,
-        int krows, int kcols, int kchs,
+static const struct gemmini_tune_matmul_entry * gemmini_tune_find_matmul(
+        size_t dim_I, size_t dim_J, size_t dim_K, int type) {
+  for (size_t i = 0; i < gemmini_tune_n_matmuls + GEMMINI_TUNE_BUILTIN_MATMULS; i++) {
+    const struct gemmini_tune_matmul_entry * entry = i < gemmini_tune_n_matmuls ?
+      &gemmini_tune_matmuls[i] : &gemmini_tune_builtin_matmuls[i - gemmini_tune_n_matmuls];
+
+    if (entry->dim_I == dim_I && entry->dim_J == dim_J && entry->dim_K == dim_K && entry->type == type)
+      return entry;
+  }
+  return NULL;
+}
+
+// Looks up the conv with the shape of *key
+static const struct gemmini_tune_conv_entry * gemmini_tune_find_conv(
+        const struct gemmini_tune_conv_entry * key) {
+  for (size_t i = 0; i < gemmini_tune_n_convs + GEMMINI_TUNE_BUILTIN_CONVS; i++) {
+    const struct gemmini_tune_conv_entry * entry = i < gemmini_tune_n_convs ?
+      &gemmini_tune_convs[i] : &gemmini_tune_builtin_convs[i - gemmini_tune_n_convs];
+
+    if (gemmini_tune_same_conv(entry, key))
+      return entry;
+  }
+  return NULL;
+}
+
+// Adds an entry, or replaces the one for the same matmul. Returns false if the
+// database is full.
+static bool gemmini_tune_set_matmul(const struct gemmini_tune_matmul_entry * entry) {
+  for (size_t i = 0; i < gemmini_tune_n_matmuls; i++) {
+    struct gemmini_tune_matmul_entry * old = &gemmini_tune_matmuls[i];
+    if (old->dim_I == entry->dim_I && old->dim_J == entry->dim_J && old->dim_K == entry->dim_K &&
+        old->type == entry->type) {
+      *old = *entry;
+      return true;
+    }
+  }
+
+  if (gemmini_tune_n_matmuls == GEMMINI_TUNE_MAX_ENTRIES)
+    return false;
+
+  gemmini_tune_matmuls[gemmini_tune_n_matmuls++] = *entry;
+  return true;
+}
+
+static bool gemmini_tune_set_conv(const struct gemmini_tune_conv_entry * entry) {
+  for (size_t i = 0; i < gemmini_tune_n_convs; i++) {
+    if (gemmini_tune_same_conv(&gemmini_tune_convs[i], entry)) {
+      gemmini_tune_convs[i] = *entry;
+      return true;
+    }
+  }
+
+  if (gemmini_tune_n_convs == GEMMINI_TUNE_MAX_ENTRIES)
+    return false;
+
+  gemmini_tune_convs[gemmini_tune_n_convs++] = *entry;
+  return true;
+}
+
+// Prints the entries that were loaded or set at runtime, in the format of a
+// tuning database
+static void gemmini_tune_print() {
+  for (size_t i = 0; i < gemmini_tune_n_matmuls; i++) {
+    const struct gemmini_tune_matmul_entry * e = &gemmini_tune_matmuls[i];
+    printf(GEMMINI_TUNE_MATMUL_FORMAT, (unsigned long long)e->dim_I, (unsigned long long)e->dim_J, (unsigned long long)e->dim_K,
+        gemmini_tune_type_name(e->type),
+        (unsigned long long)e->tile_I, (unsigned long long)e->tile_J, (unsigned long long)e->tile_K);
+  }
+
+  for (size_t i = 0; i < gemmini_tune_n_convs; i++) {
+    const struct gemmini_tune_conv_entry * e = &gemmini_tune_convs[i];
+    printf(GEMMINI_TUNE_CONV_FORMAT, e->batch_size, e->in_dim, e->in_channels,
+        e->out_channels, e->out_dim, e->stride, e->padding, e->kernel_dim,
+        e->pool_size, e->pool_stride, e->pool_padding,
+        e->args[0], e->args[1], e->args[2], e->args[3], e->args[4], e->args[5], e->args[6]);
+  }
+}
+
+#ifndef BAREMETAL
+// Adds the entries of the tuning database at path. Lines other than
+// GEMMINI_TUNE_MATMUL and GEMMINI_TUNE_CONV ones are skipped. Returns false if
+// the file can't be read or has more entries than fit.
+static bool gemmini_tune_load(const char * path) {
+  FILE * file = fopen(path, "r");
+  if (file == NULL)
+    return false;
+
+  bool ok = true;
+  char line[256];
+
+  while (ok && fgets(line, sizeof(line), file) != NULL) {
+    struct gemmini_tune_matmul_entry matmul;
+    struct gemmini_tune_conv_entry conv;
+    char type[8];
+
+    if (sscanf(line, "GEMMINI_TUNE_MATMUL(%zu, %zu, %zu, %7[A-Z_], %zu, %zu, %zu)",
+          &matmul.dim_I, &matmul.dim_J, &matmul.dim_K, type,
+          &matmul.tile_I, &matmul.tile_J, &matmul.tile_K) == 7) {
+      matmul.type = -1;
+      for (int t = OS; t <= WS_CPU; t++)
+        if (strcmp(type, gemmini_tune_type_name(t)) == 0)
+          matmul.type = t;
+
+      ok = matmul.type >= 0 && gemmini_tune_set_matmul(&matmul);
+    } else if (sscanf(line, "GEMMINI_TUNE_CONV(%d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d)",
+          &conv.batch_size, &conv.in_dim, &conv.in_channels, &conv.out_channels, &conv.out_dim,
+          &conv.stride, &conv.padding, &conv.kernel_dim,
+          &conv.pool_size, &conv.pool_stride, &conv.pool_padding,
+          &conv.args[0], &conv.args[1], &conv.args[2], &conv.args[3],
+          &conv.args[4], &conv.args[5], &conv.args[6]) == 18) {
+      ok = gemmini_tune_set_conv(&conv);
+    }
+  }
+
+  fclose(file);
+
+  if (!ok)
+    printf("Couldn't load the tuning database %s\n", path);
+
+  return ok;
+}
+
+// Writes the entries that were loaded or set at runtime to path
+static bool gemmini_tune_save(const char * path) {
+  FILE * file = fopen(path, "w");
+  if (file == NULL) {
+    perror("Couldn't create the tuning database");
+    return false;
+  }
+
+  fprintf(file, "// Gemmini tuning database for DIM=%d\n", DIM);
+
+  for (size_t i = 0; i < gemmini_tune_n_matmuls; i++) {
+    const struct gemmini_tune_matmul_entry * e = &gemmini_tune_matmuls[i];
+    fprintf(file, GEMMINI_TUNE_MATMUL_FORMAT, (unsigned long long)e->dim_I, (unsigned long long)e->dim_J, (unsigned long long)e->dim_K,
+        gemmini_tune_type_name(e->type),
+        (unsigned long long)e->tile_I, (unsigned long long)e->tile_J, (unsigned long long)e->tile_K);
+  }
+
+  for (size_t i = 0; i < gemmini_tune_n_convs; i++) {
+    const struct gemmini_tune_conv_entry * e = &gemmini_tune_convs[i];
+    fprintf(file, GEMMINI_TUNE_CONV_FORMAT, e->batch_size, e->in_dim, e->in_channels,
+        e->out_channels, e->out_dim, e->stride, e->padding, e->kernel_dim,
+        e->pool_size, e->pool_stride, e->pool_padding,
+        e->args[0], e->args[1], e->args[2], e->args[3], e->args[4], e->args[5], e->args[6]);
+  }
+
+  const bool ok = fclose(file) == 0;
+  if (!ok)
+    perror("Couldn't write the tuning database");
+
+  return ok;
+}
+#endif
+
+// This function runs a tiled matrix multiplication, with automatically
+// calculated tiling factors, or ones from the tuning database
+void tiled_matmul_auto(size_t dim_I, size_t dim_J, size_t dim_K,
+        const elem_t* A, const elem_t* B,
+        const acc_t * D, elem_t* C,
+        size_t stride_A, size_t stride_B, size_t stride_D, size_t stride_C,
+        scale_t A_scale_factor, scale_t B_scale_factor, scale_acc_t D_scale_factor,
+        int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift,
+        bool repeating_bias,
+        enum tiled_matmul_type_t tiled_matmul_type) {
+    size_t tile_I, tile_J, tile_K;
+    tiled_matmul_auto_tiles(dim_I, dim_J, dim_K, &tile_I, &tile_J, &tile_K);
+
+    const struct gemmini_tune_matmul_entry * tuned = tiled_matmul_type == CPU ? NULL :
+      gemmini_tune_find_matmul(dim_I, dim_J, dim_K, tiled_matmul_type);
+
+    if (tuned != NULL && tiled_matmul_tiles_fit(dim_I, dim_J, dim_K, tuned->tile_I, tuned->tile_J, tuned->tile_K)) {
+        tile_I = tuned->tile_I;
+        tile_J = tuned->tile_J;
+        tile_K = tuned->tile_K;
+    }
+
+    tiled_matmul(dim_I, dim_J, dim_K,
+        A, B, D, C, 
+        stride_A, stride_B, stride_D, stride_C,
+        A_scale_factor, B_scale_factor, D_scale_factor,
+        act, shift, relu6_shift,
+        per_channel_mult, per_channel_shift,
+        repeating_bias,
+        tile_I, tile_J, tile_K,
+        tiled_matmul_type);
+}
+
+// The same as tiled_matmul_auto, except that it returns without waiting for
+// Gemmini to finish. Only OS and WS matmuls are async.
+gemmini_token_t tiled_matmul_async(size_t dim_I, size_t dim_J, size_t dim_K,
+        const elem_t* A, const elem_t* B,
+        const acc_t * D, elem_t* C,
+        size_t stride_A, size_t stride_B, size_t stride_D, size_t stride_C,
+        scale_t A_scale_factor, scale_t B_scale_factor, scale_acc_t D_scale_factor,
+        int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift,
+        bool repeating_bias,
+        enum tiled_matmul_type_t tiled_matmul_type) {
+
+  const bool async = tiled_matmul_type == OS || tiled_matmul_type == WS;
+
+  gemmini_async = async;
+
+  tiled_matmul_auto(dim_I, dim_J, dim_K,
+      A, B, D, C,
+      stride_A, stride_B, stride_D, stride_C,
+      A_scale_factor, B_scale_factor, D_scale_factor,
+      act, shift, relu6_shift,
+      per_channel_mult, per_channel_shift,
+      repeating_bias,
+      tiled_matmul_type);
+
+  gemmini_async = false;
+
+  return async ? ++gemmini_token_issued : GEMMINI_TOKEN_DONE;
+}
+
+// Resident-panel matmuls
+//
+// When A is a short, wide panel, like the activations of an MLP with a small
+// batch, tiled_matmul_auto moves it in again for every tile of columns of B.
+// tiled_matmul_panel_ws moves all of A into the scratchpad once instead, and
+// streams B through the rest of the scratchpad, tile_J column blocks at a time.
+// B and the accumulator are double-buffered, so that moving in the next tile of
+// B and moving out the last tile of C overlap with the computation.
+
+// Whether an I x K panel fits, and if so, how many column blocks of B to move
+// in at a time
+static bool tiled_matmul_panel_fits(size_t dim_I, size_t dim_J, size_t dim_K, size_t * tile_J) {
+  const size_t I = dim_I / DIM + (dim_I % DIM != 0);
+  const size_t J = dim_J / DIM + (dim_J % DIM != 0);
+  const size_t K = dim_K / DIM + (dim_K % DIM != 0);
+
+  const size_t A_rows = I * K * DIM;
+  if (A_rows >= BANK_NUM * BANK_ROWS)
+    return false;
+
+  size_t tj = (BANK_NUM * BANK_ROWS - A_rows) / 2 / (K * DIM);
+  if (tj > ACC_ROWS / 2 / (I * DIM))
+    tj = ACC_ROWS / 2 / (I * DIM);
+  if (tj > J)
+    tj = J;
+
+  *tile_J = tj;
+  return tj > 0;
+}
+
+// Multiplies the panel of A that is already in the scratchpad with J column
+// blocks of B, into the half of the accumulator at C_sp_addr_start
+static void sp_tiled_matmul_panel_ws(const elem_t * B, const acc_t * D, elem_t * C,
+        size_t I, size_t J, size_t K, size_t pad_I, size_t pad_J, size_t pad_K,
+        size_t B_row_stride, size_t C_row_stride,
+        uint32_t B_sp_addr_start, uint32_t C_sp_addr_start,
+        bool repeating_bias) {
+
+  const uint32_t A_sp_addr_start = 0;
+  const uint32_t D_sp_addr_start = C_sp_addr_start & ~(1 << (ADDR_LEN-2));
+
+  const int B_blocks = J <= MAX_BLOCK_LEN ? J : MAX_BLOCK_LEN;
+  const int D_blocks = J <= MAX_BLOCK_LEN_ACC ? J : MAX_BLOCK_LEN_ACC;
+
+  // Move-in D
+  if (D != NULL) {
+    gemmini_extended_config_ld(repeating_bias ? 0 : C_row_stride * sizeof(acc_t), MVIN_SCALE_ONE);
+
+    for (size_t i = 0; i < I; i++) {
+      for (size_t j = 0; j < J; j += D_blocks) {
+        const acc_t * const D_dram_addr = D + ((repeating_bias ? 0 : i*C_row_stride) + j)*DIM;
+        const uint32_t D_sp_addr_acc = D_sp_addr_start + (i*J + j)*DIM;
+        const size_t blocks = j + D_blocks <= J ? D_blocks : J-j;
+        const size_t cols = blocks * DIM - (j + blocks >= J ? pad_J : 0);
+        const size_t rows = DIM - (i == I-1 ? pad_I : 0);
+        gemmini_extended_mvin(D_dram_addr, D_sp_addr_acc, cols, rows);
+      }
+    }
+  }
+
+  // Move-in B
+  gemmini_extended_config_ld(B_row_stride * sizeof(elem_t), MVIN_SCALE_ONE);
+  for (size_t j = 0; j < J; j += B_blocks) {
+    for (size_t k = 0; k < K; k++) {
+      const elem_t * const B_dram_addr = B + (k*B_row_stride + j)*DIM;
+      const uint32_t B_sp_addr = B_sp_addr_start + (k*J + j)*DIM;
+      const size_t blocks = j + B_blocks <= J ? B_blocks : J-j;
+      const size_t cols = blocks * DIM - (j + blocks >= J ? pad_J : 0);
+      const size_t rows = DIM - (k == K-1 ? pad_K : 0);
+      gemmini_extended_mvin(B_dram_addr, B_sp_addr, cols, rows);
+    }
+  }
+
+  // Compute
+  for (size_t j = 0; j < J; j++) {
+    for (size_t k = 0; k < K; k++) {
+      const uint32_t B_sp_addr = B_sp_addr_start + (k*J + j)*DIM;
+
+      for (size_t i = 0; i < I; i++) {
+        const uint32_t A_sp_addr = A_sp_addr_start + (i*K + k)*DIM;
+        const uint32_t C_sp_addr = C_sp_addr_start + (i*J + j)*DIM;
+
+        uint32_t pre_sp_addr = i == 0 ? B_sp_addr : GARBAGE_ADDR;
+        uint32_t out_sp_addr = C_sp_addr;
+
+        // Without a bias, the first product overwrites what's in the
+        // accumulator from the tile before
+        if (D == NULL && k == 0) {
+          out_sp_addr &= ~(1 << (ADDR_LEN-2));
+        }
+
+        const size_t A_cols = DIM - (k == K - 1 ? pad_K : 0);
+        const size_t A_rows = DIM - (i == I - 1 ? pad_I : 0);
+        const size_t B_cols = DIM - (j == J - 1 ? pad_J : 0);
+        const size_t B_rows = DIM - (k == K - 1 ? pad_K : 0);
+        const size_t C_cols = DIM - (j == J - 1 ? pad_J : 0);
+        const size_t C_rows = DIM - (i == I - 1 ? pad_I : 0);
+
+        gemmini_extended_preload(pre_sp_addr, out_sp_addr, B_cols, B_rows, C_cols, C_rows);
+
+        if (i == 0) { // First iteration
+          gemmini_extended_compute_preloaded(A_sp_addr, GARBAGE_ADDR, A_cols, A_rows, DIM, DIM);
+        } else { // All other iterations
+          gemmini_extended_compute_accumulated(A_sp_addr, GARBAGE_ADDR, A_cols, A_rows, DIM, DIM);
+        }
+      }
+    }
+  }
+
+  // Move-out C
+  for (size_t i = 0; i < I; i++) {
+    for (size_t j = 0; j < J; j++) {
+      elem_t * const C_dram_addr = C + (i*C_row_stride + j)*DIM;
+      const uint32_t C_sp_addr = C_sp_addr_start + (i*J + j)*DIM;
+
+      const size_t C_cols = DIM - (j == J - 1 ? pad_J : 0);
+      const size_t C_rows = DIM - (i == I - 1 ? pad_I : 0);
+
+      gemmini_extended_mvout(C_dram_addr, C_sp_addr, C_cols, C_rows);
+    }
+  }
+}
+
+// Runs a WS matmul with A resident in the scratchpad. A's rows are stride_A
+// apart, B's and C's dim_J, and D, if it isn't NULL, is either a row that is
+// repeated for every row of C, or a dim_I x dim_J matrix. The panel has to fit,
+// as tiled_matmul_panel_fits() tells.
+static void tiled_matmul_panel_ws(size_t dim_I, size_t dim_J, size_t dim_K,
+        const elem_t * A, const elem_t * B, const acc_t * D, elem_t * C,
+        size_t stride_A,
+        int act, size_t shift, size_t relu6_shift, bool repeating_bias) {
+
+  size_t tile_J;
+  if (!tiled_matmul_panel_fits(dim_I, dim_J, dim_K, &tile_J)) {
+    printf("The A panel doesn't fit in the scratchpad\n");
+    exit(1);
+  }
+
+  const size_t I = dim_I / DIM + (dim_I % DIM != 0);
+  const size_t J = dim_J / DIM + (dim_J % DIM != 0);
+  const size_t K = dim_K / DIM + (dim_K % DIM != 0);
+
+  const size_t pad_I = I * DIM - dim_I;
+  const size_t pad_J = J * DIM - dim_J;
+  const size_t pad_K = K * DIM - dim_K;
+
+  const uint32_t B_sp_addr_start = I * K * DIM;
+  const uint32_t C_sp_addr_start = 3 << (ADDR_LEN-2);
+
+  gemmini_config_ex(WEIGHT_STATIONARY, act, 0, shift, relu6_shift);
+  gemmini_config_st(dim_J * sizeof(elem_t));
+
+  // Move-in A, once
+  const int A_blocks = K <= MAX_BLOCK_LEN ? K : MAX_BLOCK_LEN;
+  gemmini_extended_config_ld(stride_A * sizeof(elem_t), MVIN_SCALE_ONE);
+  for (size_t k = 0; k < K; k += A_blocks) {
+    for (size_t i = 0; i < I; i++) {
+      const elem_t * const A_dram_addr = A + (i*stride_A*DIM + k*DIM);
+      const uint32_t A_sp_addr = (i*K + k)*DIM;
+      const size_t blocks = k + A_blocks <= K ? A_blocks : K-k;
+      const size_t cols = blocks * DIM - (k + blocks >= K ? pad_K : 0);
+      const size_t rows = DIM - (i == I-1 ? pad_I : 0);
+      gemmini_extended_mvin(A_dram_addr, A_sp_addr, cols, rows);
+    }
+  }
+
+  for (size_t j0 = 0, t = 0; j0 < J; j0 += tile_J, t++) {
+    const size_t tj = J - j0 < tile_J ? J - j0 : tile_J;
+    const acc_t * pre = D == NULL ? NULL : D + j0*DIM;
+
+    sp_tiled_matmul_panel_ws(B + j0*DIM, pre, C + j0*DIM,
+        I, tj, K, pad_I, j0 + tj == J ? pad_J : 0, pad_K,
+        dim_J, dim_J,
+        B_sp_addr_start + (t % 2) * K * tile_J * DIM,
+        C_sp_addr_start + (t % 2) * (ACC_ROWS / 2),
+        repeating_bias);
+  }
+
+  gemmini_end_op();
+}
+
+void sp_tiled_conv(
+        int batch_size, int in_dim, int in_channels,
+        int out_channels, int out_dim, int pool_out_dim,
+
+        int stride, int padding, int kernel_dim,
+
+        int pool_size, int pool_stride, int pool_padding,
+
+        int batches,
+        int porows, int pocols, int pochs,
+        int krows, int kcols, int kchs,
 
         int lpad, int rpad, int upad, int dpad,
         int plpad, int prpad, int pupad, int pdpad,
@@ -884,6 +2074,9 @@ void sp_tiled_conv(
         elem_t * output,
         acc_t * bias,
 
+        int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift,
+
         bool no_bias, bool no_pool) {
 
     const int orows = porows * pool_stride + pool_size - 1 - pupad - pdpad;
@@ -1045,8 +2238,10 @@ void sp_tiled_conv(
             }
 
     // mvout output
+    const bool per_channel = per_channel_mult != NULL || per_channel_shift != NULL;
+
     if (output != NULL) {
-        if (no_pool) {
+        if (no_pool && !per_channel) {
             for (int b = 0; b < batches; b++)
                 for (int orow = 0; orow < orows; orow++)
                     for (int ocol = 0; ocol < ocols; ocol += DIM) {
@@ -1062,14 +2257,42 @@ void sp_tiled_conv(
                                     J, I);
                         }
                     }
+        } else if (no_pool) {
+            // Every block of output channels gets its own accumulator shift,
+            // so we iterate over the channel blocks in the outer loop
+            for (int och = 0; och < ochs; och += DIM) {
+                const int J = ochs - och > DIM ? DIM : ochs - och;
+
+                const int acc_shift = gemmini_channel_block_acc_shift(
+                        per_channel_mult, per_channel_shift, och, J, shift);
+                gemmini_extended_config_ex(WEIGHT_STATIONARY, act, 0, acc_shift, relu6_shift, stride, false, false);
+
+                for (int b = 0; b < batches; b++)
+                    for (int orow = 0; orow < orows; orow++)
+                        for (int ocol = 0; ocol < ocols; ocol += DIM) {
+                            const int I = ocols - ocol > DIM ? DIM : ocols - ocol;
+
+                            const uint32_t C_sp_addr = C_sp_addr_start + (och / DIM) * batches * orows * ocols + b * orows * ocols + orow * ocols + ocol;
+
+                            gemmini_extended_mvout(output + (b*out_dim*out_dim + orow*out_dim + ocol) * out_channels + och,
+                                    C_sp_addr,
+                                    J, I);
+                        }
+            }
         } else {
             gemmini_extended_config_st(out_channels * sizeof(elem_t), pool_stride, pool_size, pool_out_dim, porows, pocols, orows, ocols, pupad, plpad);
 
             gemmini_fence(); // TODO remove this when the ROB can accurately handle these
-            for (int b = 0; b < batches; b++) {
-                for (int poch = 0; poch < pochs; poch += DIM) {
-                    const int channels = poch + DIM >= pochs ? pochs - poch : DIM;
+            for (int poch = 0; poch < pochs; poch += DIM) {
+                const int channels = poch + DIM >= pochs ? pochs - poch : DIM;
 
+                if (per_channel) {
+                    const int acc_shift = gemmini_channel_block_acc_shift(
+                            per_channel_mult, per_channel_shift, poch, channels, shift);
+                    gemmini_extended_config_ex(WEIGHT_STATIONARY, act, 0, acc_shift, relu6_shift, stride, false, false);
+                }
+
+                for (int b = 0; b < batches; b++) {
                     elem_t * pout = output + (b * pool_out_dim * pool_out_dim)*out_channels + poch;
 
                     const uint32_t C_sp_addr = C_sp_addr_start + (poch / DIM) * batches * orows * ocols + b * orows * ocols;
@@ -1081,6 +2304,10 @@ void sp_tiled_conv(
             }
             gemmini_fence();
         }
+
+        if (per_channel) {
+            gemmini_extended_config_ex(WEIGHT_STATIONARY, act, 0, shift, relu6_shift, stride, false, false);
+        }
     }
 }
 
@@ -1111,6 +2338,425 @@ static int tiled_conv_total_spad_rows(bool acc,
         return A_rows + B_rows;
 }
 
+// Whether tiled_conv can run a conv with these tiling factors, which are
+// {batches, porows, pocols, pochs, krows, kcols, kchs}
+static bool tiled_conv_args_fit(int batch_size, int pool_out_dim, int out_channels,
+        int kernel_dim, int in_channels,
+        int stride, int pool_size, int pool_stride,
+        const int args[7]) {
+    const int max_args[] = {batch_size, pool_out_dim, pool_out_dim, out_channels, kernel_dim, kernel_dim, in_channels};
+
+    for (int i = 0; i < 7; i++)
+        if (args[i] <= 0 || args[i] > max_args[i])
+            return false;
+
+    return tiled_conv_total_spad_rows(false,
+            stride, args[0], args[1], args[2], args[3], args[4], args[5], args[6], pool_size, pool_stride) <= BANK_NUM*BANK_ROWS &&
+        tiled_conv_total_spad_rows(true,
+            stride, args[0], args[1], args[2], args[3], args[4], args[5], args[6], pool_size, pool_stride) <= ACC_ROWS;
+}
+
+// The tiling factors that tiled_conv_auto picks when the tuning database has
+// none for a conv. Starting from the whole conv, the largest factor is
+// decremented until the tiles fit.
+static void tiled_conv_auto_args(int batch_size, int pool_out_dim, int out_channels,
+        int kernel_dim, int in_channels,
+        int stride, int pool_size, int pool_stride,
+        int args[7]) {
+    // args = {batches, porows, pocols, pochs, krows, kcols, kchs}
+    args[0] = batch_size;
+    args[1] = pool_out_dim;
+    args[2] = pool_out_dim;
+    args[3] = out_channels;
+    args[4] = kernel_dim;
+    args[5] = kernel_dim;
+    args[6] = in_channels;
+
+    int spad_rows = tiled_conv_total_spad_rows(false,
+        stride, args[0], args[1], args[2], args[3], args[4], args[5], args[6], pool_size, pool_stride);
+    int acc_rows = tiled_conv_total_spad_rows(true,
+        stride, args[0], args[1], args[2], args[3], args[4], args[5], args[6], pool_size, pool_stride);
+
+    while (spad_rows > BANK_NUM*BANK_ROWS || acc_rows > ACC_ROWS) {
+        int max_val = -1;
+        int max_idx = -1;
+
+        for (int i = 0; i < 7; i++) {
+            if (args[i] > max_val) {
+                max_val = args[i];
+                max_idx = i;
+            }
+        }
+
+        args[max_idx]--;
+
+        spad_rows = tiled_conv_total_spad_rows(false,
+            stride, args[0], args[1], args[2], args[3], args[4], args[5], args[6], pool_size, pool_stride);
+        acc_rows = tiled_conv_total_spad_rows(true,
+            stride, args[0], args[1], args[2], args[3], args[4], args[5], args[6], pool_size, pool_stride);
+    }
+}
+
+struct conv_cpu_args {
+  int batch_size, in_dim, in_channels;
+  int out_channels, out_dim;
+  int stride, padding, kernel_dim;
+
+  elem_t * input;
+  elem_t * weights;
+  acc_t * bias;
+  elem_t * output;
+
+  int act;
+  size_t shift, relu6_shift;
+  const acc_t * per_channel_mult;
+  const uint8_t * per_channel_shift;
+
+  int pool_size, pool_stride, pool_padding;
+  int pool_out_dim;
+  int pool_rows_per_task;
+
+  // The group of output channels whose weights are currently packed
+  const elem_t * packed_weights;
+  int och_group0, och_group_size;
+};
+
+// CPU direct convolution
+//
+// The weights are repacked so that CONV_CPU_OB output channels sit next to
+// each other for every (krow, kcol, kch), with zeros past the last channel:
+//   packed[och / OB][krow][kcol][kch][och % OB]
+// The kernel then computes CONV_CPU_OW neighbouring output pixels for a
+// whole block of output channels at once. Every input pixel it loads is
+// reused for OB channels, and every block of weights for OW pixels. Padding
+// is skipped instead of being multiplied by zero, which doesn't change the
+// integer sums.
+//
+// The weights of at most CONV_CPU_WEIGHT_PACK_ELEMS elements are packed at a
+// time, so large layers are computed in groups of output channels. Kernels
+// too large for even one block of output channels to be packed are computed
+// one output at a time, straight from the unpacked weights.
+#define CONV_CPU_OB 16
+#define CONV_CPU_OW 4
+#define CONV_CPU_WEIGHT_PACK_ELEMS (1024 * 1024)
+
+static elem_t conv_cpu_packed_weights[CONV_CPU_WEIGHT_PACK_ELEMS];
+
+// Returns how many output channels can have their weights packed at once
+static int conv_cpu_och_group_size(int out_channels, int kernel_dim, int in_channels) {
+  const int block_elems = kernel_dim * kernel_dim * in_channels * CONV_CPU_OB;
+  const int group = CONV_CPU_WEIGHT_PACK_ELEMS / block_elems * CONV_CPU_OB;
+  return group < out_channels ? group : out_channels;
+}
+
+// Packs output-channel blocks [start, end) of the current group
+static void conv_cpu_pack_weights_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  const struct conv_cpu_args * args = (const struct conv_cpu_args *)args_;
+
+  const int out_channels = args->out_channels;
+  const int patch = args->kernel_dim * args->kernel_dim * args->in_channels;
+  elem_t * packed = (elem_t *)args->packed_weights;
+
+  for (size_t blk = start; blk < end; blk++) {
+    const int och0 = args->och_group0 + blk * CONV_CPU_OB;
+    elem_t * dst = packed + blk * patch * CONV_CPU_OB;
+
+    for (int k = 0; k < patch; k++) {
+      const elem_t * src = args->weights + k * out_channels;
+
+      for (int o = 0; o < CONV_CPU_OB; o++)
+        dst[k * CONV_CPU_OB + o] = och0 + o < out_channels ? src[och0 + o] : 0;
+    }
+  }
+}
+
+// Computes output channels [och0, och0+ochs) of one row of conv outputs, and
+// writes pixel ocol of that row to out[ocol * out_stride]. The channels must
+// belong to the group whose weights are currently packed.
+static void conv_cpu_row(const struct conv_cpu_args * args, int b, int orow,
+        int och0, int ochs, elem_t * out, size_t out_stride) {
+
+  const int in_dim = args->in_dim, in_channels = args->in_channels;
+  const int out_channels = args->out_channels, out_dim = args->out_dim;
+  const int stride = args->stride, padding = args->padding, kernel_dim = args->kernel_dim;
+  const int patch = kernel_dim * kernel_dim * in_channels;
+  const elem_t * input = args->input + (size_t)b * in_dim * in_dim * in_channels;
+  const acc_t * bias = args->bias;
+
+  bool no_bias = bias == NULL;
+
+  for (int och = och0; och < och0 + ochs; ) {
+    const int blk = (och - args->och_group0) / CONV_CPU_OB;
+    const int blk_och0 = args->och_group0 + blk * CONV_CPU_OB;
+    const int lane0 = och - blk_och0;
+    const int lanes = och0 + ochs - och < CONV_CPU_OB - lane0 ? och0 + ochs - och : CONV_CPU_OB - lane0;
+
+    const elem_t * blk_weights = args->packed_weights + (size_t)blk * patch * CONV_CPU_OB;
+
+    for (int ocol0 = 0; ocol0 < out_dim; ocol0 += CONV_CPU_OW) {
+      const int ocols = out_dim - ocol0 < CONV_CPU_OW ? out_dim - ocol0 : CONV_CPU_OW;
+
+      acc_t opixels[CONV_CPU_OW][CONV_CPU_OB];
+      for (int o = 0; o < CONV_CPU_OB; o++) {
+        const acc_t init = no_bias || blk_och0 + o >= out_channels ? 0 : bias[blk_och0 + o];
+        for (int ow = 0; ow < CONV_CPU_OW; ow++)
+          opixels[ow][o] = init;
+      }
+
+      for (int krow = 0; krow < kernel_dim; krow++) {
+        const int irow = orow * stride + krow - padding;
+        if (irow < 0 || irow >= in_dim)
+          continue;
+
+        for (int kcol = 0; kcol < kernel_dim; kcol++) {
+          const elem_t * weights = blk_weights + (krow * kernel_dim + kcol) * in_channels * CONV_CPU_OB;
+
+          for (int ow = 0; ow < ocols; ow++) {
+            const int icol = (ocol0 + ow) * stride + kcol - padding;
+            if (icol < 0 || icol >= in_dim)
+              continue;
+
+            const elem_t * ipixels = input + (irow * in_dim + icol) * in_channels;
+
+            for (int kch = 0; kch < in_channels; kch++) {
+              const elem_t ipixel = ipixels[kch];
+              const elem_t * weight = weights + kch * CONV_CPU_OB;
+
+              for (int o = 0; o < CONV_CPU_OB; o++)
+                opixels[ow][o] += weight[o] * ipixel;
+            }
+          }
+        }
+      }
+
+      for (int ow = 0; ow < ocols; ow++) {
+        for (int o = lane0; o < lane0 + lanes; o++) {
+          out[(ocol0 + ow) * out_stride + blk_och0 + o - och0] =
+            scale_and_sat_per_channel(opixels[ow][o], blk_och0 + o, args->act, args->shift, args->relu6_shift,
+                args->per_channel_mult, args->per_channel_shift);
+        }
+      }
+    }
+
+    och += lanes;
+  }
+}
+
+// Packs the weights of output channels [och_group0, och_group0 + och_group_size)
+static void conv_cpu_pack_weights(struct conv_cpu_args * args, int och_group0, int och_group_size) {
+  args->packed_weights = conv_cpu_packed_weights;
+  args->och_group0 = och_group0;
+  args->och_group_size = och_group_size;
+
+  gemmini_parallel_for((och_group_size + CONV_CPU_OB - 1) / CONV_CPU_OB, 1,
+      conv_cpu_pack_weights_task, args);
+}
+
+// Computes output rows [start, end), counted across the whole batch
+static void conv_cpu_without_pool_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  const struct conv_cpu_args * args = (const struct conv_cpu_args *)args_;
+  const int out_dim = args->out_dim, out_channels = args->out_channels;
+
+  for (size_t row = start; row < end; row++) {
+    const int b = row / out_dim;
+    const int orow = row % out_dim;
+
+    conv_cpu_row(args, b, orow, args->och_group0, args->och_group_size,
+        args->output + (b * out_dim + orow) * out_dim * out_channels + args->och_group0, out_channels);
+  }
+}
+
+// Computes conv output (b, orow, ocol, och) from the unpacked weights
+static elem_t conv_cpu_opixel(const struct conv_cpu_args * args, int b, int orow, int ocol, int och) {
+  const int in_dim = args->in_dim, in_channels = args->in_channels, out_channels = args->out_channels;
+  const int kernel_dim = args->kernel_dim;
+  const elem_t * input = args->input + (size_t)b * in_dim * in_dim * in_channels;
+
+  acc_t opixel = args->bias == NULL ? 0 : args->bias[och];
+
+  for (int krow = 0; krow < kernel_dim; krow++) {
+    const int irow = orow * args->stride + krow - args->padding;
+    if (irow < 0 || irow >= in_dim)
+      continue;
+
+    for (int kcol = 0; kcol < kernel_dim; kcol++) {
+      const int icol = ocol * args->stride + kcol - args->padding;
+      if (icol < 0 || icol >= in_dim)
+        continue;
+
+      const elem_t * ipixels = input + ((size_t)irow * in_dim + icol) * in_channels;
+      const elem_t * weights = args->weights + (size_t)(krow * kernel_dim + kcol) * in_channels * out_channels + och;
+
+      for (int kch = 0; kch < in_channels; kch++)
+        opixel += weights[(size_t)kch * out_channels] * ipixels[kch];
+    }
+  }
+
+  return scale_and_sat_per_channel(opixel, och, args->act, args->shift, args->relu6_shift,
+      args->per_channel_mult, args->per_channel_shift);
+}
+
+// Computes output rows [start, end), counted across the whole batch, without
+// packing the weights
+static void conv_cpu_unpacked_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  const struct conv_cpu_args * args = (const struct conv_cpu_args *)args_;
+  const int out_dim = args->out_dim, out_channels = args->out_channels;
+
+  for (size_t row = start; row < end; row++) {
+    const int b = row / out_dim;
+    const int orow = row % out_dim;
+    elem_t * out_row = args->output + ((size_t)b * out_dim + orow) * out_dim * out_channels;
+
+    for (int ocol = 0; ocol < out_dim; ocol++)
+      for (int och = 0; och < out_channels; och++)
+        out_row[ocol * out_channels + och] = conv_cpu_opixel(args, b, orow, ocol, och);
+  }
+}
+
+// When pooling, every conv output is only computed once. Each thread keeps a
+// band of the last pool_size conv rows, and max-pools over that band as it
+// moves down the image. If the band for all output channels does not fit in
+// CONV_CPU_POOL_BAND_ELEMS, the channels are processed in slices. Layers
+// whose band doesn't fit even one channel, or whose weights can't be packed,
+// are pooled one output at a time instead, recomputing the conv outputs that
+// neighbouring windows share.
+#define CONV_CPU_POOL_BAND_ELEMS (32 * 1024)
+
+static elem_t conv_cpu_pool_band[GEMMINI_MAX_THREADS][CONV_CPU_POOL_BAND_ELEMS];
+
+// Returns the maximum of the conv outputs in one pool window. Padding counts
+// as a zero, just like it does for the accelerator's pooling.
+static elem_t conv_cpu_pool_window_max(const struct conv_cpu_args * args,
+        const elem_t * band, size_t ochs, int porow, int pocol, int och) {
+
+  const int out_dim = args->out_dim, pool_size = args->pool_size;
+  const int orow0 = porow * args->pool_stride - args->pool_padding;
+  const int ocol0 = pocol * args->pool_stride - args->pool_padding;
+
+  bool padded = false;
+  elem_t running_max = elem_t_min;
+
+  for (int orow = orow0; orow < orow0 + pool_size; orow++) {
+    if (orow < 0 || orow >= out_dim) {
+      padded = true;
+      continue;
+    }
+
+    const elem_t * band_row = band + (size_t)(orow % pool_size) * out_dim * ochs;
+
+    for (int ocol = ocol0; ocol < ocol0 + pool_size; ocol++) {
+      if (ocol < 0 || ocol >= out_dim) {
+        padded = true;
+      } else if (band_row[ocol * ochs + och] > running_max) {
+        running_max = band_row[ocol * ochs + och];
+      }
+    }
+  }
+
+  if (padded && running_max < 0)
+    running_max = 0;
+
+  return running_max;
+}
+
+// Computes pooled output rows [start, end), counted across the whole batch,
+// without packing the weights or keeping a band
+static void conv_cpu_unpacked_with_pool_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  const struct conv_cpu_args * args = (const struct conv_cpu_args *)args_;
+
+  const int out_channels = args->out_channels, out_dim = args->out_dim;
+  const int pool_size = args->pool_size, pool_out_dim = args->pool_out_dim;
+
+  for (size_t row = start; row < end; row++) {
+    const int b = row / pool_out_dim;
+    const int porow = row % pool_out_dim;
+    const int orow0 = porow * args->pool_stride - args->pool_padding;
+    elem_t * out_row = args->output + ((size_t)b * pool_out_dim + porow) * pool_out_dim * out_channels;
+
+    for (int pocol = 0; pocol < pool_out_dim; pocol++) {
+      const int ocol0 = pocol * args->pool_stride - args->pool_padding;
+
+      for (int och = 0; och < out_channels; och++) {
+        bool padded = false;
+        elem_t running_max = elem_t_min;
+
+        for (int orow = orow0; orow < orow0 + pool_size; orow++) {
+          for (int ocol = ocol0; ocol < ocol0 + pool_size; ocol++) {
+            if (orow < 0 || orow >= out_dim || ocol < 0 || ocol >= out_dim) {
+              padded = true;
+            } else {
+              const elem_t opixel = conv_cpu_opixel(args, b, orow, ocol, och);
+              if (opixel > running_max)
+                running_max = opixel;
+            }
+          }
+        }
+
+        out_row[pocol * out_channels + och] = padded && running_max < 0 ? 0 : running_max;
+      }
+    }
+  }
+}
+
+// Computes pooled output rows [start, end), where every index covers
+// pool_rows_per_task consecutive pooled rows of one image
+static void conv_cpu_with_pool_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  const struct conv_cpu_args * args = (const struct conv_cpu_args *)args_;
+
+  const int out_channels = args->out_channels, out_dim = args->out_dim;
+  const int pool_size = args->pool_size, pool_stride = args->pool_stride, pool_padding = args->pool_padding;
+  const int pool_out_dim = args->pool_out_dim;
+  const int tasks_per_image = (pool_out_dim + args->pool_rows_per_task - 1) / args->pool_rows_per_task;
+
+  elem_t * band = conv_cpu_pool_band[thread_id];
+
+  const int och_group_end = args->och_group0 + args->och_group_size;
+
+  // Slices are kept to whole blocks of packed weights where possible
+  int ochs = CONV_CPU_POOL_BAND_ELEMS / (pool_size * out_dim);
+  if (ochs >= CONV_CPU_OB)
+    ochs = ochs / CONV_CPU_OB * CONV_CPU_OB;
+  if (ochs > args->och_group_size)
+    ochs = args->och_group_size;
+
+  for (size_t task = start; task < end; task++) {
+    const int b = task / tasks_per_image;
+    const int porow_start = (task % tasks_per_image) * args->pool_rows_per_task;
+    const int porow_end = porow_start + args->pool_rows_per_task < pool_out_dim ?
+      porow_start + args->pool_rows_per_task : pool_out_dim;
+
+    for (int och0 = args->och_group0; och0 < och_group_end; och0 += ochs) {
+      const int slice = och_group_end - och0 < ochs ? och_group_end - och0 : ochs;
+
+      // The next conv row which hasn't been computed into the band yet
+      int next_orow = INT_MIN;
+
+      for (int porow = porow_start; porow < porow_end; porow++) {
+        const int orow0 = porow * pool_stride - pool_padding;
+        const int orow_end = orow0 + pool_size < out_dim ? orow0 + pool_size : out_dim;
+
+        for (int orow = orow0 > next_orow ? orow0 : next_orow; orow < orow_end; orow++) {
+          if (orow >= 0) {
+            conv_cpu_row(args, b, orow, och0, slice,
+                band + (size_t)(orow % pool_size) * out_dim * slice, slice);
+          }
+        }
+        if (orow_end > next_orow)
+          next_orow = orow_end;
+
+        elem_t * out_row = args->output + ((size_t)b * pool_out_dim + porow) * pool_out_dim * out_channels;
+
+        for (int pocol = 0; pocol < pool_out_dim; pocol++) {
+          for (int och = 0; och < slice; och++) {
+            out_row[pocol * out_channels + och0 + och] =
+              conv_cpu_pool_window_max(args, band, slice, porow, pocol, och);
+          }
+        }
+      }
+    }
+  }
+}
+
 void conv_cpu_without_pool(
         int batch_size, int in_dim, int in_channels,
         int out_channels, int out_dim,
@@ -1121,41 +2767,30 @@ void conv_cpu_without_pool(
         acc_t * bias,
         elem_t * output,
 
-        int act, size_t shift, size_t relu6_shift) {
-
-  bool no_bias = bias == NULL;
-
-  for (int b = 0; b < batch_size; b++) {
-    for (int orow = 0; orow < out_dim; orow++) {
-      for (int ocol = 0; ocol < out_dim; ocol++) {
-        for (int och = 0; och < out_channels; och++) {
-
-          acc_t opixel = no_bias ? 0 : bias[och];
-
-          for (int krow = 0; krow < kernel_dim; krow++) {
-            const int irow = orow * stride + krow - padding;
+        int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift) {
 
-            for (int kcol = 0; kcol < kernel_dim; kcol++) {
-              const int icol = ocol * stride + kcol - padding;
+  struct conv_cpu_args args = {
+    .batch_size = batch_size, .in_dim = in_dim, .in_channels = in_channels,
+    .out_channels = out_channels, .out_dim = out_dim,
+    .stride = stride, .padding = padding, .kernel_dim = kernel_dim,
+    .input = input, .weights = weights, .bias = bias, .output = output,
+    .act = act, .shift = shift, .relu6_shift = relu6_shift,
+    .per_channel_mult = per_channel_mult, .per_channel_shift = per_channel_shift,
+  };
 
-              for (int kch = 0; kch < in_channels; kch++) {
-                elem_t ipixel = irow < 0 || irow >= in_dim || icol < 0 || icol >= in_dim ?
-                    0 :
-                    *(input + (b * in_dim * in_dim + irow * in_dim + icol) * in_channels + kch);
+  const int och_group_size = conv_cpu_och_group_size(out_channels, kernel_dim, in_channels);
 
-                elem_t weight = *(weights + (krow * kernel_dim * in_channels + kcol * in_channels + kch) * out_channels + och);
+  if (och_group_size <= 0) {
+    gemmini_parallel_for(batch_size * out_dim, 1, conv_cpu_unpacked_task, &args);
+    return;
+  }
 
-                acc_t past_opixel = opixel;
-                opixel += weight * ipixel;
-              }
-            }
-          }
+  for (int och0 = 0; och0 < out_channels; och0 += och_group_size) {
+    conv_cpu_pack_weights(&args, och0,
+        out_channels - och0 < och_group_size ? out_channels - och0 : och_group_size);
 
-          *(output+(b*out_dim*out_dim+orow*out_dim+ocol)*out_channels + och) =
-            scale_and_sat(opixel, act, shift, relu6_shift);
-        }
-      }
-    }
+    gemmini_parallel_for(batch_size * out_dim, 1, conv_cpu_without_pool_task, &args);
   }
 }
 
@@ -1170,6 +2805,7 @@ void conv_cpu(
         elem_t * output,
 
         int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift,
         int pool_size, int pool_stride, int pool_padding) {
 
   const bool no_pool = pool_stride == 0;
@@ -1179,69 +2815,49 @@ void conv_cpu(
         out_channels, out_dim,
         stride, padding, kernel_dim,
         input, weights, bias, output,
-        act, shift, relu6_shift);
+        act, shift, relu6_shift,
+        per_channel_mult, per_channel_shift);
     return;
   }
 
-  const bool no_bias = bias == NULL;
   const int pool_out_dim = (out_dim + 2*pool_padding - pool_size) / pool_stride + 1;
 
-  for (int b = 0; b < batch_size; b++) {
-    for (int porow = 0; porow < pool_out_dim; porow++) {
-      for (int pocol = 0; pocol < pool_out_dim; pocol++) {
-        for (int poch = 0; poch < out_channels; poch++) {
-
-          elem_t running_max = 0;
-          bool running_max_initialized = false;
-
-          for (int pwrow = 0; pwrow < pool_size; pwrow++) {
-            const int orow = porow * pool_stride + pwrow - pool_padding;
-
-            for (int pwcol = 0; pwcol < pool_size; pwcol++) {
-              const int ocol = pocol * pool_stride + pwcol - pool_padding;
-
-              if (orow < 0 || orow >= out_dim || ocol < 0 || ocol >= out_dim) {
-                if (!running_max_initialized || running_max < 0) {
-                  running_max = 0;
-                  running_max_initialized = true;
-                }
-              } else {
-
-                acc_t opixel = no_bias ? 0 : bias[poch];
-
-                for (int krow = 0; krow < kernel_dim; krow++) {
-                  const int irow = orow * stride + krow - padding;
-
-                  for (int kcol = 0; kcol < kernel_dim; kcol++) {
-                    const int icol = ocol * stride + kcol - padding;
-
-                    for (int kch = 0; kch < in_channels; kch++) {
-                      elem_t ipixel = irow < 0 || irow >= in_dim || icol < 0 || icol >= in_dim ?
-                          0 :
-                          *(input + (b * in_dim * in_dim + irow * in_dim + icol) * in_channels + kch);
-
-                      elem_t weight = *(weights + (krow * kernel_dim * in_channels + kcol * in_channels + kch) * out_channels + poch);
+  // Neighbouring groups of pooled rows share pool_size - pool_stride conv
+  // rows, which get computed by both groups. So we only split the pooled rows
+  // of an image when there are more threads than that split would cost.
+  const int threads = gemmini_num_threads();
+  int pool_rows_per_task = pool_out_dim;
+  if (threads > 1) {
+    pool_rows_per_task = (batch_size * pool_out_dim + 2*threads - 1) / (2*threads);
+    if (pool_rows_per_task > pool_out_dim)
+      pool_rows_per_task = pool_out_dim;
+  }
 
-                      opixel += weight * ipixel;
-                    }
-                  }
-                }
+  struct conv_cpu_args args = {
+    .batch_size = batch_size, .in_dim = in_dim, .in_channels = in_channels,
+    .out_channels = out_channels, .out_dim = out_dim,
+    .stride = stride, .padding = padding, .kernel_dim = kernel_dim,
+    .input = input, .weights = weights, .bias = bias, .output = output,
+    .act = act, .shift = shift, .relu6_shift = relu6_shift,
+    .per_channel_mult = per_channel_mult, .per_channel_shift = per_channel_shift,
+    .pool_size = pool_size, .pool_stride = pool_stride, .pool_padding = pool_padding,
+    .pool_out_dim = pool_out_dim,
+    .pool_rows_per_task = pool_rows_per_task,
+  };
+
+  const int tasks_per_image = (pool_out_dim + pool_rows_per_task - 1) / pool_rows_per_task;
+  const int och_group_size = conv_cpu_och_group_size(out_channels, kernel_dim, in_channels);
+
+  if (och_group_size <= 0 || pool_size * out_dim > CONV_CPU_POOL_BAND_ELEMS) {
+    gemmini_parallel_for(batch_size * pool_out_dim, 1, conv_cpu_unpacked_with_pool_task, &args);
+    return;
+  }
 
-                opixel = scale_and_sat(opixel, act, shift, relu6_shift);
-                if (!running_max_initialized || opixel > running_max) {
-                  running_max = opixel;
-                  running_max_initialized = true;
-                }
-              }
+  for (int och0 = 0; och0 < out_channels; och0 += och_group_size) {
+    conv_cpu_pack_weights(&args, och0,
+        out_channels - och0 < och_group_size ? out_channels - och0 : och_group_size);
 
-              if (pwrow == pool_size - 1 && pwcol == pool_size - 1) {
-                *(output + (b*pool_out_dim*pool_out_dim + porow*pool_out_dim + pocol)*out_channels + poch) = running_max;
-              }
-            }
-          }
-        }
-      }
-    }
+    gemmini_parallel_for(batch_size * tasks_per_image, 1, conv_cpu_with_pool_task, &args);
   }
 }
 
@@ -1260,6 +2876,7 @@ void tiled_conv(
         elem_t * output,
 
         int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift,
         int pool_size, int pool_stride, int pool_padding,
 
         enum tiled_matmul_type_t tiled_conv_type) {
@@ -1275,6 +2892,7 @@ void tiled_conv(
         stride, padding, kernel_dim,
         input, weights, bias, output,
         act, shift, relu6_shift,
+        per_channel_mult, per_channel_shift,
         pool_size, pool_stride, pool_padding);
       return;
     } else if (tiled_conv_type == OS) {
@@ -1320,6 +2938,21 @@ void tiled_conv(
             printf("kernel_dim must be larger than padding\n");
             exit(1);
         }
+        if (per_channel_mult != NULL || per_channel_shift != NULL) {
+            for (int och = 0; och < out_channels; och += DIM) {
+                const int J = out_channels - och > DIM ? DIM : out_channels - och;
+
+                if (gemmini_channel_block_acc_shift(per_channel_mult, per_channel_shift, och, J, shift) < 0) {
+                    printf("Per-channel scales of output channels %d to %d can't be applied on Gemmini\n", och, och + J - 1);
+                    exit(1);
+                }
+            }
+        }
+        if (pochs % DIM != 0 && DIM % pochs != 0 && pochs < out_channels &&
+                (per_channel_mult != NULL || per_channel_shift != NULL)) {
+            printf("pochs must be a multiple or a divisor of DIM when using per-channel scales\n");
+            exit(1);
+        }
     }
 #endif
 
@@ -1362,6 +2995,9 @@ void tiled_conv(
                                     bias_ = NULL;
                                 }
 
+                                const acc_t * mult_ = per_channel_mult == NULL ? NULL : per_channel_mult + poch;
+                                const uint8_t * mult_shift_ = per_channel_shift == NULL ? NULL : per_channel_shift + poch;
+
                                 const int batches_ = batch_size - b > batches ? batches : batch_size - b;
                                 const int porows_ = pool_out_dim - porow > porows ? porows : pool_out_dim - porow;
                                 const int pocols_ = pool_out_dim - pocol > pocols ? pocols : pool_out_dim - pocol;
@@ -1415,6 +3051,9 @@ void tiled_conv(
                                     out,
                                     bias_,
 
+                                    act, shift, relu6_shift,
+                                    mult_, mult_shift_,
+
                                     no_bias, no_pool);
                             }
                         }
@@ -1423,6 +3062,8 @@ void tiled_conv(
             }
         }
     }
+
+    gemmini_end_op();
 }
 
 void tiled_conv_auto(
@@ -1436,6 +3077,7 @@ void tiled_conv_auto(
         elem_t * output,
 
         int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift,
         int pool_size, int pool_stride, int pool_padding,
 
         enum tiled_matmul_type_t tiled_conv_type) {
@@ -1449,31 +3091,34 @@ void tiled_conv_auto(
 
     const int pool_out_dim = (out_dim + 2*pool_padding - pool_size) / pool_stride + 1;
 
-    // int args[] = {batch_size, porows, pocols, pochs, krows, kcols, kchs};
-    int args[] = {batch_size, pool_out_dim, pool_out_dim, out_channels, kernel_dim, kernel_dim, in_channels};
-
-    int spad_rows = tiled_conv_total_spad_rows(false,
-        stride, args[0], args[1], args[2], args[3], args[4], args[5], args[6], pool_size, pool_stride);
-    int acc_rows = tiled_conv_total_spad_rows(true,
-        stride, args[0], args[1], args[2], args[3], args[4], args[5], args[6], pool_size, pool_stride);
+    const struct gemmini_tune_conv_entry key = {
+        .batch_size = batch_size, .in_dim = in_dim, .in_channels = in_channels,
+        .out_channels = out_channels, .out_dim = out_dim,
+        .stride = stride, .padding = padding, .kernel_dim = kernel_dim,
+        .pool_size = pool_size, .pool_stride = pool_stride, .pool_padding = pool_padding,
+    };
+    const struct gemmini_tune_conv_entry * tuned = tiled_conv_type == CPU ? NULL : gemmini_tune_find_conv(&key);
 
-    while (spad_rows > BANK_NUM*BANK_ROWS || acc_rows > ACC_ROWS) {
-        int max_val = -1;
-        int max_idx = -1;
+    // int args[] = {batch_size, porows, pocols, pochs, krows, kcols, kchs};
+    int args[7];
+    if (tuned != NULL && tiled_conv_args_fit(batch_size, pool_out_dim, out_channels, kernel_dim, in_channels,
+                stride, pool_size, pool_stride, tuned->args)) {
+        memcpy(args, tuned->args, sizeof(args));
+    } else {
+        tiled_conv_auto_args(batch_size, pool_out_dim, out_channels, kernel_dim, in_channels,
+            stride, pool_size, pool_stride, args);
+    }
 
-        for (int i = 0; i < sizeof(args)/sizeof(args[0]); i++) {
-            if (args[i] > max_val) {
-                max_val = args[i];
-                max_idx = i;
-            }
+    // Per-channel scales are applied to whole DIM-wide blocks of output
+    // channels, so channel tiles must not straddle those blocks
+    if ((per_channel_mult != NULL || per_channel_shift != NULL) &&
+            args[3] < out_channels) {
+        if (args[3] > DIM) {
+            args[3] = (args[3] / DIM) * DIM;
+        } else {
+            while (DIM % args[3] != 0)
+                args[3]--;
         }
-
-        args[max_idx]--;
-
-        spad_rows = tiled_conv_total_spad_rows(false,
-            stride, args[0], args[1], args[2], args[3], args[4], args[5], args[6], pool_size, pool_stride);
-        acc_rows = tiled_conv_total_spad_rows(true,
-            stride, args[0], args[1], args[2], args[3], args[4], args[5], args[6], pool_size, pool_stride);
     }
 
     const int batches = args[0];
@@ -1499,11 +3144,748 @@ void tiled_conv_auto(
         output,
 
         act, shift, relu6_shift,
+        per_channel_mult, per_channel_shift,
         pool_size, no_pool ? 0 : pool_stride, pool_padding,
         
         tiled_conv_type);
 }
 
+// The same as tiled_conv_auto, except that it returns without waiting for
+// Gemmini to finish. Convs on the CPU are done when this returns.
+gemmini_token_t tiled_conv_async(
+        int batch_size, int in_dim, int in_channels,
+        int out_channels, int out_dim,
+        int stride, int padding, int kernel_dim,
+
+        elem_t * input,
+        elem_t * weights,
+        acc_t * bias,
+        elem_t * output,
+
+        int act, size_t shift, size_t relu6_shift,
+        const acc_t * per_channel_mult, const uint8_t * per_channel_shift,
+        int pool_size, int pool_stride, int pool_padding,
+
+        enum tiled_matmul_type_t tiled_conv_type) {
+
+    const bool async = tiled_conv_type != CPU;
+
+    gemmini_async = async;
+
+    tiled_conv_auto(
+        batch_size, in_dim, in_channels,
+        out_channels, out_dim,
+        stride, padding, kernel_dim,
+
+        input, weights, bias, output,
+
+        act, shift, relu6_shift,
+        per_channel_mult, per_channel_shift,
+        pool_size, pool_stride, pool_padding,
+
+        tiled_conv_type);
+
+    gemmini_async = false;
+
+    return async ? ++gemmini_token_issued : GEMMINI_TOKEN_DONE;
+}
+
+// Winograd convolution
+//
+// tiled_conv_winograd_auto computes 3x3 convolutions with a stride of 1 using
+// Winograd's F(2x2, 3x3) algorithm. Each 2x2 block of outputs (a "tile") is
+// computed from a 4x4 patch of inputs d, which gets transformed to
+// V = B^T d B. The 3x3 weights g of every (in channel, out channel) pair get
+// transformed to U = G g G^T. For each of the 16 positions x of a transformed
+// tile, M[x] = V[x] U[x] is a (tiles x in_channels) by (in_channels x
+// out_channels) matmul, and the outputs of a tile are Y = A^T M A. That takes
+// 16 multiplies for every tile, in channel and out channel, where a direct
+// conv takes 9 for each of the 4 outputs, so 36.
+//
+//   B^T = [1  0 -1  0]   G = [ 1    0    0 ]   A^T = [1  1  1  0]
+//         [0  1  1  0]       [1/2  1/2  1/2]         [0  1 -1 -1]
+//         [0 -1  1  0]       [1/2 -1/2  1/2]
+//         [0  1  0 -1]       [ 0    0    1 ]
+//
+// To stay in integers, we use 2G instead of G, so U and M come out 4 times
+// too large, and Y gets divided by 4 at the end.
+//
+// V, U and M need 10, 12 and up to 32 bits, but Gemmini only multiplies 8-bit
+// values and only moves out 8-bit results. So there are two modes, picked by
+// max_error, the number of output LSBs that the caller lets any output be off
+// by:
+//
+//   exact (max_error is 0):  V, U and M keep all their bits, and the 16
+//           matmuls run on the CPU threads, whatever tiled_conv_type is. The
+//           outputs are bit-exact with conv_cpu.
+//
+//   approximate:  V and U are rounded to 8 bits, with right-shifts picked from
+//           their largest magnitudes, and the 16 matmuls run through
+//           tiled_matmul_auto on tiled_conv_type. M is rebuilt in acc_ts from
+//           8-bit "digits": the first matmul of each x is moved out with a
+//           shift large enough that none of its outputs saturate, and each
+//           further one adds the M built so far, negated, as D and moves out
+//           the remainder 7 bits further down. Before any matmul runs, the
+//           shift of the last digit is picked as the largest one for which
+//           winograd_error_bound stays within max_error. That bound adds up
+//           the worst cases of rounding V and U, which grow with
+//           2^(V's shift + U's shift) and with the number of in channels,
+//           and of rounding the last digit. So M only gets split into a
+//           second digit when the budget needs it: one digit takes 16
+//           multiplies, but two take 32, which is barely fewer than a direct
+//           conv's 36. If no shift fits the budget, that chunk of tiles
+//           falls back to exact mode. With full-range inputs and weights, V
+//           and U lose 2 and 3 bits, and the bound on a 64-channel layer is
+//           over 150 LSBs even at a shift of 10.
+//
+// Large layers are computed in groups of output channels and chunks of tiles,
+// so that U, V and M fit in the buffers that the caller passes in. The rows
+// of U and M are padded to a multiple of WINOGRAD_OB channels with zeros. In
+// exact mode, each matmul is register-blocked over WINOGRAD_TB tiles and
+// WINOGRAD_OB output channels.
+#ifndef ELEM_T_IS_FLOAT
+
+#define WINOGRAD_U_ELEMS (512 * 1024)
+#define WINOGRAD_V_ELEMS (256 * 1024)
+#define WINOGRAD_M_ELEMS (256 * 1024)
+#define WINOGRAD_MAX_CHANNELS 1024
+#define WINOGRAD_TB 4
+#define WINOGRAD_OB 16
+
+// Bits that each further M digit adds in approximate mode. Its remainder is
+// at most half an LSB of the digit before, so 7 bits keep it below 2^6.
+#define WINOGRAD_M_DIGIT_BITS 7
+
+// Working space of tiled_conv_winograd_auto, which is too large for the
+// stack. Callers usually declare one of these as a static.
+struct tiled_conv_winograd_buffers {
+  int16_t U[WINOGRAD_U_ELEMS];
+  int16_t V[WINOGRAD_V_ELEMS];
+  elem_t U_q[WINOGRAD_U_ELEMS];
+  elem_t V_q[WINOGRAD_V_ELEMS];
+  acc_t M[WINOGRAD_M_ELEMS];
+  elem_t M_q[WINOGRAD_M_ELEMS];
+};
+
+// Stands in for input pixels that lie in the padding, and for the missing
+// tiles of the last block in exact mode
+static const int16_t winograd_zeros[WINOGRAD_MAX_CHANNELS];
+
+struct tiled_conv_winograd_args {
+  int batch_size, in_dim, in_channels;
+  int out_channels, out_dim, padding;
+
+  const elem_t * input;
+  const elem_t * weights;
+  const acc_t * bias;
+  elem_t * output;
+
+  int act;
+  size_t shift, relu6_shift;
+
+  // Whether the current chunk of tiles is computed in exact mode
+  bool exact;
+
+  struct tiled_conv_winograd_buffers * buf;
+
+  int tiles_per_row;
+
+  // The current group of output channels, and the current chunk of tiles
+  int och0, ochs, ochs_padded;
+  int tile0, tiles;
+
+  // In approximate mode, M holds V U with the rounded V and U, negated so
+  // that it can be passed straight to the next digit's matmul as D. Its LSB
+  // is worth 2^M_exp / 4 LSBs of Y.
+  int M_exp;
+
+  // Largest magnitudes of U and V seen by each thread
+  int U_max[GEMMINI_MAX_THREADS];
+  int V_max[GEMMINI_MAX_THREADS];
+
+  // In approximate mode, the largest magnitudes in the rounded U[x] and V[x],
+  // and the largest sums of magnitudes along the in channels, over the
+  // columns of U[x] and the rows of V[x], before and after rounding V
+  int U_q_max[16], U_q_sum[16];
+  int V_q_max[16], V_q_sum[16], V_sum[16];
+
+  // Source, destination and shift of the current rounding to 8 bits
+  const int16_t * round_src;
+  elem_t * round_dst;
+  int round_shift;
+
+  // The x, shift and first-ness of the M digit being added
+  int digit_x, digit_shift;
+  bool digit_first;
+};
+
+// Transforms the weights of in channels [start, end) for the current group of
+// output channels. U[x] is an (in_channels x ochs) matrix.
+static void winograd_weights_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  struct tiled_conv_winograd_args * args = (struct tiled_conv_winograd_args *)args_;
+
+  const int ochs = args->ochs, ochs_padded = args->ochs_padded;
+  const size_t k_stride = (size_t)args->in_channels * args->out_channels;
+  const size_t x_stride = (size_t)args->in_channels * ochs_padded;
+
+  int max = args->U_max[thread_id];
+
+  for (size_t ich = start; ich < end; ich++) {
+    const elem_t * w = args->weights + ich * args->out_channels + args->och0;
+    int16_t * U = args->buf->U + ich * ochs_padded;
+
+    for (int x = 0; x < 16; x++)
+      for (int o = ochs; o < ochs_padded; o++)
+        U[x * x_stride + o] = 0;
+
+    for (int o = 0; o < ochs; o++) {
+      int t[4][3];
+      for (int c = 0; c < 3; c++) {
+        const int g0 = w[c * k_stride + o];
+        const int g1 = w[(3 + c) * k_stride + o];
+        const int g2 = w[(6 + c) * k_stride + o];
+
+        t[0][c] = 2 * g0;
+        t[1][c] = g0 + g1 + g2;
+        t[2][c] = g0 - g1 + g2;
+        t[3][c] = 2 * g2;
+      }
+
+      for (int r = 0; r < 4; r++) {
+        const int u[4] = {2 * t[r][0], t[r][0] + t[r][1] + t[r][2],
+          t[r][0] - t[r][1] + t[r][2], 2 * t[r][2]};
+
+        for (int c = 0; c < 4; c++) {
+          U[(4*r + c) * x_stride + o] = u[c];
+          const int mag = u[c] < 0 ? -u[c] : u[c];
+          max = mag > max ? mag : max;
+        }
+      }
+    }
+  }
+
+  args->U_max[thread_id] = max;
+}
+
+// Transforms the inputs of tiles [start, end) of the current chunk. V[x] is a
+// (tiles x in_channels) matrix.
+static void winograd_inputs_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  struct tiled_conv_winograd_args * args = (struct tiled_conv_winograd_args *)args_;
+
+  const int in_dim = args->in_dim, in_channels = args->in_channels;
+  const int tiles_per_row = args->tiles_per_row;
+  const size_t x_stride = (size_t)args->tiles * in_channels;
+
+  int max = args->V_max[thread_id];
+
+  for (size_t t = start; t < end; t++) {
+    const int tile = args->tile0 + t;
+    const int b = tile / (tiles_per_row * tiles_per_row);
+    const int trow = (tile / tiles_per_row) % tiles_per_row;
+    const int tcol = tile % tiles_per_row;
+
+    const elem_t * d[16];
+    for (int r = 0; r < 4; r++) {
+      for (int c = 0; c < 4; c++) {
+        const int irow = 2*trow - args->padding + r;
+        const int icol = 2*tcol - args->padding + c;
+
+        d[4*r + c] = irow < 0 || irow >= in_dim || icol < 0 || icol >= in_dim ?
+          (const elem_t *)winograd_zeros : args->input + ((b * in_dim + irow) * in_dim + icol) * in_channels;
+      }
+    }
+
+    int16_t * V = args->buf->V + t * in_channels;
+
+    for (int k = 0; k < in_channels; k++) {
+      int s[4][4];
+      for (int c = 0; c < 4; c++) {
+        s[0][c] = d[c][k] - d[8 + c][k];
+        s[1][c] = d[4 + c][k] + d[8 + c][k];
+        s[2][c] = d[8 + c][k] - d[4 + c][k];
+        s[3][c] = d[4 + c][k] - d[12 + c][k];
+      }
+
+      for (int r = 0; r < 4; r++) {
+        const int v[4] = {s[r][0] - s[r][2], s[r][1] + s[r][2],
+          s[r][2] - s[r][1], s[r][1] - s[r][3]};
+
+        for (int c = 0; c < 4; c++) {
+          V[(4*r + c) * x_stride + k] = v[c];
+          const int mag = v[c] < 0 ? -v[c] : v[c];
+          max = mag > max ? mag : max;
+        }
+      }
+    }
+  }
+
+  args->V_max[thread_id] = max;
+}
+
+// Rounds elements [start, end) of round_src down to 8 bits
+static void winograd_round_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  const struct tiled_conv_winograd_args * args = (const struct tiled_conv_winograd_args *)args_;
+  const int shift = args->round_shift;
+
+  if (shift == 0) {
+    for (size_t i = start; i < end; i++)
+      args->round_dst[i] = args->round_src[i];
+    return;
+  }
+
+  for (size_t i = start; i < end; i++) {
+    const int x = ROUNDING_RIGHT_SHIFT(args->round_src[i], shift);
+    args->round_dst[i] = x > elem_t_max ? elem_t_max : (x < elem_t_min ? elem_t_min : x);
+  }
+}
+
+// Measures the rounded U[x] for x in [start, end)
+static void winograd_U_range_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  struct tiled_conv_winograd_args * args = (struct tiled_conv_winograd_args *)args_;
+
+  const int in_channels = args->in_channels, ochs_padded = args->ochs_padded;
+
+  for (size_t x = start; x < end; x++) {
+    const elem_t * U = args->buf->U_q + x * in_channels * ochs_padded;
+    int max = 0, max_sum = 0;
+
+    for (int o = 0; o < ochs_padded; o++) {
+      int sum = 0;
+      for (int k = 0; k < in_channels; k++) {
+        const int mag = U[k * ochs_padded + o] < 0 ? -U[k * ochs_padded + o] : U[k * ochs_padded + o];
+        sum += mag;
+        max = mag > max ? mag : max;
+      }
+      max_sum = sum > max_sum ? sum : max_sum;
+    }
+
+    args->U_q_max[x] = max;
+    args->U_q_sum[x] = max_sum;
+  }
+}
+
+// Measures the rounded V[x] for x in [start, end)
+static void winograd_V_range_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  struct tiled_conv_winograd_args * args = (struct tiled_conv_winograd_args *)args_;
+
+  const int in_channels = args->in_channels, tiles = args->tiles;
+
+  for (size_t x = start; x < end; x++) {
+    const elem_t * V_q = args->buf->V_q + x * tiles * in_channels;
+    const int16_t * V = args->buf->V + x * tiles * in_channels;
+    int max = 0, max_sum = 0, max_unrounded_sum = 0;
+
+    for (int t = 0; t < tiles; t++) {
+      int sum = 0, unrounded_sum = 0;
+      for (int k = 0; k < in_channels; k++) {
+        const int mag = V_q[t * in_channels + k] < 0 ? -V_q[t * in_channels + k] : V_q[t * in_channels + k];
+        sum += mag;
+        max = mag > max ? mag : max;
+        unrounded_sum += V[t * in_channels + k] < 0 ? -V[t * in_channels + k] : V[t * in_channels + k];
+      }
+      max_sum = sum > max_sum ? sum : max_sum;
+      max_unrounded_sum = unrounded_sum > max_unrounded_sum ? unrounded_sum : max_unrounded_sum;
+    }
+
+    args->V_q_max[x] = max;
+    args->V_q_sum[x] = max_sum;
+    args->V_sum[x] = max_unrounded_sum;
+  }
+}
+
+// Adds the M digit that was just moved out for digit_x, on tiles [start, end)
+static void winograd_digit_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  const struct tiled_conv_winograd_args * args = (const struct tiled_conv_winograd_args *)args_;
+
+  const int ochs_padded = args->ochs_padded;
+  const size_t offset = (size_t)args->digit_x * args->tiles * ochs_padded;
+  const elem_t * M_q = args->buf->M_q + offset;
+  acc_t * M = args->buf->M + offset;
+
+  for (size_t t = start; t < end; t++) {
+    for (int o = 0; o < args->ochs; o++) {
+      const size_t i = t * ochs_padded + o;
+      const acc_t digit = (acc_t)M_q[i] * (1 << args->digit_shift);
+      M[i] = args->digit_first ? -digit : M[i] - digit;
+    }
+  }
+}
+
+// Computes all 16 M's of blocks of WINOGRAD_TB tiles at full precision, for
+// exact mode
+static void winograd_matmuls_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  const struct tiled_conv_winograd_args * args = (const struct tiled_conv_winograd_args *)args_;
+
+  const int in_channels = args->in_channels, ochs_padded = args->ochs_padded, tiles = args->tiles;
+
+  for (size_t blk = start; blk < end; blk++) {
+    const int t0 = blk * WINOGRAD_TB;
+
+    for (int x = 0; x < 16; x++) {
+      const int16_t * V = args->buf->V + (size_t)x * tiles * in_channels;
+      const int16_t * U = args->buf->U + (size_t)x * in_channels * ochs_padded;
+      acc_t * M = args->buf->M + (size_t)x * tiles * ochs_padded;
+
+      const int16_t * v[WINOGRAD_TB];
+      for (int t = 0; t < WINOGRAD_TB; t++)
+        v[t] = t0 + t < tiles ? V + (t0 + t) * in_channels : winograd_zeros;
+
+      for (int o0 = 0; o0 < ochs_padded; o0 += WINOGRAD_OB) {
+        acc_t c[WINOGRAD_TB][WINOGRAD_OB] = {{0}};
+
+        for (int k = 0; k < in_channels; k++) {
+          const int16_t * u = U + k * ochs_padded + o0;
+
+          for (int t = 0; t < WINOGRAD_TB; t++) {
+            const acc_t vk = v[t][k];
+            for (int o = 0; o < WINOGRAD_OB; o++)
+              c[t][o] += vk * u[o];
+          }
+        }
+
+        for (int t = 0; t < WINOGRAD_TB && t0 + t < tiles; t++)
+          for (int o = 0; o < WINOGRAD_OB; o++)
+            M[(t0 + t) * ochs_padded + o0 + o] = c[t][o];
+      }
+    }
+  }
+}
+
+// Transforms M back to the outputs of tiles [start, end) of the current chunk
+static void winograd_outputs_task(void * args_, size_t start, size_t end, size_t thread_id) {
+  const struct tiled_conv_winograd_args * args = (const struct tiled_conv_winograd_args *)args_;
+
+  const int out_dim = args->out_dim, out_channels = args->out_channels;
+  const int ochs = args->ochs, ochs_padded = args->ochs_padded;
+  const int tiles_per_row = args->tiles_per_row;
+  const size_t x_stride = (size_t)args->tiles * ochs_padded;
+
+  for (size_t t = start; t < end; t++) {
+    const int tile = args->tile0 + t;
+    const int b = tile / (tiles_per_row * tiles_per_row);
+    const int trow = (tile / tiles_per_row) % tiles_per_row;
+    const int tcol = tile % tiles_per_row;
+
+    const int rows = out_dim - 2*trow < 2 ? 1 : 2;
+    const int cols = out_dim - 2*tcol < 2 ? 1 : 2;
+
+    for (int o = 0; o < ochs; o++) {
+      // In exact mode, 4Y fits in an acc_t even when some of the sums
+      // leading up to it don't, so we add in unsigned arithmetic and let
+      // those sums wrap around
+      uint32_t m[16];
+      for (int x = 0; x < 16; x++) {
+        const acc_t M = args->buf->M[x * x_stride + t * ochs_padded + o];
+        m[x] = args->exact ? (uint32_t)M : -(uint32_t)M;
+      }
+
+      uint32_t s[2][4];
+      for (int c = 0; c < 4; c++) {
+        s[0][c] = m[c] + m[4 + c] + m[8 + c];
+        s[1][c] = m[4 + c] - m[8 + c] - m[12 + c];
+      }
+
+      const acc_t bias = args->bias == NULL ? 0 : args->bias[args->och0 + o];
+
+      for (int i = 0; i < rows; i++) {
+        const acc_t y[2] = {(acc_t)(s[i][0] + s[i][1] + s[i][2]),
+          (acc_t)(s[i][1] - s[i][2] - s[i][3])};
+
+        for (int j = 0; j < cols; j++) {
+          // In exact mode, 4Y is always a multiple of 4, so the shift is exact
+          const acc_t acc = (args->exact ? y[j] >> 2 :
+              (acc_t)ROUNDING_RIGHT_SHIFT((full_t)y[j] * (1 << args->M_exp), 2)) + bias;
+
+          args->output[((b * out_dim + 2*trow + i) * out_dim + 2*tcol + j) * out_channels + args->och0 + o] =
+            scale_and_sat(acc, args->act, args->shift, args->relu6_shift);
+        }
+      }
+    }
+  }
+}
+
+static int winograd_max(const int * maxes) {
+  int max = 0;
+  for (int i = 0; i < GEMMINI_MAX_THREADS; i++)
+    max = maxes[i] > max ? maxes[i] : max;
+  return max;
+}
+
+// Returns the smallest right-shift that brings max down into an elem_t
+static int winograd_round_shift(int max) {
+  int shift = 0;
+  while (max > (elem_t_max << shift))
+    shift++;
+  return shift;
+}
+
+static void winograd_round(struct tiled_conv_winograd_args * args,
+        const int16_t * src, elem_t * dst, size_t n, int shift) {
+  args->round_src = src;
+  args->round_dst = dst;
+  args->round_shift = shift;
+  gemmini_parallel_for(n, 4096, winograd_round_task, args);
+}
+
+// Returns how many output LSBs approximate mode can be off by, at most, on
+// the current chunk of tiles, if the last M digit is moved out with a shift
+// of last_shift. With V = V_q 2^V_shift + eV and U = U_q 2^U_shift + eU,
+// every element of V U - V_q U_q 2^(V_shift + U_shift) is a sum of
+// V eU + eV U_q 2^U_shift along the in channels.
+static uint64_t winograd_error_bound(const struct tiled_conv_winograd_args * args,
+        int V_shift, int U_shift, int last_shift) {
+  // Worst-case error of each M, in LSBs of the exact M
+  uint64_t M_err[16];
+  for (int x = 0; x < 16; x++) {
+    uint64_t err = 0;
+    if (U_shift > 0)
+      err += (uint64_t)args->V_sum[x] << (U_shift - 1);
+    if (V_shift > 0)
+      err += (uint64_t)args->U_q_sum[x] << (V_shift + U_shift - 1);
+    if (last_shift > 0)
+      err += (uint64_t)1 << (V_shift + U_shift + last_shift - 1);
+    M_err[x] = err;
+  }
+
+  // Each output sums 9 of the 16 M's
+  uint64_t max_err = 0;
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 2; j++) {
+      uint64_t err = 0;
+      for (int r = i; r < i + 3; r++)
+        for (int c = j; c < j + 3; c++)
+          err += M_err[4*r + c];
+      max_err = err > max_err ? err : max_err;
+    }
+  }
+
+  if (max_err == 0)
+    return 0;
+
+  // M is 4 times too large, and dividing it by 4 rounds off up to half an LSB
+  // of Y. Rounding Y to the output can then add one more LSB.
+  return (max_err + 2) / ((uint64_t)4 << args->shift) + 1;
+}
+
+void tiled_conv_winograd_auto(
+        int batch_size, int in_dim, int in_channels,
+        int out_channels, int out_dim,
+        int padding,
+
+        elem_t * input,
+        elem_t * weights,
+        acc_t * bias,
+        elem_t * output,
+
+        int act, size_t shift, size_t relu6_shift,
+        int max_error,
+        struct tiled_conv_winograd_buffers * buffers,
+
+        enum tiled_matmul_type_t tiled_conv_type) {
+
+#ifdef GEMMINI_ASSERTIONS
+  if (out_dim != in_dim + 2*padding - 2) {
+    printf("Winograd convs must have a 3x3 kernel and a stride of 1\n");
+    exit(1);
+  }
+
+  if (in_channels > WINOGRAD_MAX_CHANNELS) {
+    printf("Winograd convs can have at most %d input channels\n", WINOGRAD_MAX_CHANNELS);
+    exit(1);
+  }
+#endif
+
+  const int tiles_per_row = (out_dim + 1) / 2;
+  const int total_tiles = batch_size * tiles_per_row * tiles_per_row;
+
+  const int padded_out_channels = (out_channels + WINOGRAD_OB - 1) / WINOGRAD_OB * WINOGRAD_OB;
+  int och_group_size = WINOGRAD_U_ELEMS / (16 * in_channels) / WINOGRAD_OB * WINOGRAD_OB;
+  if (och_group_size > padded_out_channels)
+    och_group_size = padded_out_channels;
+
+  int tiles_per_chunk = WINOGRAD_V_ELEMS / (16 * in_channels);
+  if (tiles_per_chunk > WINOGRAD_M_ELEMS / (16 * och_group_size))
+    tiles_per_chunk = WINOGRAD_M_ELEMS / (16 * och_group_size);
+  if (tiles_per_chunk > total_tiles)
+    tiles_per_chunk = total_tiles;
+
+  struct tiled_conv_winograd_args args = {
+    .batch_size = batch_size, .in_dim = in_dim, .in_channels = in_channels,
+    .out_channels = out_channels, .out_dim = out_dim, .padding = padding,
+    .input = input, .weights = weights, .bias = bias, .output = output,
+    .act = act, .shift = shift, .relu6_shift = relu6_shift,
+    .buf = buffers,
+    .tiles_per_row = tiles_per_row,
+  };
+
+  for (int och0 = 0; och0 < out_channels; och0 += och_group_size) {
+    args.och0 = och0;
+    args.ochs = out_channels - och0 < och_group_size ? out_channels - och0 : och_group_size;
+    args.ochs_padded = (args.ochs + WINOGRAD_OB - 1) / WINOGRAD_OB * WINOGRAD_OB;
+
+    memset(args.U_max, 0, sizeof(args.U_max));
+    gemmini_parallel_for(in_channels, 1, winograd_weights_task, &args);
+
+    const size_t U_elems = 16 * in_channels * args.ochs_padded;
+    const int U_shift = winograd_round_shift(winograd_max(args.U_max));
+    if (max_error > 0) {
+      winograd_round(&args, buffers->U, buffers->U_q, U_elems, U_shift);
+      gemmini_parallel_for(16, 1, winograd_U_range_task, &args);
+    }
+
+    for (int tile0 = 0; tile0 < total_tiles; tile0 += tiles_per_chunk) {
+      args.tile0 = tile0;
+      args.tiles = total_tiles - tile0 < tiles_per_chunk ? total_tiles - tile0 : tiles_per_chunk;
+
+      memset(args.V_max, 0, sizeof(args.V_max));
+      gemmini_parallel_for(args.tiles, WINOGRAD_TB, winograd_inputs_task, &args);
+
+      // The rounded V U add up to 4Y / 2^(V_shift + U_shift), and the last
+      // digit of M is moved out with the largest shift that keeps the error
+      // within max_error. Past the largest first shift, there is only one
+      // digit anyway.
+      int V_shift = 0, last_shift = -1;
+      int first_shifts[16];
+
+      if (max_error > 0) {
+        const size_t V_elems = 16 * args.tiles * in_channels;
+        V_shift = winograd_round_shift(winograd_max(args.V_max));
+        winograd_round(&args, buffers->V, buffers->V_q, V_elems, V_shift);
+        gemmini_parallel_for(16, 1, winograd_V_range_task, &args);
+
+        for (int x = 0; x < 16; x++) {
+          // No element of V[x] U[x] is larger than either of these
+          const int bound_V = args.V_q_sum[x] * args.U_q_max[x];
+          const int bound_U = args.V_q_max[x] * args.U_q_sum[x];
+          first_shifts[x] = winograd_round_shift(bound_V < bound_U ? bound_V : bound_U);
+          last_shift = first_shifts[x] > last_shift ? first_shifts[x] : last_shift;
+        }
+
+        while (last_shift >= 0 &&
+            winograd_error_bound(&args, V_shift, U_shift, last_shift) > (uint64_t)max_error)
+          last_shift--;
+      }
+
+      args.exact = last_shift < 0;
+
+      if (args.exact) {
+        gemmini_parallel_for((args.tiles + WINOGRAD_TB - 1) / WINOGRAD_TB, 1,
+            winograd_matmuls_task, &args);
+      } else {
+        args.M_exp = V_shift + U_shift;
+
+        for (int x = 0; x < 16; x++) {
+          args.digit_x = x;
+          args.digit_shift = first_shifts[x] > last_shift ? first_shifts[x] : last_shift;
+          args.digit_first = true;
+
+          const size_t M_offset = (size_t)x * args.tiles * args.ochs_padded;
+
+          while (true) {
+            tiled_matmul_auto(args.tiles, args.ochs, in_channels,
+                buffers->V_q + (size_t)x * args.tiles * in_channels,
+                buffers->U_q + (size_t)x * in_channels * args.ochs_padded,
+                args.digit_first ? NULL : buffers->M + M_offset,
+                buffers->M_q + M_offset,
+                in_channels, args.ochs_padded, args.ochs_padded, args.ochs_padded,
+                MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+                NO_ACTIVATION, args.digit_shift, 0, NULL, NULL, false,
+                tiled_conv_type);
+
+            gemmini_parallel_for(args.tiles, WINOGRAD_TB, winograd_digit_task, &args);
+
+            if (args.digit_shift == last_shift)
+              break;
+
+            args.digit_shift -= WINOGRAD_M_DIGIT_BITS;
+            if (args.digit_shift < last_shift)
+              args.digit_shift = last_shift;
+            args.digit_first = false;
+          }
+        }
+      }
+
+      gemmini_parallel_for(args.tiles, WINOGRAD_TB, winograd_outputs_task, &args);
+    }
+  }
+}
+
+#endif // ELEM_T_IS_FLOAT
+
+// CPU residual addition
+//
+// Every residual add on the CPU goes through resadd_cpu_strided, which
+// computes C = clamp(ROUNDING_RIGHT_SHIFT(A, A_shift) + B) over an I x J
+// matrix whose three operands may have different row strides. On hosts with
+// SSE2, 16 elements at a time are widened to 16 bits, shifted, added with
+// saturation and packed back down with saturation. The rounding shift is done
+// branch-free with masks, so the results are bit-exact with the scalar loop.
+#if !defined(ELEM_T_IS_FLOAT) && defined(__SSE2__)
+static inline __m128i resadd_cpu_shift_epi16(__m128i x, int shift) {
+  if (shift <= 0)
+    return _mm_sll_epi16(x, _mm_cvtsi32_si128(-shift));
+
+  const __m128i one = _mm_set1_epi16(1);
+  const __m128i mask = _mm_set1_epi16(shift > 16 ? -1 : (1 << (shift-1)) - 1);
+
+  const __m128i quotient = _mm_sra_epi16(x, _mm_cvtsi32_si128(shift));
+  const __m128i half = _mm_and_si128(_mm_sra_epi16(x, _mm_cvtsi32_si128(shift-1)), one);
+  const __m128i odd = _mm_and_si128(quotient, one);
+  const __m128i rest = _mm_andnot_si128(
+      _mm_cmpeq_epi16(_mm_and_si128(x, mask), _mm_setzero_si128()), one);
+
+  return _mm_add_epi16(quotient, _mm_and_si128(half, _mm_or_si128(rest, odd)));
+}
+#endif
+
+static void resadd_cpu_strided(const size_t I, const size_t J,
+        const int A_shift,
+        const elem_t * A, const size_t stride_A,
+        const elem_t * B, const size_t stride_B,
+        elem_t * C, const size_t stride_C,
+        bool relu) {
+
+  const int minimum = relu ? 0 : elem_t_min;
+
+  for (size_t i = 0; i < I; i++) {
+    const elem_t * a = A + i * stride_A;
+    const elem_t * b = B + i * stride_B;
+    elem_t * c = C + i * stride_C;
+
+    size_t j = 0;
+
+#if !defined(ELEM_T_IS_FLOAT) && defined(__SSE2__)
+    // Shifted values must fit in 16 bits, and shift counts in the lanes
+    if (A_shift >= -7 && A_shift <= 16) {
+      const __m128i min16 = _mm_set1_epi16(minimum);
+
+      for (; j + 16 <= J; j += 16) {
+        const __m128i a8 = _mm_loadu_si128((const __m128i *)(a + j));
+        const __m128i b8 = _mm_loadu_si128((const __m128i *)(b + j));
+
+        const __m128i a_lo = resadd_cpu_shift_epi16(_mm_srai_epi16(_mm_unpacklo_epi8(a8, a8), 8), A_shift);
+        const __m128i a_hi = resadd_cpu_shift_epi16(_mm_srai_epi16(_mm_unpackhi_epi8(a8, a8), 8), A_shift);
+        const __m128i b_lo = _mm_srai_epi16(_mm_unpacklo_epi8(b8, b8), 8);
+        const __m128i b_hi = _mm_srai_epi16(_mm_unpackhi_epi8(b8, b8), 8);
+
+        const __m128i c_lo = _mm_max_epi16(_mm_adds_epi16(a_lo, b_lo), min16);
+        const __m128i c_hi = _mm_max_epi16(_mm_adds_epi16(a_hi, b_hi), min16);
+
+        _mm_storeu_si128((__m128i *)(c + j), _mm_packs_epi16(c_lo, c_hi));
+      }
+    }
+#endif
+
+    for (; j < J; j++) {
+      acc_t result = ROUNDING_RIGHT_SHIFT(a[j], A_shift) + b[j];
+      result = result > elem_t_max ? elem_t_max :
+          (result < minimum ? minimum : result);
+
+      c[j] = result;
+    }
+  }
+}
+
 void resadd_cpu(const size_t I, const size_t J,
         const int A_shift,
         const elem_t * A,
@@ -1512,21 +3894,7 @@ void resadd_cpu(const size_t I, const size_t J,
         bool relu,
         enum tiled_matmul_type_t matadd_type) {
 
-    const int minimum = relu ? 0 : elem_t_min;
-
-    for (int i = 0; i < I; i++) {
-        for (int j = 0; j < J; j++) {
-            const elem_t * a = A + i * J + j;
-            const elem_t * b = B + i * J + j;
-            elem_t * c = C + i * J + j;
-
-            acc_t result = ROUNDING_RIGHT_SHIFT(*a, A_shift) + *b;
-            result = result > elem_t_max ? elem_t_max :
-                (result < minimum ? minimum : result);
-
-            *c = result;
-        }
-    }
+  resadd_cpu_strided(I, J, A_shift, A, J, B, J, C, J, relu);
 }
 
 void sp_tiled_resadd(const size_t I, const size_t J,
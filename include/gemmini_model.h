@@ -0,0 +1,588 @@
+// See LICENSE for license details.
+
+#ifndef GEMMINI_MODEL_H
+#define GEMMINI_MODEL_H
+
+// A binary container for the networks that gemmini_net.h runs
+//
+// A model file holds a NetLayer table, and the weights and biases of every
+// layer, already laid out the way the kernels read them. The weights are
+// never copied: gemmini_model_layers() points the layers straight at the
+// blobs in the file image, which is either mmap'd (on Linux), or linked into
+// the binary as a raw section with GEMMINI_MODEL_INCBIN (on baremetal), so
+// the parameters no longer have to be compiled in from C headers.
+//
+// The activations are planned by net_plan() before the model is written, so
+// the file only stores their offsets into an arena of arena_bytes bytes,
+// which the caller provides. The network's input and output are the caller's
+// buffers as well.
+//
+// The file starts with a struct GemminiModelHeader, followed by n_layers
+// struct GemminiModelLayers at layers_offset. Every blob that a layer
+// references is aligned to GEMMINI_MODEL_ALIGN bytes from the start of the
+// file, which covers the row alignment of both elem_t and acc_t matrices as
+// long as the image itself is GEMMINI_MODEL_ALIGN-aligned. The params structs
+// are stored as they are, so a model can only be loaded by a build with the
+// same elem_t, acc_t and struct layouts as the one that wrote it.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "include/gemmini.h"
+#include "include/gemmini_nn.h"
+#include "include/gemmini_net.h"
+
+#ifndef BAREMETAL
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define GEMMINI_MODEL_MAGIC "GEMMINI"
+#define GEMMINI_MODEL_VERSION 1
+#define GEMMINI_MODEL_ALIGN 256
+#define GEMMINI_MODEL_NAME_BYTES 32
+
+enum gemmini_model_ref_t {
+    MODEL_REF_NONE,     // A NULL pointer
+    MODEL_REF_BLOB,     // offset bytes into the file
+    MODEL_REF_ARENA,    // offset bytes into the activation arena
+    MODEL_REF_INPUT,    // The network's input
+    MODEL_REF_OUTPUT,   // The network's output
+};
+
+struct GemminiModelRef {
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t offset;
+};
+
+struct GemminiModelHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t align;
+
+    // The sizes of the writer's structs and types
+    uint32_t conv_params_bytes, fc_params_bytes;
+    uint32_t elem_bytes, acc_bytes;
+
+    uint32_t n_layers;
+    uint32_t reserved;
+    uint64_t layers_offset;
+
+    uint64_t input_bytes, output_bytes, arena_bytes;
+    uint64_t file_bytes;
+};
+
+struct GemminiModelLayer {
+    uint32_t type;
+    int32_t act;
+    char name[GEMMINI_MODEL_NAME_BYTES];
+
+    uint32_t has_conv_params, has_fc_params;
+    struct ConvParams conv_params;
+    struct FcParams fc_params;
+
+    struct GemminiModelRef input, weights, bias, output;
+    struct GemminiModelRef im2col_buffer, pool_buffer, residual;
+};
+
+struct GemminiModel {
+    const struct GemminiModelHeader * header;
+    size_t n_layers;
+    size_t input_bytes, output_bytes, arena_bytes;
+};
+
+static const void * gemmini_model_ptr(const struct GemminiModelRef * ref,
+        const char * image, const void * input, void * output, char * arena)
+{
+    switch (ref->kind) {
+        case MODEL_REF_BLOB: return image + ref->offset;
+        case MODEL_REF_ARENA: return arena + ref->offset;
+        case MODEL_REF_INPUT: return input;
+        case MODEL_REF_OUTPUT: return output;
+    }
+    return NULL;
+}
+
+// Multiplies *bytes by factor, unless factor is negative or the product
+// doesn't fit
+static bool gemmini_model_mul(uint64_t * bytes, int64_t factor)
+{
+    if (factor < 0 || (factor != 0 && *bytes > UINT64_MAX / (uint64_t)factor))
+        return false;
+    *bytes *= factor;
+    return true;
+}
+
+// Works out how many bytes each buffer of a layer is read or written at, from
+// the same params net_run() sizes them with. Returns false if a size doesn't
+// fit in 64 bits, or comes from a negative param.
+static bool gemmini_model_layer_bytes(const struct GemminiModelLayer * record,
+        uint64_t * input, uint64_t * weights, uint64_t * bias, uint64_t * output,
+        uint64_t * im2col_buffer, uint64_t * pool_buffer, uint64_t * residual)
+{
+    const struct ConvParams * c = &record->conv_params;
+    const struct FcParams * f = &record->fc_params;
+    const int64_t elem = sizeof(elem_t), acc = sizeof(acc_t);
+
+    *input = *weights = *bias = *output = *im2col_buffer = *pool_buffer = *residual = 1;
+    bool ok = true;
+
+    switch (record->type) {
+        case NET_CONV:
+        case NET_CONV_DW:
+        case NET_POOL:
+            ok = gemmini_model_mul(input, c->batch_size) && gemmini_model_mul(input, c->in_dim) &&
+                gemmini_model_mul(input, c->in_dim) && gemmini_model_mul(input, c->in_channels) &&
+                gemmini_model_mul(input, elem);
+            break;
+        case NET_AVGPOOL:
+            ok = gemmini_model_mul(input, c->batch_size) && gemmini_model_mul(input, c->out_dim) &&
+                gemmini_model_mul(input, c->out_dim) && gemmini_model_mul(input, c->out_channels) &&
+                gemmini_model_mul(input, elem);
+            break;
+        case NET_RESADD:
+            ok = gemmini_model_mul(input, c->I) && gemmini_model_mul(input, c->J) &&
+                gemmini_model_mul(input, elem);
+            *residual = *input;
+            break;
+        case NET_FC:
+            ok = gemmini_model_mul(input, f->K) && gemmini_model_mul(input, f->J) &&
+                gemmini_model_mul(input, elem);
+            break;
+    }
+
+    switch (record->type) {
+        case NET_CONV:
+            // A conv without an im2col_buffer may be a matmul on its input
+            ok = ok && gemmini_model_mul(im2col_buffer, c->I) && gemmini_model_mul(im2col_buffer, c->K) &&
+                gemmini_model_mul(im2col_buffer, elem) &&
+                gemmini_model_mul(pool_buffer, c->I) && gemmini_model_mul(pool_buffer, c->J) &&
+                gemmini_model_mul(pool_buffer, elem) &&
+                gemmini_model_mul(weights, c->K) && gemmini_model_mul(weights, c->J) && gemmini_model_mul(weights, elem) &&
+                gemmini_model_mul(bias, c->J) && gemmini_model_mul(bias, acc);
+            if (record->im2col_buffer.kind == MODEL_REF_NONE && *im2col_buffer > *input)
+                *input = *im2col_buffer;
+            if (record->pool_buffer.kind == MODEL_REF_NONE)
+                *output = *pool_buffer;
+            else
+                ok = ok && gemmini_model_mul(output, c->batch_size) && gemmini_model_mul(output, c->out_dim_pooled) &&
+                    gemmini_model_mul(output, c->out_dim_pooled) && gemmini_model_mul(output, c->out_channels) &&
+                    gemmini_model_mul(output, elem);
+            break;
+        case NET_CONV_DW:
+            ok = ok && gemmini_model_mul(weights, c->in_channels) && gemmini_model_mul(weights, c->kernel_size) &&
+                gemmini_model_mul(weights, c->kernel_size) && gemmini_model_mul(weights, elem) &&
+                gemmini_model_mul(bias, c->in_channels) && gemmini_model_mul(bias, acc) &&
+                gemmini_model_mul(output, c->I) && gemmini_model_mul(output, c->J) && gemmini_model_mul(output, elem);
+            break;
+        case NET_RESADD:
+            *output = *input;
+            break;
+        case NET_POOL:
+            ok = ok && gemmini_model_mul(output, c->batch_size) && gemmini_model_mul(output, c->out_dim_pooled) &&
+                gemmini_model_mul(output, c->out_dim_pooled) && gemmini_model_mul(output, c->in_channels) &&
+                gemmini_model_mul(output, elem);
+            break;
+        case NET_AVGPOOL:
+            ok = ok && gemmini_model_mul(output, c->out_channels) && gemmini_model_mul(output, c->batch_size) &&
+                gemmini_model_mul(output, elem);
+            break;
+        case NET_FC:
+            ok = ok && gemmini_model_mul(weights, f->I) && gemmini_model_mul(weights, f->K) && gemmini_model_mul(weights, elem) &&
+                gemmini_model_mul(bias, f->I) && gemmini_model_mul(bias, f->J) && gemmini_model_mul(bias, acc) &&
+                gemmini_model_mul(output, f->I) && gemmini_model_mul(output, f->J) && gemmini_model_mul(output, elem);
+            break;
+    }
+
+    return ok;
+}
+
+// Checks that the bytes that a layer uses at ref lie inside whatever ref
+// points into
+static bool gemmini_model_ref_ok(const struct GemminiModelRef * ref, uint64_t bytes,
+        const struct GemminiModelHeader * header)
+{
+    uint64_t limit;
+
+    switch (ref->kind) {
+        case MODEL_REF_NONE:
+            return true;
+        case MODEL_REF_INPUT:
+            limit = header->input_bytes;
+            break;
+        case MODEL_REF_OUTPUT:
+            limit = header->output_bytes;
+            break;
+        case MODEL_REF_BLOB:
+            if (ref->offset % GEMMINI_MODEL_ALIGN != 0)
+                return false;
+            limit = header->file_bytes;
+            break;
+        case MODEL_REF_ARENA:
+            limit = header->arena_bytes;
+            break;
+        default:
+            return false;
+    }
+
+    const uint64_t offset = ref->kind == MODEL_REF_BLOB || ref->kind == MODEL_REF_ARENA ? ref->offset : 0;
+    return bytes <= limit && offset <= limit - bytes;
+}
+
+// Reads the header of the model in the bytes at image
+static bool gemmini_model_open(const void * image, size_t bytes, struct GemminiModel * model)
+{
+    const struct GemminiModelHeader * header = (const struct GemminiModelHeader *)image;
+
+    if (bytes < sizeof(*header) || memcmp(header->magic, GEMMINI_MODEL_MAGIC, sizeof(header->magic)) != 0) {
+        printf("Not a Gemmini model\n");
+        return false;
+    }
+
+    if (header->version != GEMMINI_MODEL_VERSION ||
+            header->conv_params_bytes != sizeof(struct ConvParams) ||
+            header->fc_params_bytes != sizeof(struct FcParams) ||
+            header->elem_bytes != sizeof(elem_t) || header->acc_bytes != sizeof(acc_t)) {
+        printf("The model was written by an incompatible build\n");
+        return false;
+    }
+
+    if (header->file_bytes > bytes ||
+            header->layers_offset > header->file_bytes ||
+            header->n_layers * sizeof(struct GemminiModelLayer) > header->file_bytes - header->layers_offset ||
+            (uintptr_t)image % GEMMINI_MODEL_ALIGN != 0) {
+        printf("The model is truncated or misaligned\n");
+        return false;
+    }
+
+    model->header = header;
+    model->n_layers = header->n_layers;
+    model->input_bytes = header->input_bytes;
+    model->output_bytes = header->output_bytes;
+    model->arena_bytes = header->arena_bytes;
+
+    return true;
+}
+
+// Fills layers[0, model->n_layers) in with the model's layers. Their weights,
+// biases and params point into the model image, their activations into the
+// arena, which must be row-aligned and at least model->arena_bytes long, and
+// the network reads from input and writes to output.
+static bool gemmini_model_layers(const struct GemminiModel * model,
+        const void * input, void * output, void * arena,
+        struct NetLayer * layers)
+{
+    const char * image = (const char *)model->header;
+    const struct GemminiModelLayer * records =
+        (const struct GemminiModelLayer *)(image + model->header->layers_offset);
+
+    for (size_t l = 0; l < model->n_layers; l++) {
+        const struct GemminiModelLayer * record = &records[l];
+        struct NetLayer * layer = &layers[l];
+
+        // FC layers are described by their fc_params, and all the others by
+        // their conv_params
+        bool ok = record->type <= NET_FC &&
+            (record->type == NET_FC ? record->has_fc_params : record->has_conv_params) &&
+            record->name[GEMMINI_MODEL_NAME_BYTES-1] == '\0';
+
+        uint64_t bytes[7];
+        ok = ok && gemmini_model_layer_bytes(record, &bytes[0], &bytes[1], &bytes[2], &bytes[3],
+            &bytes[4], &bytes[5], &bytes[6]);
+
+        const struct GemminiModelRef * refs[] = {&record->input, &record->weights, &record->bias,
+            &record->output, &record->im2col_buffer, &record->pool_buffer, &record->residual};
+        for (size_t r = 0; r < sizeof(refs)/sizeof(refs[0]); r++)
+            ok = ok && gemmini_model_ref_ok(refs[r], bytes[r], model->header);
+
+        if (!ok) {
+            printf("Layer %u of the model is corrupt\n", (unsigned)l);
+            return false;
+        }
+
+        layer->type = (enum net_layer_type_t)record->type;
+        layer->name = (char *)record->name;
+        layer->conv_params = record->has_conv_params ? &record->conv_params : NULL;
+        layer->fc_params = record->has_fc_params ? &record->fc_params : NULL;
+        layer->act = record->act;
+
+        layer->input = gemmini_model_ptr(&record->input, image, input, output, arena);
+        layer->weights = gemmini_model_ptr(&record->weights, image, input, output, arena);
+        layer->bias = gemmini_model_ptr(&record->bias, image, input, output, arena);
+        layer->output = (void *)gemmini_model_ptr(&record->output, image, input, output, arena);
+        layer->im2col_buffer = (void *)gemmini_model_ptr(&record->im2col_buffer, image, input, output, arena);
+        layer->pool_buffer = (void *)gemmini_model_ptr(&record->pool_buffer, image, input, output, arena);
+        layer->residual = gemmini_model_ptr(&record->residual, image, input, output, arena);
+        layer->strategy = NET_STRATEGY_DEFAULT;
+    }
+
+    return true;
+}
+
+#ifdef BAREMETAL
+
+#define GEMMINI_MODEL_STR_(x) #x
+#define GEMMINI_MODEL_STR(x) GEMMINI_MODEL_STR_(x)
+
+// Links the model file at path into the binary as name[], which ends at
+// name##_end[]. The file is read by the assembler, so it is never compiled.
+#define GEMMINI_MODEL_INCBIN(name, path) \
+    __asm__(".section .rodata.gemmini_model, \"a\"\n" \
+            ".balign " GEMMINI_MODEL_STR(GEMMINI_MODEL_ALIGN) "\n" \
+            ".global " #name "\n" \
+            #name ":\n" \
+            ".incbin \"" path "\"\n" \
+            ".global " #name "_end\n" \
+            #name "_end:\n" \
+            ".previous\n"); \
+    extern const char name[], name##_end[];
+
+#else
+
+// Maps the model file at path read-only, and returns its image, or NULL if it
+// can't be mapped. The pages are shared with the page cache, so the weights
+// are never copied. In a program that has called mlockall(MCL_FUTURE), as the
+// imagenet ones do so that Gemmini never touches a page that isn't resident,
+// the whole model is read in when it is mapped, though.
+static const void * gemmini_model_map(const char * path, size_t * bytes)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Couldn't open the model");
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("Couldn't stat the model");
+        close(fd);
+        return NULL;
+    }
+
+    void * image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (image == MAP_FAILED) {
+        perror("Couldn't map the model");
+        return NULL;
+    }
+
+    *bytes = st.st_size;
+    return image;
+}
+
+static void gemmini_model_unmap(const void * image, size_t bytes)
+{
+    munmap((void *)image, bytes);
+}
+
+// Writing models
+
+#ifndef GEMMINI_MODEL_MAX_BLOBS
+#define GEMMINI_MODEL_MAX_BLOBS (2 * NET_MAX_BUFFERS)
+#endif
+
+struct gemmini_model_blob {
+    const void * ptr;
+    size_t bytes;
+    uint64_t offset;
+};
+
+static struct gemmini_model_blob gemmini_model_blobs[GEMMINI_MODEL_MAX_BLOBS];
+
+static size_t gemmini_model_weight_bytes(const struct NetLayer * layer)
+{
+    const struct ConvParams * params = layer->conv_params;
+
+    switch (layer->type) {
+        case NET_CONV: return (size_t)params->K * params->J * sizeof(elem_t);
+        case NET_CONV_DW: return (size_t)params->in_channels * params->kernel_size * params->kernel_size * sizeof(elem_t);
+        case NET_FC: return (size_t)layer->fc_params->I * layer->fc_params->K * sizeof(elem_t);
+        default: return 0;
+    }
+}
+
+static size_t gemmini_model_bias_bytes(const struct NetLayer * layer)
+{
+    const struct ConvParams * params = layer->conv_params;
+
+    switch (layer->type) {
+        case NET_CONV: return (size_t)params->J * sizeof(acc_t);
+        case NET_CONV_DW: return (size_t)params->in_channels * sizeof(acc_t);
+        case NET_FC: return (size_t)layer->fc_params->I * layer->fc_params->J * sizeof(acc_t);
+        default: return 0;
+    }
+}
+
+static uint64_t gemmini_model_align(uint64_t offset)
+{
+    return (offset + GEMMINI_MODEL_ALIGN - 1) / GEMMINI_MODEL_ALIGN * GEMMINI_MODEL_ALIGN;
+}
+
+// Adds the blob at ptr to the file, unless another layer already did
+static bool gemmini_model_add_blob(size_t * n_blobs, const void * ptr, size_t bytes, uint64_t * file_bytes)
+{
+    if (ptr == NULL)
+        return true;
+
+    for (size_t b = 0; b < *n_blobs; b++) {
+        if (gemmini_model_blobs[b].ptr == ptr) {
+            if (bytes > gemmini_model_blobs[b].bytes) {
+                printf("Layers read different amounts of the same weights\n");
+                return false;
+            }
+            return true;
+        }
+    }
+
+    if (*n_blobs >= GEMMINI_MODEL_MAX_BLOBS) {
+        printf("More than %d weight blobs\n", GEMMINI_MODEL_MAX_BLOBS);
+        return false;
+    }
+
+    struct gemmini_model_blob * blob = &gemmini_model_blobs[(*n_blobs)++];
+    blob->ptr = ptr;
+    blob->bytes = bytes;
+    blob->offset = gemmini_model_align(*file_bytes);
+    *file_bytes = blob->offset + bytes;
+
+    return true;
+}
+
+static bool gemmini_model_ref(struct GemminiModelRef * ref, const void * ptr, size_t n_blobs,
+        const void * input, const void * output, const void * arena, size_t arena_bytes)
+{
+    const char * p = (const char *)ptr;
+
+    ref->reserved = 0;
+    ref->offset = 0;
+
+    if (ptr == NULL) {
+        ref->kind = MODEL_REF_NONE;
+    } else if (ptr == input) {
+        ref->kind = MODEL_REF_INPUT;
+    } else if (ptr == output) {
+        ref->kind = MODEL_REF_OUTPUT;
+    } else if (p >= (const char *)arena && p < (const char *)arena + arena_bytes) {
+        ref->kind = MODEL_REF_ARENA;
+        ref->offset = p - (const char *)arena;
+    } else {
+        for (size_t b = 0; b < n_blobs; b++) {
+            if (gemmini_model_blobs[b].ptr == ptr) {
+                ref->kind = MODEL_REF_BLOB;
+                ref->offset = gemmini_model_blobs[b].offset;
+                return true;
+            }
+        }
+
+        printf("A buffer is neither the input, the output, a weight nor planned\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Writes layers[0, n_layers) to a model file at path. The activations must
+// have been planned into the arena_bytes at arena by net_plan(), the network
+// must read input_bytes from input, and the output of the last layer is the
+// network's output.
+static bool gemmini_model_write(const char * path,
+        const struct NetLayer * layers, size_t n_layers,
+        const void * input, size_t input_bytes,
+        const void * arena, size_t arena_bytes)
+{
+    const void * output = n_layers > 0 ? layers[n_layers-1].output : NULL;
+
+    struct GemminiModelHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GEMMINI_MODEL_MAGIC, sizeof(header.magic));
+    header.version = GEMMINI_MODEL_VERSION;
+    header.align = GEMMINI_MODEL_ALIGN;
+    header.conv_params_bytes = sizeof(struct ConvParams);
+    header.fc_params_bytes = sizeof(struct FcParams);
+    header.elem_bytes = sizeof(elem_t);
+    header.acc_bytes = sizeof(acc_t);
+    header.n_layers = n_layers;
+    header.layers_offset = gemmini_model_align(sizeof(header));
+    header.input_bytes = input_bytes;
+    header.output_bytes = n_layers > 0 ? net_output_bytes(&layers[n_layers-1]) : 0;
+    header.arena_bytes = arena_bytes;
+
+    uint64_t file_bytes = header.layers_offset + n_layers * sizeof(struct GemminiModelLayer);
+
+    size_t n_blobs = 0;
+    for (size_t l = 0; l < n_layers; l++) {
+        if (!gemmini_model_add_blob(&n_blobs, layers[l].weights, gemmini_model_weight_bytes(&layers[l]), &file_bytes) ||
+                !gemmini_model_add_blob(&n_blobs, layers[l].bias, gemmini_model_bias_bytes(&layers[l]), &file_bytes))
+            return false;
+    }
+
+    header.file_bytes = file_bytes;
+
+    FILE * file = fopen(path, "wb");
+    if (file == NULL) {
+        perror("Couldn't create the model");
+        return false;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (size_t l = 0; l < n_layers && ok; l++) {
+        const struct NetLayer * layer = &layers[l];
+        struct GemminiModelLayer record;
+        memset(&record, 0, sizeof(record));
+
+        record.type = layer->type;
+        record.act = layer->act;
+        strncpy(record.name, layer->name, GEMMINI_MODEL_NAME_BYTES - 1);
+
+        if (layer->conv_params != NULL) {
+            record.has_conv_params = 1;
+            record.conv_params = *layer->conv_params;
+        }
+        if (layer->fc_params != NULL) {
+            record.has_fc_params = 1;
+            record.fc_params = *layer->fc_params;
+        }
+
+        ok = gemmini_model_ref(&record.input, layer->input, n_blobs, input, output, arena, arena_bytes) &&
+            gemmini_model_ref(&record.weights, layer->weights, n_blobs, input, output, arena, arena_bytes) &&
+            gemmini_model_ref(&record.bias, layer->bias, n_blobs, input, output, arena, arena_bytes) &&
+            gemmini_model_ref(&record.output, layer->output, n_blobs, input, output, arena, arena_bytes) &&
+            gemmini_model_ref(&record.im2col_buffer, layer->im2col_buffer, n_blobs, input, output, arena, arena_bytes) &&
+            gemmini_model_ref(&record.pool_buffer, layer->pool_buffer, n_blobs, input, output, arena, arena_bytes) &&
+            gemmini_model_ref(&record.residual, layer->residual, n_blobs, input, output, arena, arena_bytes);
+
+        if (ok) {
+            fseek(file, header.layers_offset + l * sizeof(record), SEEK_SET);
+            ok = fwrite(&record, sizeof(record), 1, file) == 1;
+        }
+    }
+
+    for (size_t b = 0; b < n_blobs && ok; b++) {
+        fseek(file, gemmini_model_blobs[b].offset, SEEK_SET);
+        ok = fwrite(gemmini_model_blobs[b].ptr, 1, gemmini_model_blobs[b].bytes, file) == gemmini_model_blobs[b].bytes;
+    }
+
+    // Pad the file out to its full length, in case the last blob is empty
+    if (ok) {
+        fseek(file, 0, SEEK_END);
+        for (long end = ftell(file); ok && end < (long)file_bytes; end++)
+            ok = fputc(0, file) != EOF;
+    }
+
+    if (fclose(file) != 0)
+        ok = false;
+
+    if (!ok)
+        printf("Couldn't write the model\n");
+
+    return ok;
+}
+
+#endif // BAREMETAL
+
+#endif // GEMMINI_MODEL_H
@@ -0,0 +1,1006 @@
+// See LICENSE for license details.
+
+#ifndef GEMMINI_NET_H
+#define GEMMINI_NET_H
+
+// A table-driven runtime for the imagenet models
+//
+// A network is an array of struct NetLayer, in the order the layers run. Each
+// layer names its parameters (a ConvParams or an FcParams), the buffers it
+// reads and writes, and its activation. net_run() walks the array, picks the
+// same implementation for every layer that the hand-written model mains did,
+// and adds up where the cycles went:
+//
+//   NET_CONV     In matmul mode, the input is im2col'd into im2col_buffer
+//                (unless it's NULL, for 1x1 convs that read their input as
+//                is), and multiplied with the weights. In conv mode, 1x1,
+//                stride-1 convs without pooling are still matmuls, and all
+//                others go through tiled_conv_auto. Layers that have a
+//                pool_buffer are max-pooled: in matmul mode, the conv writes to
+//                pool_buffer, which is then pooled into output, while
+//                tiled_conv_auto pools on its own.
+//   NET_CONV_DW  A depthwise conv on the CPU.
+//   NET_POOL     A standalone max-pool, described by conv_params.
+//   NET_RESADD   output = input + (residual shifted by conv_params->res_scale),
+//                with a ReLU when act is RELU.
+//   NET_AVGPOOL  Averages every channel over the whole image, and writes the
+//                result transposed, as an [out_channels][batch_size] matrix
+//                that the next NET_FC layer can use as its B.
+//   NET_FC       output = weights * input + bias, on an FcParams.
+//
+// Since the whole network is in one table, passes like layer fusion, buffer
+// planning or scheduling can work on that table instead of on code. net_plan()
+// is one such pass, which packs the activations into one arena, and
+// net_select_strategies() another, which picks how each conv runs (see
+// "Strategy selection" below).
+//
+// When a conv on Gemmini is followed by a CPU layer that reads its output,
+// net_run() overlaps the two, one image at a time (see "Pipelining" below). A
+// depthwise conv and the 1x1 conv after it are fused instead (see
+// "Depthwise-pointwise fusion" below).
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "include/gemmini.h"
+#include "include/gemmini_nn.h"
+
+enum net_layer_type_t {NET_CONV, NET_CONV_DW, NET_POOL, NET_RESADD, NET_AVGPOOL, NET_FC};
+
+// How a NET_CONV runs. NET_STRATEGY_DEFAULT picks between a matmul and
+// tiled_conv_auto from net_run()'s conv flag, as described above, while the
+// others override it for one layer:
+//
+//   NET_STRATEGY_MATMUL  im2col (if the layer has an im2col_buffer) and a
+//                        matmul, with net_run()'s tiled_matmul_type
+//   NET_STRATEGY_CONV    tiled_conv_auto, with net_run()'s tiled_matmul_type
+//   NET_STRATEGY_CPU     tiled_conv_auto on the CPU, even when the rest of the
+//                        network runs on Gemmini
+enum net_strategy_t {NET_STRATEGY_DEFAULT, NET_STRATEGY_MATMUL, NET_STRATEGY_CONV, NET_STRATEGY_CPU};
+
+struct NetLayer {
+    enum net_layer_type_t type;
+    char * name;
+
+    const struct ConvParams * conv_params;
+    const struct FcParams * fc_params;
+
+    const void * input;
+    const void * weights;
+    const void * bias;
+    void * output;
+
+    int act;
+
+    // NET_CONV only
+    void * im2col_buffer;
+    void * pool_buffer;
+    enum net_strategy_t strategy;
+
+    // NET_RESADD only
+    const void * residual;
+};
+
+struct NetCycles {
+    uint64_t im2col, matmul, conv, pool, conv_dw, res_add, other;
+
+    // Cycles during which Gemmini and the CPU worked on different layers
+    uint64_t overlap;
+};
+
+// How many bytes a layer writes to its output
+static size_t net_output_bytes(const struct NetLayer * layer)
+{
+    const struct ConvParams * params = layer->conv_params;
+
+    switch (layer->type) {
+        case NET_CONV:
+            if (layer->pool_buffer != NULL)
+                return (size_t)params->batch_size * params->out_dim_pooled * params->out_dim_pooled * params->out_channels * sizeof(elem_t);
+            return (size_t)params->I * params->J * sizeof(elem_t);
+
+        case NET_CONV_DW:
+        case NET_RESADD:
+            return (size_t)params->I * params->J * sizeof(elem_t);
+
+        case NET_POOL:
+            return (size_t)params->batch_size * params->out_dim_pooled * params->out_dim_pooled * params->in_channels * sizeof(elem_t);
+
+        case NET_AVGPOOL:
+            return (size_t)params->out_channels * params->batch_size * sizeof(elem_t);
+
+        case NET_FC:
+            return (size_t)layer->fc_params->I * layer->fc_params->J * sizeof(elem_t);
+    }
+
+    return 0;
+}
+
+// How net_run_conv runs a conv
+static enum net_strategy_t net_conv_strategy(const struct NetLayer * layer, bool conv)
+{
+    const struct ConvParams * params = layer->conv_params;
+
+    if (layer->strategy != NET_STRATEGY_DEFAULT)
+        return layer->strategy;
+    if (!conv || (params->kernel_size == 1 && params->stride == 1 && layer->pool_buffer == NULL))
+        return NET_STRATEGY_MATMUL;
+    return NET_STRATEGY_CONV;
+}
+
+// Whether net_run_conv runs a conv as a matmul
+static bool net_conv_is_matmul(const struct NetLayer * layer, bool conv)
+{
+    return net_conv_strategy(layer, conv) == NET_STRATEGY_MATMUL;
+}
+
+// Whether a conv that runs as a matmul is im2col'd first. In conv mode, the
+// 1x1 convs that run as matmuls read their input as is.
+static bool net_conv_uses_im2col(const struct NetLayer * layer, bool conv)
+{
+    return net_conv_is_matmul(layer, conv) && layer->im2col_buffer != NULL &&
+        (!conv || layer->strategy == NET_STRATEGY_MATMUL);
+}
+
+static void net_run_conv(const struct NetLayer * layer,
+        enum tiled_matmul_type_t tiled_matmul_type, bool conv, bool check,
+        struct NetCycles * cycles)
+{
+    const struct ConvParams * params = layer->conv_params;
+    const bool pooled = layer->pool_buffer != NULL;
+    uint64_t start, end;
+
+    const enum net_strategy_t strategy = net_conv_strategy(layer, conv);
+
+    if (strategy == NET_STRATEGY_MATMUL) {
+        const void * A = layer->input;
+
+        if (net_conv_uses_im2col(layer, conv)) {
+            start = read_cycles();
+
+            im2col(params->batch_size, params->in_channels, params->in_dim,
+                params->I, params->K,
+                (void *)layer->input, layer->im2col_buffer, params);
+
+            end = read_cycles();
+            cycles->im2col += end - start;
+
+            A = layer->im2col_buffer;
+        }
+
+        start = read_cycles();
+
+        tiled_matmul_nn_auto(params->I, params->J, params->K,
+            A, layer->weights, layer->bias, pooled ? layer->pool_buffer : layer->output,
+            layer->act, params->output_scale, 0, true,
+            tiled_matmul_type, check, layer->name);
+
+        end = read_cycles();
+        cycles->matmul += end - start;
+
+        if (pooled) {
+            start = read_cycles();
+
+            pool_with_col2im(params->I, params->J,
+                params->batch_size, params->out_channels, params->out_dim_pooled,
+                layer->pool_buffer, layer->output, params);
+
+            end = read_cycles();
+            cycles->pool += end - start;
+        }
+    } else {
+        start = read_cycles();
+
+        tiled_conv_auto(
+            params->batch_size, params->in_dim, params->in_channels,
+            params->out_channels, params->out_dim,
+            params->stride, params->padding, params->kernel_size,
+
+            (elem_t*)layer->input, (elem_t*)layer->weights, (acc_t*)layer->bias, (elem_t*)layer->output,
+
+            layer->act, params->output_scale, 0, NULL, NULL,
+            params->pool_size, pooled ? params->pool_stride : 0, params->pool_padding,
+
+            strategy == NET_STRATEGY_CPU ? CPU : tiled_matmul_type);
+
+        end = read_cycles();
+        cycles->conv += end - start;
+    }
+}
+
+static void net_run_avgpool(const struct NetLayer * layer)
+{
+    const struct ConvParams * params = layer->conv_params;
+    const elem_t * input = (const elem_t *)layer->input;
+    elem_t * output = (elem_t *)layer->output;
+
+    const int count = params->out_dim * params->out_dim;
+
+    for (int batch = 0; batch < params->batch_size; batch++) {
+        for (int channel = 0; channel < params->out_channels; channel++) {
+            int sum = 0;
+            for (int pixel = 0; pixel < count; pixel++)
+                sum += input[(batch * count + pixel) * params->out_channels + channel];
+
+            output[channel * params->batch_size + batch] = (sum + count/2) / count;
+        }
+    }
+}
+
+// Pipelining
+//
+// A conv that runs on Gemmini, followed by a depthwise conv or a pool on the
+// CPU that reads its output, is split up by image and software-pipelined:
+// while Gemmini computes image b of the conv, the worker threads compute image
+// b-1 of the CPU layer. The conv is issued async, one image at a time, and is
+// only waited for before the CPU reads the image it writes.
+//
+// The CPU layer then runs ahead of the rest of the conv, so the pair is only
+// pipelined if no image of the CPU layer writes memory that a later image of
+// the conv reads or writes. That can happen once net_plan() has let the two
+// layers' buffers share memory. The cycles in which both layers ran are
+// counted as overlap.
+
+static bool net_ranges_overlap(const void * a, size_t a_bytes, const void * b, size_t b_bytes)
+{
+    return (const char *)a < (const char *)b + b_bytes && (const char *)b < (const char *)a + a_bytes;
+}
+
+// The matrix or image that a conv's Gemmini work reads
+static const elem_t * net_conv_A(const struct NetLayer * layer, bool conv)
+{
+    if (net_conv_uses_im2col(layer, conv))
+        return (const elem_t *)layer->im2col_buffer;
+    return (const elem_t *)layer->input;
+}
+
+// How many bytes of net_conv_A() each image takes up
+static size_t net_conv_A_image_bytes(const struct NetLayer * layer, bool conv)
+{
+    const struct ConvParams * params = layer->conv_params;
+
+    if (net_conv_is_matmul(layer, conv))
+        return (size_t)params->I / params->batch_size * params->K * sizeof(elem_t);
+    return (size_t)params->in_dim * params->in_dim * params->in_channels * sizeof(elem_t);
+}
+
+static bool net_can_pipeline(const struct NetLayer * layers, size_t l, size_t n_layers,
+        enum tiled_matmul_type_t tiled_matmul_type, bool conv, bool check)
+{
+    if (check || (tiled_matmul_type != OS && tiled_matmul_type != WS) || l + 1 >= n_layers)
+        return false;
+
+    const struct NetLayer * gemmini = &layers[l];
+    const struct NetLayer * cpu = &layers[l+1];
+
+    if (gemmini->type != NET_CONV || (cpu->type != NET_CONV_DW && cpu->type != NET_POOL) ||
+            cpu->input != gemmini->output)
+        return false;
+
+    const bool matmul = net_conv_is_matmul(gemmini, conv);
+    const struct ConvParams * params = gemmini->conv_params;
+    const size_t batch_size = params->batch_size;
+
+    // Matmuls that are pooled afterwards are pooled on the CPU, and Gemmini
+    // only runs convs in WS
+    if (net_conv_strategy(gemmini, conv) == NET_STRATEGY_CPU ||
+            (matmul && gemmini->pool_buffer != NULL) || (!matmul && tiled_matmul_type != WS))
+        return false;
+
+    if (batch_size < 2 || cpu->conv_params->batch_size != batch_size ||
+            params->I % batch_size != 0 || net_output_bytes(gemmini) % batch_size != 0 ||
+            net_output_bytes(cpu) % batch_size != 0)
+        return false;
+
+    const size_t out_image_bytes = net_output_bytes(gemmini) / batch_size;
+    const size_t cpu_in_image_bytes = (size_t)cpu->conv_params->in_dim * cpu->conv_params->in_dim *
+        cpu->conv_params->in_channels * sizeof(elem_t);
+    const size_t cpu_out_image_bytes = net_output_bytes(cpu) / batch_size;
+
+    if (cpu_in_image_bytes != out_image_bytes)
+        return false;
+
+    if (cpu->type == NET_CONV_DW) {
+        const struct ConvParams * cpu_params = cpu->conv_params;
+        if ((size_t)cpu_params->in_channels * cpu_params->kernel_size * cpu_params->kernel_size > CONV_DW_WEIGHT_PACK_ELEMS)
+            return false;
+    }
+
+    const elem_t * A = net_conv_A(gemmini, conv);
+    const size_t A_image_bytes = net_conv_A_image_bytes(gemmini, conv);
+
+    for (size_t i = 0; i < batch_size; i++) {
+        const char * cpu_out = (const char *)cpu->output + i * cpu_out_image_bytes;
+
+        for (size_t j = i + 1; j < batch_size; j++) {
+            if (net_ranges_overlap(cpu_out, cpu_out_image_bytes, (const char *)A + j * A_image_bytes, A_image_bytes) ||
+                    net_ranges_overlap(cpu_out, cpu_out_image_bytes, (const char *)gemmini->output + j * out_image_bytes, out_image_bytes))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// Issues image b of a conv to Gemmini
+static gemmini_token_t net_issue_conv_image(const struct NetLayer * layer, size_t b,
+        enum tiled_matmul_type_t tiled_matmul_type, bool conv)
+{
+    const struct ConvParams * params = layer->conv_params;
+    const elem_t * A = (const elem_t *)((const char *)net_conv_A(layer, conv) + b * net_conv_A_image_bytes(layer, conv));
+    elem_t * output = (elem_t *)((char *)layer->output + b * (net_output_bytes(layer) / params->batch_size));
+
+    if (net_conv_is_matmul(layer, conv)) {
+        const size_t rows = params->I / params->batch_size;
+
+        return tiled_matmul_async(rows, params->J, params->K,
+            A, (const elem_t *)layer->weights, (const acc_t *)layer->bias, output,
+            params->K, params->J, params->J, params->J,
+            MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+            layer->act, params->output_scale, 0, NULL, NULL, true,
+            tiled_matmul_type);
+    }
+
+    return tiled_conv_async(
+        1, params->in_dim, params->in_channels,
+        params->out_channels, params->out_dim,
+        params->stride, params->padding, params->kernel_size,
+
+        (elem_t*)A, (elem_t*)layer->weights, (acc_t*)layer->bias, output,
+
+        layer->act, params->output_scale, 0, NULL, NULL,
+        params->pool_size, layer->pool_buffer != NULL ? params->pool_stride : 0, params->pool_padding,
+
+        tiled_matmul_type);
+}
+
+// Runs image b of a CPU layer on the calling thread, or starts it on the
+// worker threads when fork is set. A depthwise conv that can't be forked is
+// run on the calling thread instead.
+static void net_cpu_image(const struct NetLayer * layer, size_t b, bool fork,
+        struct conv_dw_args * dw_args, struct pool_args * pool_args)
+{
+    const struct ConvParams * params = layer->conv_params;
+    const elem_t * input = (const elem_t *)layer->input + b * params->in_dim * params->in_dim * params->in_channels;
+    elem_t * output = (elem_t *)((char *)layer->output + b * (net_output_bytes(layer) / params->batch_size));
+
+    if (layer->type == NET_CONV_DW) {
+        if (fork) {
+            *dw_args = (struct conv_dw_args) {
+                .J = params->J, .in_J = params->in_channels,
+                .batch_size = 1, .channels = params->in_channels,
+                .out_dim = params->out_dim, .kernel_size = params->kernel_size,
+                .input = input,
+                .weight = (const elem_t *)layer->weights,
+                .bias = (const acc_t *)layer->bias,
+                .output = output,
+                .params = params,
+            };
+            if (conv_dw_fork(dw_args, b == 0))
+                return;
+        }
+
+        conv_dw(params->I / params->batch_size, params->J,
+            1, params->in_channels, params->in_dim, params->out_dim, params->kernel_size,
+            (void *)input, layer->weights, layer->bias, (void *)output, params);
+    } else {
+        if (fork) {
+            *pool_args = (struct pool_args) {
+                .in_J = params->in_channels,
+                .channels = params->in_channels, .in_dim = params->in_dim, .out_dim = params->out_dim_pooled,
+                .input = input,
+                .output = output,
+                .params = params,
+            };
+            pool_fork(pool_args, 1);
+        } else {
+            pool(1, params->in_channels, params->in_dim, params->out_dim_pooled,
+                (void *)input, (void *)output, params);
+        }
+    }
+}
+
+static void net_run_pipelined(const struct NetLayer * gemmini, const struct NetLayer * cpu,
+        enum tiled_matmul_type_t tiled_matmul_type, bool conv,
+        struct NetCycles * cycles)
+{
+    const struct ConvParams * params = gemmini->conv_params;
+    const size_t batch_size = params->batch_size;
+    const bool fork = gemmini_num_threads() > 1;
+    uint64_t start, end;
+
+    struct conv_dw_args dw_args;
+    struct pool_args pool_args;
+
+    uint64_t * gemmini_cycles = net_conv_is_matmul(gemmini, conv) ? &cycles->matmul : &cycles->conv;
+    uint64_t * cpu_cycles = cpu->type == NET_CONV_DW ? &cycles->conv_dw : &cycles->pool;
+
+    if (net_conv_uses_im2col(gemmini, conv)) {
+        start = read_cycles();
+
+        im2col(params->batch_size, params->in_channels, params->in_dim,
+            params->I, params->K,
+            (void *)gemmini->input, gemmini->im2col_buffer, params);
+
+        end = read_cycles();
+        cycles->im2col += end - start;
+    }
+
+    start = read_cycles();
+    gemmini_wait(net_issue_conv_image(gemmini, 0, tiled_matmul_type, conv));
+    end = read_cycles();
+    *gemmini_cycles += end - start;
+
+    for (size_t b = 1; b <= batch_size; b++) {
+        gemmini_token_t token = GEMMINI_TOKEN_DONE;
+
+        start = read_cycles();
+
+        if (b < batch_size && fork) {
+            net_cpu_image(cpu, b - 1, true, &dw_args, &pool_args);
+            token = net_issue_conv_image(gemmini, b, tiled_matmul_type, conv);
+            gemmini_parallel_join();
+        } else {
+            if (b < batch_size)
+                token = net_issue_conv_image(gemmini, b, tiled_matmul_type, conv);
+            net_cpu_image(cpu, b - 1, false, &dw_args, &pool_args);
+        }
+
+        gemmini_wait(token);
+
+        end = read_cycles();
+        if (b < batch_size)
+            cycles->overlap += end - start;
+        else
+            *cpu_cycles += end - start;
+    }
+}
+
+// Depthwise-pointwise fusion
+//
+// A depthwise conv followed by the 1x1 conv that reads its output, as in every
+// MobileNet block, is fused into one operator: the depthwise conv computes its
+// output a tile of whole rows at a time, and each tile is multiplied with the
+// 1x1 conv's weights on Gemmini while the CPU computes the next one. The
+// depthwise conv's output then only exists one tile at a time, in two
+// NET_DW_PW_TILE_ELEMS buffers that stay in the cache, instead of being written
+// out to DRAM in full and read back by the 1x1 conv.
+//
+// The depthwise layer's output buffer is never written, so the pair is only
+// fused when no later layer reads it. A conv before the depthwise conv is then
+// not pipelined with it, since the fused pair already overlaps the CPU and
+// Gemmini.
+#define NET_DW_PW_TILE_ELEMS (32 * 1024)
+
+static elem_t net_dw_pw_tiles[2][NET_DW_PW_TILE_ELEMS] row_align(1);
+
+static bool net_can_fuse_dw_pw(const struct NetLayer * layers, size_t l, size_t n_layers,
+        enum tiled_matmul_type_t tiled_matmul_type, bool conv, bool check)
+{
+    if (check || (tiled_matmul_type != OS && tiled_matmul_type != WS) || l + 1 >= n_layers)
+        return false;
+
+    const struct NetLayer * dw = &layers[l];
+    const struct NetLayer * pw = &layers[l+1];
+
+    if (dw->type != NET_CONV_DW || pw->type != NET_CONV || pw->input != dw->output)
+        return false;
+
+    const struct ConvParams * dw_params = dw->conv_params;
+    const struct ConvParams * pw_params = pw->conv_params;
+
+    // The 1x1 conv has to be a plain matmul over the depthwise conv's output
+    if (!net_conv_is_matmul(pw, conv) || pw->pool_buffer != NULL ||
+            pw_params->kernel_size != 1 || pw_params->stride != 1 || pw_params->padding != 0 ||
+            pw_params->I != dw_params->I || pw_params->K != dw_params->J)
+        return false;
+
+    // A tile holds at least one row, and the depthwise weights are packed once
+    if ((size_t)dw_params->out_dim * dw_params->J > NET_DW_PW_TILE_ELEMS ||
+            (size_t)dw_params->in_channels * dw_params->kernel_size * dw_params->kernel_size > CONV_DW_WEIGHT_PACK_ELEMS)
+        return false;
+
+    for (size_t k = l + 2; k < n_layers; k++) {
+        if (layers[k].input == dw->output || layers[k].residual == dw->output)
+            return false;
+    }
+
+    return true;
+}
+
+static void net_run_dw_pw(const struct NetLayer * dw, const struct NetLayer * pw,
+        enum tiled_matmul_type_t tiled_matmul_type,
+        struct NetCycles * cycles)
+{
+    const struct ConvParams * dw_params = dw->conv_params;
+    const struct ConvParams * pw_params = pw->conv_params;
+    const size_t out_dim = dw_params->out_dim;
+    const size_t rows = dw_params->batch_size * out_dim;
+    const size_t tile_rows = NET_DW_PW_TILE_ELEMS / (out_dim * dw_params->J);
+    uint64_t start, end;
+
+    struct conv_dw_args args = {
+        .J = dw_params->J, .in_J = dw_params->in_channels,
+        .batch_size = dw_params->batch_size, .channels = dw_params->in_channels,
+        .out_dim = out_dim, .kernel_size = dw_params->kernel_size,
+        .input = (const elem_t *)dw->input,
+        .weight = (const elem_t *)dw->weights,
+        .bias = (const acc_t *)dw->bias,
+        .output = net_dw_pw_tiles[0],
+        .params = dw_params,
+    };
+
+    start = read_cycles();
+
+    conv_dw_pack_weights(&args, 0, args.channels);
+    gemmini_parallel_for(rows < tile_rows ? rows : tile_rows, 1, conv_dw_task, &args);
+
+    end = read_cycles();
+    cycles->conv_dw += end - start;
+
+    for (size_t row0 = 0, t = 0; row0 < rows; row0 += tile_rows, t++) {
+        const size_t next_row0 = row0 + tile_rows;
+        const size_t tile_I = (rows - row0 < tile_rows ? rows - row0 : tile_rows) * out_dim;
+
+        start = read_cycles();
+
+        const gemmini_token_t token = tiled_matmul_async(tile_I, pw_params->J, pw_params->K,
+            net_dw_pw_tiles[t % 2], (const elem_t *)pw->weights, (const acc_t *)pw->bias,
+            (elem_t *)pw->output + row0 * out_dim * pw_params->J,
+            pw_params->K, pw_params->J, pw_params->J, pw_params->J,
+            MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+            pw->act, pw_params->output_scale, 0, NULL, NULL, true,
+            tiled_matmul_type);
+
+        if (next_row0 < rows) {
+            args.output = net_dw_pw_tiles[(t + 1) % 2];
+            args.row0 = next_row0;
+            gemmini_parallel_for(rows - next_row0 < tile_rows ? rows - next_row0 : tile_rows, 1, conv_dw_task, &args);
+        }
+
+        gemmini_wait(token);
+
+        end = read_cycles();
+        if (next_row0 < rows)
+            cycles->overlap += end - start;
+        else
+            cycles->matmul += end - start;
+    }
+}
+
+// Runs layers [0, n_layers), and adds the cycles each kind of work took to
+// *cycles. The matmuls of every layer are checked against the CPU when check is
+// set.
+static void net_run(const struct NetLayer * layers, size_t n_layers,
+        enum tiled_matmul_type_t tiled_matmul_type, bool conv, bool check,
+        struct NetCycles * cycles)
+{
+    for (size_t l = 0; l < n_layers; l++) {
+        const struct NetLayer * layer = &layers[l];
+        const struct ConvParams * params = layer->conv_params;
+        uint64_t start, end;
+
+        if (net_can_fuse_dw_pw(layers, l, n_layers, tiled_matmul_type, conv, check)) {
+            net_run_dw_pw(layer, &layers[l+1], tiled_matmul_type, cycles);
+            l++;
+            continue;
+        }
+
+        if (net_can_pipeline(layers, l, n_layers, tiled_matmul_type, conv, check) &&
+                !net_can_fuse_dw_pw(layers, l + 1, n_layers, tiled_matmul_type, conv, check)) {
+            net_run_pipelined(layer, &layers[l+1], tiled_matmul_type, conv, cycles);
+            l++;
+            continue;
+        }
+
+        switch (layer->type) {
+            case NET_CONV:
+                net_run_conv(layer, tiled_matmul_type, conv, check, cycles);
+                break;
+
+            case NET_CONV_DW:
+                start = read_cycles();
+
+                conv_dw(params->I, params->J,
+                    params->batch_size, params->in_channels, params->in_dim, params->out_dim, params->kernel_size,
+                    layer->input, layer->weights, layer->bias, layer->output, params);
+
+                end = read_cycles();
+                cycles->conv_dw += end - start;
+                break;
+
+            case NET_POOL:
+                start = read_cycles();
+
+                pool(params->batch_size, params->in_channels, params->in_dim, params->out_dim_pooled,
+                    (void *)layer->input, layer->output, params);
+
+                end = read_cycles();
+                cycles->pool += end - start;
+                break;
+
+            case NET_RESADD:
+                start = read_cycles();
+
+                tiled_resadd_auto(params->I, params->J,
+                    params->res_scale,
+                    layer->residual,
+                    layer->input,
+                    layer->output,
+                    layer->act == RELU,
+                    tiled_matmul_type == CPU ? CPU : WS);
+
+                end = read_cycles();
+                cycles->res_add += end - start;
+                break;
+
+            case NET_AVGPOOL:
+                start = read_cycles();
+
+                net_run_avgpool(layer);
+
+                end = read_cycles();
+                cycles->other += end - start;
+                break;
+
+            case NET_FC:
+                start = read_cycles();
+
+                tiled_matmul_nn_auto(layer->fc_params->I, layer->fc_params->J, layer->fc_params->K,
+                    layer->weights, layer->input, layer->bias, layer->output,
+                    layer->act, layer->fc_params->output_scale, 0, false,
+                    tiled_matmul_type, check, layer->name);
+
+                end = read_cycles();
+                cycles->matmul += end - start;
+                break;
+        }
+    }
+}
+
+// Strategy selection
+//
+// Which way of running a conv is fastest differs from layer to layer: a
+// strided or pooled conv saves its im2col on tiled_conv_auto, a 1x1 conv is
+// already a matmul, and a conv with few channels may not be worth moving in and
+// out of Gemmini at all. net_select_strategies() makes a calibration run of the
+// network, in which every conv runs once with each strategy that can run it,
+// and records the fastest one in the layer's strategy. The other layers run
+// once, as net_run() would run them, so that every conv is timed on the input
+// it really gets.
+//
+// Every strategy computes the same output, so it doesn't matter to the layers
+// after a conv which of its strategies ran last.
+
+static const char * net_strategy_name(enum net_strategy_t strategy)
+{
+    switch (strategy) {
+        case NET_STRATEGY_DEFAULT: return "default";
+        case NET_STRATEGY_MATMUL: return "matmul";
+        case NET_STRATEGY_CONV: return "conv";
+        case NET_STRATEGY_CPU: return "cpu";
+    }
+    return "unknown";
+}
+
+// Whether a conv can run with a strategy
+static bool net_strategy_ok(const struct NetLayer * layer, enum net_strategy_t strategy,
+        enum tiled_matmul_type_t tiled_matmul_type)
+{
+    const struct ConvParams * params = layer->conv_params;
+
+    switch (strategy) {
+        case NET_STRATEGY_MATMUL:
+            // Without an im2col_buffer, the input has to be its own im2col
+            return layer->im2col_buffer != NULL ||
+                (params->kernel_size == 1 && params->stride == 1 && params->padding == 0);
+
+        case NET_STRATEGY_CONV:
+            // Gemmini only runs convs in WS, and with CPU, this is the same as
+            // NET_STRATEGY_CPU
+            return tiled_matmul_type == WS;
+
+        case NET_STRATEGY_CPU:
+            return true;
+
+        case NET_STRATEGY_DEFAULT:
+            break;
+    }
+
+    return false;
+}
+
+// Picks a strategy for every conv in layers [0, n_layers) by running them, and
+// returns how many cycles the calibration run took
+static uint64_t net_select_strategies(struct NetLayer * layers, size_t n_layers,
+        enum tiled_matmul_type_t tiled_matmul_type, bool conv)
+{
+    const enum net_strategy_t strategies[] = {NET_STRATEGY_MATMUL, NET_STRATEGY_CONV, NET_STRATEGY_CPU};
+    const uint64_t calibration_start = read_cycles();
+
+    for (size_t l = 0; l < n_layers; l++) {
+        struct NetLayer * layer = &layers[l];
+        struct NetCycles cycles = {0};
+
+        if (layer->type != NET_CONV) {
+            net_run(layer, 1, tiled_matmul_type, conv, false, &cycles);
+            continue;
+        }
+
+        enum net_strategy_t best = NET_STRATEGY_DEFAULT;
+        uint64_t best_cycles = 0;
+
+        for (size_t s = 0; s < sizeof(strategies)/sizeof(strategies[0]); s++) {
+            if (!net_strategy_ok(layer, strategies[s], tiled_matmul_type))
+                continue;
+
+            layer->strategy = strategies[s];
+
+            const uint64_t start = read_cycles();
+            net_run_conv(layer, tiled_matmul_type, conv, false, &cycles);
+            const uint64_t end = read_cycles();
+
+            if (best == NET_STRATEGY_DEFAULT || end - start < best_cycles) {
+                best = strategies[s];
+                best_cycles = end - start;
+            }
+        }
+
+        layer->strategy = best;
+    }
+
+    return read_cycles() - calibration_start;
+}
+
+static void net_print_strategies(const struct NetLayer * layers, size_t n_layers, bool conv)
+{
+    printf("\nConv strategies:\n");
+    for (size_t l = 0; l < n_layers; l++) {
+        if (layers[l].type == NET_CONV)
+            printf("  %s: %s\n", layers[l].name, net_strategy_name(net_conv_strategy(&layers[l], conv)));
+    }
+}
+
+// Activation memory planning
+//
+// net_plan() finds every activation buffer that some layer writes (an output,
+// an im2col_buffer or a pool_buffer), and how long it lives: from the first
+// layer that touches it to the last one that reads it. Buffers whose lifetimes
+// overlap get disjoint ranges of one arena, while buffers that are never live
+// at the same time share memory. Each buffer is placed at the lowest offset
+// that doesn't collide with a buffer it overlaps with, largest buffers first,
+// and every offset is row-aligned like the statically allocated buffers are.
+//
+// Buffers that no layer writes (the network's input images, the weights and
+// the biases), and the output of the last layer, which the caller reads after
+// net_run(), are left where they are.
+//
+// Since net_plan() only tells buffers apart by their addresses, a table that
+// is always planned doesn't need real buffers for its activations. It can name
+// NetActivations instead, which are one byte each, and net_plan_arena() then
+// gives them memory in an arena that is as large as the plan needs.
+
+#ifndef NET_MAX_BUFFERS
+#define NET_MAX_BUFFERS 512
+#endif
+
+#define NET_BUFFER_ALIGN (DIM * sizeof(elem_t))
+
+// Baremetal builds have no heap, so net_plan_arena() plans into a static
+// arena of this many bytes there
+#ifndef NET_STATIC_ARENA_BYTES
+#define NET_STATIC_ARENA_BYTES (16 * 1024 * 1024)
+#endif
+
+// Stands in for an activation that only exists once net_plan() has placed it
+typedef char NetActivation;
+
+struct NetPlan {
+    size_t buffers;          // How many buffers were planned
+    size_t unplanned_bytes;  // How much memory they took up on their own
+    size_t arena_bytes;      // How much of the arena they take up now
+};
+
+struct net_buffer {
+    const void * ptr;
+    size_t bytes;
+    size_t first, last;
+    size_t offset;
+};
+
+static struct net_buffer net_buffers[NET_MAX_BUFFERS];
+
+static struct net_buffer * net_find_buffer(size_t n_buffers, const void * ptr)
+{
+    for (size_t b = 0; b < n_buffers; b++)
+        if (net_buffers[b].ptr == ptr)
+            return &net_buffers[b];
+    return NULL;
+}
+
+// Records that layer l writes "bytes" bytes into ptr
+static void net_define_buffer(size_t * n_buffers, const void * ptr, size_t bytes, size_t l)
+{
+    if (ptr == NULL)
+        return;
+
+    struct net_buffer * buffer = net_find_buffer(*n_buffers, ptr);
+
+    if (buffer == NULL) {
+#ifdef GEMMINI_ASSERTIONS
+        if (*n_buffers >= NET_MAX_BUFFERS) {
+            printf("net_plan: more than %d activation buffers\n", NET_MAX_BUFFERS);
+            exit(1);
+        }
+#endif
+        buffer = &net_buffers[(*n_buffers)++];
+        buffer->ptr = ptr;
+        buffer->bytes = 0;
+        buffer->first = l;
+        buffer->last = l;
+    }
+
+    if (bytes > buffer->bytes)
+        buffer->bytes = bytes;
+    if (l > buffer->last)
+        buffer->last = l;
+}
+
+// Records that layer l reads ptr, if it's a planned buffer
+static void net_use_buffer(size_t n_buffers, const void * ptr, size_t l)
+{
+    struct net_buffer * buffer = ptr == NULL ? NULL : net_find_buffer(n_buffers, ptr);
+
+    if (buffer != NULL && l > buffer->last)
+        buffer->last = l;
+}
+
+static const void * net_planned_ptr(size_t n_buffers, const void * ptr, char * arena)
+{
+    struct net_buffer * buffer = ptr == NULL ? NULL : net_find_buffer(n_buffers, ptr);
+    return buffer == NULL ? ptr : arena + buffer->offset;
+}
+
+// Plans the activations of layers [0, n_layers) into the arena_size bytes at
+// arena, which must be row-aligned, and points the layers at their new
+// buffers. If the plan doesn't fit, the layers are left as they are, and false
+// is returned. Either way, *plan says how much memory the plan needs.
+static bool net_plan(struct NetLayer * layers, size_t n_layers,
+        void * arena, size_t arena_size, struct NetPlan * plan)
+{
+    size_t n_buffers = 0;
+
+    // Find the buffers each layer writes, and their sizes
+    for (size_t l = 0; l < n_layers; l++) {
+        const struct NetLayer * layer = &layers[l];
+        const struct ConvParams * params = layer->conv_params;
+
+        if (layer->type == NET_CONV) {
+            net_define_buffer(&n_buffers, layer->im2col_buffer, (size_t)params->I * params->K * sizeof(elem_t), l);
+            net_define_buffer(&n_buffers, layer->pool_buffer, (size_t)params->I * params->J * sizeof(elem_t), l);
+        }
+        net_define_buffer(&n_buffers, layer->output, net_output_bytes(layer), l);
+
+        net_use_buffer(n_buffers, layer->input, l);
+        net_use_buffer(n_buffers, layer->residual, l);
+    }
+
+    // The caller reads the last layer's output, so it stays where it is
+    if (n_layers > 0) {
+        struct net_buffer * output = net_find_buffer(n_buffers, layers[n_layers-1].output);
+        if (output != NULL)
+            *output = net_buffers[--n_buffers];
+    }
+
+    // Sort the buffers by size, largest first
+    for (size_t i = 1; i < n_buffers; i++) {
+        struct net_buffer buffer = net_buffers[i];
+        size_t j = i;
+        for (; j > 0 && net_buffers[j-1].bytes < buffer.bytes; j--)
+            net_buffers[j] = net_buffers[j-1];
+        net_buffers[j] = buffer;
+    }
+
+    plan->buffers = n_buffers;
+    plan->unplanned_bytes = 0;
+    plan->arena_bytes = 0;
+
+    for (size_t i = 0; i < n_buffers; i++) {
+        struct net_buffer * buffer = &net_buffers[i];
+        const size_t bytes = (buffer->bytes + NET_BUFFER_ALIGN - 1) / NET_BUFFER_ALIGN * NET_BUFFER_ALIGN;
+        size_t offset = 0;
+
+        // Move past every placed buffer that is live at the same time and that
+        // collides with [offset, offset + bytes), until nothing collides.
+        // Every move is to the end of some placed buffer, so this terminates.
+        bool moved = true;
+        while (moved) {
+            moved = false;
+            for (size_t j = 0; j < i; j++) {
+                const struct net_buffer * placed = &net_buffers[j];
+
+                if (placed->first > buffer->last || buffer->first > placed->last)
+                    continue;
+
+                if (offset < placed->offset + placed->bytes && placed->offset < offset + bytes) {
+                    offset = (placed->offset + placed->bytes + NET_BUFFER_ALIGN - 1) / NET_BUFFER_ALIGN * NET_BUFFER_ALIGN;
+                    moved = true;
+                }
+            }
+        }
+
+        buffer->offset = offset;
+        plan->unplanned_bytes += buffer->bytes;
+        if (offset + bytes > plan->arena_bytes)
+            plan->arena_bytes = offset + bytes;
+    }
+
+    if (plan->arena_bytes > arena_size)
+        return false;
+
+    for (size_t l = 0; l < n_layers; l++) {
+        struct NetLayer * layer = &layers[l];
+
+        layer->input = net_planned_ptr(n_buffers, layer->input, arena);
+        layer->residual = net_planned_ptr(n_buffers, layer->residual, arena);
+        layer->im2col_buffer = (void *)net_planned_ptr(n_buffers, layer->im2col_buffer, arena);
+        layer->pool_buffer = (void *)net_planned_ptr(n_buffers, layer->pool_buffer, arena);
+        layer->output = (void *)net_planned_ptr(n_buffers, layer->output, arena);
+    }
+
+    return true;
+}
+
+// Plans the activations of layers [0, n_layers) into an arena of exactly the
+// size the plan needs, and returns the arena. On baremetal, the arena is a
+// static NET_STATIC_ARENA_BYTES buffer instead. Since the layers may name
+// NetActivations, a plan that can't be placed is an error.
+static void * net_plan_arena(struct NetLayer * layers, size_t n_layers, struct NetPlan * plan)
+{
+    // The first call only sizes the plan
+    net_plan(layers, n_layers, NULL, 0, plan);
+
+#ifdef BAREMETAL
+    static char arena[NET_STATIC_ARENA_BYTES] row_align(1);
+    const size_t arena_bytes = sizeof(arena);
+#else
+    void * arena = NULL;
+    const size_t arena_bytes = plan->arena_bytes;
+    if (posix_memalign(&arena, NET_BUFFER_ALIGN, arena_bytes > 0 ? arena_bytes : 1) != 0) {
+        printf("net_plan_arena: can't allocate %llu bytes of activations\n", (unsigned long long)arena_bytes);
+        exit(1);
+    }
+#endif
+
+    if (!net_plan(layers, n_layers, arena, arena_bytes, plan)) {
+        printf("net_plan_arena: the activations need %llu bytes, but the arena only has %llu\n",
+            (unsigned long long)plan->arena_bytes, (unsigned long long)arena_bytes);
+        exit(1);
+    }
+
+    return arena;
+}
+
+static void net_print_plan(const struct NetPlan * plan)
+{
+    printf("\nActivation buffers: %llu\n", (unsigned long long)plan->buffers);
+    printf("Activation memory without planning: %llu bytes\n", (unsigned long long)plan->unplanned_bytes);
+    printf("Peak activation memory: %llu bytes\n", (unsigned long long)plan->arena_bytes);
+}
+
+static void net_print_cycles(const struct NetCycles * cycles)
+{
+    uint64_t total_cycles = cycles->im2col + cycles->matmul + cycles->pool + cycles->conv +
+        cycles->conv_dw + cycles->res_add + cycles->other + cycles->overlap;
+
+    printf("\nTotal cycles: %llu (100%%)\n", (unsigned long long)total_cycles);
+    printf("Matmul cycles: %llu (%d%%)\n", (unsigned long long)cycles->matmul, (int)((cycles->matmul * 100) / total_cycles));
+    printf("Im2col cycles: %llu (%d%%)\n", (unsigned long long)cycles->im2col, (int)((cycles->im2col * 100) / total_cycles));
+    printf("Conv cycles: %llu (%d%%)\n", (unsigned long long)cycles->conv, (int)((cycles->conv * 100) / total_cycles));
+    printf("Pooling cycles: %llu (%d%%)\n", (unsigned long long)cycles->pool, (int)((cycles->pool * 100) / total_cycles));
+    printf("Depthwise convolution cycles: %llu (%d%%)\n", (unsigned long long)cycles->conv_dw, (int)((cycles->conv_dw * 100) / total_cycles));
+    printf("Res add cycles: %llu (%d%%)\n", (unsigned long long)cycles->res_add, (int)((cycles->res_add * 100) / total_cycles));
+    printf("Other cycles: %llu (%d%%)\n", (unsigned long long)cycles->other, (int)((cycles->other * 100) / total_cycles));
+    printf("Overlapped Gemmini and CPU cycles: %llu (%d%%)\n", (unsigned long long)cycles->overlap, (int)((cycles->overlap * 100) / total_cycles));
+}
+
+#endif // GEMMINI_NET_H
@@ -71,6 +71,454 @@ struct FcParams {
             printf("%d: %d times\n", num, count); \
     }
 
+// Verification
+//
+// Check mode verifies each matmul C = act(scale(A * B + D)) with
+// algorithm-based fault tolerance. Row i of A * B sums to A_i . (B 1), and
+// column j to (1^T A) . B_j, which takes O(IK + KJ) work to compute instead of
+// the O(IJK) of a rerun. The accumulators themselves never leave Gemmini, but
+// each output bounds the accumulator it came from to within 2^shift / 2 of
+// output << shift (from one side only, where it saturated or the activation
+// clamped it), so every row and column sum has to fall within the sum of its
+// outputs' bounds. The rows and columns whose sums don't are recomputed on
+// the CPU, element by element, and compared exactly. Errors smaller than a
+// row's or column's slack, or in an output that saturated, don't show up in
+// its sum at all, so ABFT_SAMPLES rows and columns, picked at random, are
+// recomputed every time as well, but most such errors are still missed.
+// Outputs that a ReLU zeroed would only bound their accumulators from above,
+// so matmuls that are verified run without their ReLU, which is applied on
+// the CPU after verification. Float builds have no exact checksums, so they
+// recompute every row.
+//
+// Building with GEMMINI_VERIFY_ON_CPU verifies them by recomputing all of C on
+// the CPU instead, VERIFY_REFERENCE_ELEMS elements at a time, and comparing
+// every element exactly. That catches every error, and keeps Gemmini's
+// activation, but costs as much CPU work as running the matmul there.
+//
+// Building with GEMMINI_ALWAYS_VERIFY verifies every tiled_matmul_nn and
+// tiled_matmul_nn_auto call, and not just the ones in check mode.
+#ifdef GEMMINI_ALWAYS_VERIFY
+#define GEMMINI_VERIFY_ALL true
+#else
+#define GEMMINI_VERIFY_ALL false
+#endif
+
+#ifdef GEMMINI_VERIFY_ON_CPU
+#define GEMMINI_VERIFY_RECOMPUTE true
+#else
+#define GEMMINI_VERIFY_RECOMPUTE false
+#endif
+
+#define VERIFY_REFERENCE_ELEMS (64 * 1024)
+
+// Checksums are only kept for up to this many columns of C and of A
+#define ABFT_MAX_DIM 8192
+#define ABFT_SAMPLES 2
+
+struct abft_bounds {
+    int64_t lo, hi;
+    bool lo_open, hi_open;
+};
+
+static elem_t verify_reference[VERIFY_REFERENCE_ELEMS];
+
+static uint32_t abft_seed = 1;
+
+static int64_t abft_A_col_sums[ABFT_MAX_DIM];
+static int64_t abft_B_row_sums[ABFT_MAX_DIM];
+static struct abft_bounds abft_C_col_bounds[ABFT_MAX_DIM];
+
+// Adds the range of accumulators that output y could have come from, minus
+// the bias d, to *bounds
+static void abft_add_bounds(struct abft_bounds * bounds, elem_t y, acc_t d,
+        int act, size_t shift, size_t relu6_shift)
+{
+    const int64_t center = (int64_t)y * ((int64_t)1 << shift) - d;
+    const int64_t half = shift == 0 ? 0 : (int64_t)1 << (shift - 1);
+
+    bounds->lo += center - half;
+    bounds->hi += center + half;
+
+    if (y == elem_t_max || (act == RELU6 && y == (6 << relu6_shift)))
+        bounds->hi_open = true;
+    if (y == elem_t_min || ((act == RELU || act == RELU6) && y == 0))
+        bounds->lo_open = true;
+}
+
+static bool abft_bounds_hold(const struct abft_bounds * bounds, int64_t sum)
+{
+    return (bounds->lo_open || sum >= bounds->lo) && (bounds->hi_open || sum <= bounds->hi);
+}
+
+static elem_t abft_element(size_t dim_J, size_t dim_K,
+        const elem_t * A, const elem_t * B, const acc_t * D,
+        size_t i, size_t j,
+        int act, size_t shift, size_t relu6_shift, bool repeating_bias)
+{
+    acc_t acc = D == NULL ? 0 : D[(repeating_bias ? 0 : i) * dim_J + j];
+    for (size_t k = 0; k < dim_K; k++)
+        acc += A[i * dim_K + k] * B[k * dim_J + j];
+
+    return scale_and_sat(acc, act, shift, relu6_shift);
+}
+
+// Compares C with the CPU's result, VERIFY_REFERENCE_ELEMS elements at a time.
+// Returns false if any element of C is wrong.
+static bool tiled_matmul_nn_recompute(size_t dim_I, size_t dim_J, size_t dim_K,
+        const elem_t * A, const elem_t * B, const acc_t * D, const elem_t * C,
+        int act, size_t shift, size_t relu6_shift, bool repeating_bias,
+        const char * layer_name)
+{
+    const size_t rows = dim_J > VERIFY_REFERENCE_ELEMS ? 0 : VERIFY_REFERENCE_ELEMS / dim_J;
+
+    for (size_t i0 = 0; i0 < dim_I; i0 += rows > 0 ? rows : 1) {
+        const size_t I = rows == 0 ? 1 : (dim_I - i0 < rows ? dim_I - i0 : rows);
+
+        if (rows > 0)
+            tiled_matmul_auto(I, dim_J, dim_K,
+                A + i0 * dim_K, B, D == NULL || repeating_bias ? D : D + i0 * dim_J, verify_reference,
+                dim_K, dim_J, dim_J, dim_J,
+                MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+                act, shift, relu6_shift, NULL, NULL, repeating_bias,
+                CPU);
+
+        for (size_t i = i0; i < i0 + I; i++) {
+            for (size_t j = 0; j < dim_J; j++) {
+                const elem_t gold = rows > 0 ? verify_reference[(i - i0) * dim_J + j] :
+                    abft_element(dim_J, dim_K, A, B, D, i, j, act, shift, relu6_shift, repeating_bias);
+
+                if (C[i * dim_J + j] != gold) {
+                    printf("%s: element (%llu, %llu) is incorrect\n", layer_name, (unsigned long long)i, (unsigned long long)j);
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// Verifies a C that tiled_matmul_nn computed from A, B and D with checksums.
+// Returns false if an element of C that it finds is wrong.
+static bool tiled_matmul_nn_verify(size_t dim_I, size_t dim_J, size_t dim_K,
+        const elem_t * A, const elem_t * B, const acc_t * D, const elem_t * C,
+        int act, size_t shift, size_t relu6_shift, bool repeating_bias,
+        const char * layer_name)
+{
+#ifdef ELEM_T_IS_FLOAT
+    const bool checksums = false;
+#else
+    const bool checksums = dim_J <= ABFT_MAX_DIM && dim_K <= ABFT_MAX_DIM;
+#endif
+
+    size_t bad_rows = 0, bad_cols = 0;
+
+    size_t sample_rows[ABFT_SAMPLES], sample_cols[ABFT_SAMPLES];
+    for (int s = 0; s < ABFT_SAMPLES; s++) {
+        abft_seed = abft_seed * 1103515245 + 12345;
+        sample_rows[s] = (abft_seed >> 8) % dim_I;
+        abft_seed = abft_seed * 1103515245 + 12345;
+        sample_cols[s] = (abft_seed >> 8) % dim_J;
+    }
+
+    if (checksums) {
+        for (size_t k = 0; k < dim_K; k++) {
+            abft_A_col_sums[k] = 0;
+            abft_B_row_sums[k] = 0;
+            for (size_t j = 0; j < dim_J; j++)
+                abft_B_row_sums[k] += B[k * dim_J + j];
+        }
+
+        memset(abft_C_col_bounds, 0, dim_J * sizeof(abft_C_col_bounds[0]));
+    }
+
+    for (size_t i = 0; i < dim_I; i++) {
+        bool recompute = !checksums;
+
+        if (checksums) {
+            const acc_t * bias = D == NULL ? NULL : D + (repeating_bias ? 0 : i) * dim_J;
+
+            int64_t row_sum = 0;
+            for (size_t k = 0; k < dim_K; k++) {
+                row_sum += A[i * dim_K + k] * abft_B_row_sums[k];
+                abft_A_col_sums[k] += A[i * dim_K + k];
+            }
+
+            struct abft_bounds row_bounds = {0};
+            for (size_t j = 0; j < dim_J; j++) {
+                const acc_t d = bias == NULL ? 0 : bias[j];
+                abft_add_bounds(&row_bounds, C[i * dim_J + j], d, act, shift, relu6_shift);
+                abft_add_bounds(&abft_C_col_bounds[j], C[i * dim_J + j], d, act, shift, relu6_shift);
+            }
+
+            recompute = !abft_bounds_hold(&row_bounds, row_sum);
+            bad_rows += recompute;
+        }
+
+        for (int s = 0; s < ABFT_SAMPLES; s++)
+            recompute = recompute || sample_rows[s] == i;
+
+        for (size_t j = 0; recompute && j < dim_J; j++) {
+            if (C[i * dim_J + j] != abft_element(dim_J, dim_K, A, B, D, i, j, act, shift, relu6_shift, repeating_bias)) {
+                printf("%s: element (%llu, %llu) is incorrect\n", layer_name, (unsigned long long)i, (unsigned long long)j);
+                return false;
+            }
+        }
+    }
+
+    for (size_t j = 0; checksums && j < dim_J; j++) {
+        int64_t col_sum = 0;
+        for (size_t k = 0; k < dim_K; k++)
+            col_sum += abft_A_col_sums[k] * B[k * dim_J + j];
+
+        bool sampled = false;
+        for (int s = 0; s < ABFT_SAMPLES; s++)
+            sampled = sampled || sample_cols[s] == j;
+
+        if (abft_bounds_hold(&abft_C_col_bounds[j], col_sum) && !sampled)
+            continue;
+
+        bad_cols += !abft_bounds_hold(&abft_C_col_bounds[j], col_sum);
+
+        for (size_t i = 0; i < dim_I; i++) {
+            if (C[i * dim_J + j] != abft_element(dim_J, dim_K, A, B, D, i, j, act, shift, relu6_shift, repeating_bias)) {
+                printf("%s: element (%llu, %llu) is incorrect\n", layer_name, (unsigned long long)i, (unsigned long long)j);
+                return false;
+            }
+        }
+    }
+
+    if (bad_rows > 0 || bad_cols > 0)
+        printf("%s: %llu rows and %llu columns failed their checksums, but were recomputed correctly\n",
+            layer_name, (unsigned long long)bad_rows, (unsigned long long)bad_cols);
+
+    return true;
+}
+
+// Golden cache
+//
+// Regression runs check the same layers on the same inputs over and over. The
+// golden cache remembers a digest of the correct output of every matmul it has
+// checked, keyed by a hash of the layer's name, A, B, D and params. Once a
+// matmul is in the cache, checking it only takes hashing its inputs and
+// output, and comparing the output's digest exactly. A matmul that isn't in
+// the cache yet is checked against the CPU, a block of rows at a time, and
+// its digest is added. Only digests are kept, so a cache for all of resnet50
+// takes a few kilobytes instead of the hundreds of megabytes the outputs
+// themselves would.
+//
+// A cache is a file of GEMMINI_GOLDEN lines, like a tuning database (see
+// gemmini.h). On Linux, golden_open() loads one, and golden_save() writes it
+// back with the new digests. On baremetal, building with
+// -DGEMMINI_GOLDEN_CACHE=\"path\" compiles one in, and the digests of matmuls
+// that were missing from it are printed as GEMMINI_GOLDEN lines to add to it.
+// Without a cache, check mode verifies matmuls as above.
+#define GOLDEN_MAX_ENTRIES 1024
+
+struct golden_entry {
+    uint64_t key, digest;
+};
+
+#define GOLDEN_FORMAT "GEMMINI_GOLDEN(0x%016llx, 0x%016llx)\n"
+
+#ifdef GEMMINI_GOLDEN_CACHE
+#define GEMMINI_GOLDEN(key, digest) {key, digest},
+static const struct golden_entry golden_builtin_entries[] = {
+#include GEMMINI_GOLDEN_CACHE
+    {0}
+};
+#undef GEMMINI_GOLDEN
+#define GOLDEN_BUILTIN_ENTRIES (sizeof(golden_builtin_entries)/sizeof(golden_builtin_entries[0]) - 1)
+static bool golden_enabled = true;
+#else
+static const struct golden_entry * golden_builtin_entries = NULL;
+#define GOLDEN_BUILTIN_ENTRIES 0
+static bool golden_enabled = false;
+#endif
+
+static struct golden_entry golden_entries[GOLDEN_MAX_ENTRIES];
+static size_t golden_n_entries = 0;
+
+static uint64_t golden_hash(const void * data, size_t bytes, uint64_t h)
+{
+    const unsigned char * p = (const unsigned char *)data;
+
+    for (; bytes >= sizeof(uint64_t); bytes -= sizeof(uint64_t), p += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        h = (h ^ word) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 29;
+    }
+
+    for (; bytes > 0; bytes--, p++)
+        h = (h ^ *p) * 0x100000001B3ULL;
+
+    return h;
+}
+
+static uint64_t golden_key(size_t dim_I, size_t dim_J, size_t dim_K,
+        const elem_t * A, const elem_t * B, const acc_t * D,
+        int act, size_t shift, size_t relu6_shift, bool repeating_bias,
+        const char * layer_name)
+{
+    const uint64_t params[] = {dim_I, dim_J, dim_K, (uint64_t)act, shift, relu6_shift, repeating_bias, D != NULL};
+
+    uint64_t h = golden_hash(layer_name, strlen(layer_name), 0xCBF29CE484222325ULL);
+    h = golden_hash(params, sizeof(params), h);
+    h = golden_hash(A, dim_I * dim_K * sizeof(elem_t), h);
+    h = golden_hash(B, dim_K * dim_J * sizeof(elem_t), h);
+    if (D != NULL)
+        h = golden_hash(D, (repeating_bias ? 1 : dim_I) * dim_J * sizeof(acc_t), h);
+
+    return h;
+}
+
+static struct golden_entry * golden_find(uint64_t key)
+{
+    for (size_t i = 0; i < golden_n_entries + GOLDEN_BUILTIN_ENTRIES; i++) {
+        const struct golden_entry * entry = i < golden_n_entries ?
+            &golden_entries[i] : &golden_builtin_entries[i - golden_n_entries];
+
+        if (entry->key == key)
+            return (struct golden_entry *)entry;
+    }
+    return NULL;
+}
+
+// Checks C against the golden cache, or against the CPU if it's not in the
+// cache yet. Returns false if any element of C is wrong.
+static bool golden_check(size_t dim_I, size_t dim_J, size_t dim_K,
+        const elem_t * A, const elem_t * B, const acc_t * D, const elem_t * C,
+        int act, size_t shift, size_t relu6_shift, bool repeating_bias,
+        const char * layer_name)
+{
+    const uint64_t key = golden_key(dim_I, dim_J, dim_K, A, B, D,
+        act, shift, relu6_shift, repeating_bias, layer_name);
+    const uint64_t digest = golden_hash(C, dim_I * dim_J * sizeof(elem_t), 0xCBF29CE484222325ULL);
+
+    struct golden_entry * entry = golden_find(key);
+    if (entry != NULL && entry->digest == digest)
+        return true;
+
+    // A mismatch is only reported once the CPU has found the wrong element
+    if (!tiled_matmul_nn_recompute(dim_I, dim_J, dim_K, A, B, D, C,
+                act, shift, relu6_shift, repeating_bias, layer_name))
+        return false;
+
+    if (entry != NULL)
+        printf("%s: the golden output is stale\n", layer_name);
+
+    if (entry == NULL || entry < golden_entries || entry >= golden_entries + golden_n_entries) {
+        if (golden_n_entries == GOLDEN_MAX_ENTRIES) {
+            printf("The golden cache is full\n");
+            return true;
+        }
+        entry = &golden_entries[golden_n_entries++];
+    }
+
+    entry->key = key;
+    entry->digest = digest;
+
+#ifdef BAREMETAL
+    printf(GOLDEN_FORMAT, (unsigned long long)key, (unsigned long long)digest);
+#endif
+
+    return true;
+}
+
+#ifndef BAREMETAL
+// Checks matmuls against the golden cache at path from now on. The file
+// doesn't have to exist yet.
+static bool golden_open(const char * path)
+{
+    golden_enabled = true;
+
+    FILE * file = fopen(path, "r");
+    if (file == NULL)
+        return true;
+
+    bool ok = true;
+    char line[128];
+
+    while (ok && fgets(line, sizeof(line), file) != NULL) {
+        unsigned long long key, digest;
+        if (sscanf(line, "GEMMINI_GOLDEN(%llx, %llx)", &key, &digest) != 2)
+            continue;
+
+        if (golden_n_entries == GOLDEN_MAX_ENTRIES)
+            ok = false;
+        else
+            golden_entries[golden_n_entries++] = (struct golden_entry) {key, digest};
+    }
+
+    fclose(file);
+
+    if (!ok)
+        printf("Couldn't load the golden cache %s\n", path);
+
+    return ok;
+}
+
+static bool golden_save(const char * path)
+{
+    FILE * file = fopen(path, "w");
+    if (file == NULL) {
+        perror("Couldn't create the golden cache");
+        return false;
+    }
+
+    for (size_t i = 0; i < golden_n_entries; i++)
+        fprintf(file, GOLDEN_FORMAT, (unsigned long long)golden_entries[i].key, (unsigned long long)golden_entries[i].digest);
+
+    const bool ok = fclose(file) == 0;
+    if (!ok)
+        perror("Couldn't write the golden cache");
+
+    return ok;
+}
+#endif
+
+// The activation that a matmul which is going to be checked runs with. The
+// checksums need the outputs from before a ReLU, but the other checks don't.
+static int tiled_matmul_nn_check_act(int act, bool verify)
+{
+    return verify && !GEMMINI_VERIFY_RECOMPUTE && !golden_enabled && act == RELU ? NO_ACTIVATION : act;
+}
+
+// Checks a matmul that ran with tiled_matmul_nn_check_act(act, true), and
+// applies the rest of act. Exits if the matmul is wrong.
+static void tiled_matmul_nn_check(size_t dim_I, size_t dim_J, size_t dim_K,
+        const elem_t * A, const elem_t * B, const acc_t * D, elem_t * C,
+        int act, size_t shift, size_t relu6_shift, bool repeating_bias,
+        bool check, const char * layer_name)
+{
+    const int gemmini_act = tiled_matmul_nn_check_act(act, true);
+
+    if (check)
+        printf("%s: %s\n", layer_name, golden_enabled ? "golden" : GEMMINI_VERIFY_RECOMPUTE ? "CPU" : "checksums");
+
+    bool ok;
+    if (golden_enabled)
+        ok = golden_check(dim_I, dim_J, dim_K, A, B, D, C,
+            act, shift, relu6_shift, repeating_bias, layer_name);
+    else if (GEMMINI_VERIFY_RECOMPUTE)
+        ok = tiled_matmul_nn_recompute(dim_I, dim_J, dim_K, A, B, D, C,
+            act, shift, relu6_shift, repeating_bias, layer_name);
+    else
+        ok = tiled_matmul_nn_verify(dim_I, dim_J, dim_K, A, B, D, C,
+            gemmini_act, shift, relu6_shift, repeating_bias, layer_name);
+
+    if (!ok) {
+        printf("Layer calculated incorrectly: %s\n", layer_name);
+        exit(1);
+    }
+
+    if (gemmini_act != act) {
+        for (size_t i = 0; i < dim_I * dim_J; i++)
+            C[i] = C[i] < 0 ? 0 : C[i];
+    }
+}
+
 // This function runs a tiled matrix multiplication, with explicit tiling
 // factors
 static void tiled_matmul_nn(size_t dim_I, size_t dim_J, size_t dim_K,
@@ -81,6 +529,8 @@ static void tiled_matmul_nn(size_t dim_I, size_t dim_J, size_t dim_K,
         enum tiled_matmul_type_t tiled_matmul_type,
         bool check, char * layer_name)
 {
+    const bool verify = check || GEMMINI_VERIFY_ALL;
+
     if (check)
         printf("%s: gemmini\n", layer_name);
 
@@ -88,25 +538,14 @@ static void tiled_matmul_nn(size_t dim_I, size_t dim_J, size_t dim_K,
         (elem_t*)A, (elem_t*)B, D, (elem_t*)C, 
         dim_K, dim_J, dim_J, dim_J,
         MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
-        act, shift, relu6_shift, repeating_bias,
+        tiled_matmul_nn_check_act(act, verify), shift, relu6_shift, NULL, NULL, repeating_bias,
         tile_I, tile_J, tile_K,
         tiled_matmul_type);
 
-    if (check) {
-        printf("%s: CPU\n", layer_name);
-        elem_t gold[dim_I][dim_J];
-        tiled_matmul_auto(dim_I, dim_J, dim_K,
-            (elem_t*)A, (elem_t*)B, D, (elem_t*)gold, 
-            dim_K, dim_J, dim_J, dim_J,
-            MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
-            act, shift, relu6_shift, repeating_bias,
-            CPU);
-
-        if (!MAT_IS_EQUAL(dim_I, dim_J, C, gold)) {
-            printf("Layer calculated incorrectly: %s\n", layer_name);
-            exit(1);
-        }
-    }
+    if (verify)
+        tiled_matmul_nn_check(dim_I, dim_J, dim_K,
+            (const elem_t*)A, (const elem_t*)B, (const acc_t*)D, (elem_t*)C,
+            act, shift, relu6_shift, repeating_bias, check, layer_name);
 }
 
 // This function runs a tiled matrix multiplication, with automatically
@@ -118,6 +557,8 @@ static void tiled_matmul_nn_auto(size_t dim_I, size_t dim_J, size_t dim_K,
         enum tiled_matmul_type_t tiled_matmul_type,
         bool check, char * layer_name)
 {
+    const bool verify = check || GEMMINI_VERIFY_ALL;
+
     if (check)
         printf("%s: gemmini\n", layer_name);
 
@@ -125,81 +566,647 @@ static void tiled_matmul_nn_auto(size_t dim_I, size_t dim_J, size_t dim_K,
         (elem_t*)A, (elem_t*)B, D, (elem_t*)C, 
         dim_K, dim_J, dim_J, dim_J,
         MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
-        act, shift, relu6_shift, repeating_bias,
+        tiled_matmul_nn_check_act(act, verify), shift, relu6_shift, NULL, NULL, repeating_bias,
         tiled_matmul_type);
 
-    if (check) {
-        printf("%s: CPU\n", layer_name);
-        elem_t gold[dim_I][dim_J];
-        tiled_matmul_auto(dim_I, dim_J, dim_K,
-            (elem_t*)A, (elem_t*)B, D, (elem_t*)gold, 
-            dim_K, dim_J, dim_J, dim_J,
+    if (verify)
+        tiled_matmul_nn_check(dim_I, dim_J, dim_K,
+            (const elem_t*)A, (const elem_t*)B, (const acc_t*)D, (elem_t*)C,
+            act, shift, relu6_shift, repeating_bias, check, layer_name);
+}
+
+// Multi-layer perceptrons
+//
+// An MLP is a chain of matmuls, each of which reads the last one's output as
+// its A. With a small batch, the activations are tiny next to the weights, so
+// tiled_mlp_nn() runs every WS layer whose activations fit in the scratchpad
+// with tiled_matmul_panel_ws(), which moves them in once and only streams the
+// weights. Gemmini can only move results out of the accumulator to memory, so
+// each layer's output still makes one trip through the cache on its way to the
+// next layer, but only one, rather than one for each tile of weights. Other
+// layers run with tiled_matmul_nn_auto().
+struct MlpLayer {
+    char * name;
+    size_t out_features;
+    const elem_t * weights; // [in_features][out_features]
+    const acc_t * bias;     // [out_features], or NULL
+    elem_t * output;        // [batch_size][out_features]
+    int act;
+    size_t shift;
+};
+
+// Runs layers [0, n_layers) on input, a [batch_size][in_features] matrix, and
+// stores how many cycles each layer took in cycles, unless it's NULL
+static void tiled_mlp_nn(size_t batch_size, size_t in_features, const elem_t * input,
+        const struct MlpLayer * layers, size_t n_layers,
+        enum tiled_matmul_type_t tiled_matmul_type, bool check,
+        uint64_t * cycles)
+{
+    const bool verify = check || GEMMINI_VERIFY_ALL;
+
+    const elem_t * A = input;
+    size_t K = in_features;
+
+    for (size_t l = 0; l < n_layers; l++) {
+        const struct MlpLayer * layer = &layers[l];
+        const size_t J = layer->out_features;
+        size_t tile_J;
+
+        const uint64_t start = read_cycles();
+
+        if (tiled_matmul_type == WS && tiled_matmul_panel_fits(batch_size, J, K, &tile_J)) {
+            if (check)
+                printf("%s: gemmini\n", layer->name);
+
+            tiled_matmul_panel_ws(batch_size, J, K,
+                A, layer->weights, layer->bias, layer->output, K,
+                tiled_matmul_nn_check_act(layer->act, verify), layer->shift, 0, true);
+
+            if (verify)
+                tiled_matmul_nn_check(batch_size, J, K,
+                    A, layer->weights, layer->bias, layer->output,
+                    layer->act, layer->shift, 0, true, check, layer->name);
+        } else {
+            tiled_matmul_nn_auto(batch_size, J, K,
+                (const elem_t (*)[K]) A, (const elem_t (*)[J]) layer->weights, layer->bias, (elem_t (*)[J]) layer->output,
+                layer->act, layer->shift, 0, true,
+                tiled_matmul_type, check, layer->name);
+        }
+
+        const uint64_t end = read_cycles();
+        if (cycles != NULL)
+            cycles[l] = end - start;
+
+        A = layer->output;
+        K = J;
+    }
+}
+
+// Transformer encoders
+//
+// A BERT-style encoder layer runs its QKV projection, the QK^T and AV matmuls
+// of every attention head, its output projection and its feed-forward network
+// on Gemmini, and its softmaxes and layernorms on the CPU, with the
+// integer-only kernels below. Gemmini's matmuls can't transpose B, so K is
+// transposed on the CPU, one sequence at a time, before the heads' QK^T
+// matmuls read it. The feed-forward network uses a ReLU, which Gemmini
+// applies for free, instead of BERT's GELU.
+#ifndef ELEM_T_IS_FLOAT
+
+// softmax_cpu() reads logits in units of 2^-SOFTMAX_IN_FRAC_BITS. Each row's
+// maximum is subtracted first, so every exponent is e^(-d/16) for some d in
+// [0, 255], which softmax_exp_lut holds in Q15. One 64-bit reciprocal of each
+// row's sum turns those into probabilities, in units of 2^-SOFTMAX_OUT_FRAC_BITS,
+// where 1.0 saturates to elem_t_max.
+#define SOFTMAX_IN_FRAC_BITS 4
+#define SOFTMAX_OUT_FRAC_BITS 7
+#define SOFTMAX_LUT_SIZE 176
+
+// round(2^15 * e^(-d/16)), which is less than 2 from here on
+static const uint16_t softmax_exp_lut[SOFTMAX_LUT_SIZE] = {
+    32768, 30783, 28918, 27166, 25520, 23974, 22521, 21157,
+    19875, 18671, 17539, 16477, 15479, 14541, 13660, 12832,
+    12055, 11324, 10638,  9994,  9388,  8819,  8285,  7783,
+     7312,  6869,  6452,  6061,  5694,  5349,  5025,  4721,
+     4435,  4166,  3914,  3676,  3454,  3244,  3048,  2863,
+     2690,  2527,  2374,  2230,  2095,  1968,  1849,  1737,
+     1631,  1533,  1440,  1352,  1271,  1194,  1121,  1053,
+      990,   930,   873,   820,   771,   724,   680,   639,
+      600,   564,   530,   498,   467,   439,   412,   387,
+      364,   342,   321,   302,   283,   266,   250,   235,
+      221,   207,   195,   183,   172,   162,   152,   143,
+      134,   126,   118,   111,   104,    98,    92,    86,
+       81,    76,    72,    67,    63,    59,    56,    52,
+       49,    46,    43,    41,    38,    36,    34,    32,
+       30,    28,    26,    25,    23,    22,    21,    19,
+       18,    17,    16,    15,    14,    13,    12,    12,
+       11,    10,    10,     9,     9,     8,     8,     7,
+        7,     6,     6,     6,     5,     5,     5,     4,
+        4,     4,     4,     3,     3,     3,     3,     3,
+        2,     2,     2,     2,     2,     2,     2,     2,
+        1,     1,     1,     1,     1,     1,     1,     1,
+        1,     1,     1,     1,     1,     1,     1,     1,
+};
+
+static inline uint32_t softmax_exp(int d)
+{
+    return d < SOFTMAX_LUT_SIZE ? softmax_exp_lut[d] : 0;
+}
+
+struct softmax_args {
+    size_t cols;
+    const elem_t * input;
+    size_t stride_in;
+    elem_t * output;
+    size_t stride_out;
+};
+
+// Computes rows [start, end) of a softmax
+static void softmax_task(void * args_, size_t start, size_t end, size_t thread_id)
+{
+    const struct softmax_args * args = (const struct softmax_args *)args_;
+    const size_t cols = args->cols;
+
+    for (size_t r = start; r < end; r++) {
+        const elem_t * x = args->input + r * args->stride_in;
+        elem_t * y = args->output + r * args->stride_out;
+
+        int max = elem_t_min;
+        for (size_t c = 0; c < cols; c++)
+            max = x[c] > max ? x[c] : max;
+
+        // At least 2^15, from the maximum itself
+        uint32_t sum = 0;
+        for (size_t c = 0; c < cols; c++)
+            sum += softmax_exp(max - x[c]);
+
+        const int shift = 47 - SOFTMAX_OUT_FRAC_BITS;
+        const uint64_t recip = ((uint64_t)1 << 47) / sum;
+
+        for (size_t c = 0; c < cols; c++) {
+            const uint64_t p = (softmax_exp(max - x[c]) * recip + ((uint64_t)1 << (shift - 1))) >> shift;
+            y[c] = p > elem_t_max ? elem_t_max : p;
+        }
+    }
+}
+
+// Computes the softmax of every row of input. output may be input.
+static void softmax_cpu(size_t rows, size_t cols,
+        const elem_t * input, size_t stride_in,
+        elem_t * output, size_t stride_out)
+{
+    struct softmax_args args = {
+        .cols = cols,
+        .input = input, .stride_in = stride_in,
+        .output = output, .stride_out = stride_out,
+    };
+
+    gemmini_parallel_for(rows, 16, softmax_task, &args);
+}
+
+// layernorm_cpu() normalizes each row x to z = (x - mean) / std, in units of
+// 2^-LAYERNORM_FRAC_BITS, and writes (z * gamma + beta) >> shift, rounded and
+// saturated like scale_and_sat. So that the mean doesn't have to be rounded,
+// it works with d = n*x - sum(x) instead of x - mean, whose root mean square
+// is n*std, and divides by that with one fixed-point reciprocal per row.
+#define LAYERNORM_FRAC_BITS 8
+#define LAYERNORM_RECIP_BITS 24
+
+// floor(sqrt(x))
+static uint64_t layernorm_isqrt(uint64_t x)
+{
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > x)
+        bit >>= 2;
+
+    for (; bit != 0; bit >>= 2) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+
+    return root;
+}
+
+struct layernorm_args {
+    size_t cols;
+    const elem_t * input;
+    size_t stride_in;
+    const elem_t * gamma;
+    const acc_t * beta;
+    elem_t * output;
+    size_t stride_out;
+    size_t shift;
+};
+
+// Computes rows [start, end) of a layernorm
+static void layernorm_task(void * args_, size_t start, size_t end, size_t thread_id)
+{
+    const struct layernorm_args * args = (const struct layernorm_args *)args_;
+    const int64_t n = args->cols;
+
+    for (size_t r = start; r < end; r++) {
+        const elem_t * x = args->input + r * args->stride_in;
+        elem_t * y = args->output + r * args->stride_out;
+
+        int64_t sum = 0;
+        for (int64_t c = 0; c < n; c++)
+            sum += x[c];
+
+        uint64_t squares = 0;
+        for (int64_t c = 0; c < n; c++) {
+            const int64_t d = n * x[c] - sum;
+            squares += d * d;
+        }
+
+        // A constant row normalizes to all zeros
+        const int64_t std_n = layernorm_isqrt(squares / n);
+        const int64_t recip = std_n == 0 ? 0 :
+            ((int64_t)1 << (LAYERNORM_FRAC_BITS + LAYERNORM_RECIP_BITS)) / std_n;
+
+        for (int64_t c = 0; c < n; c++) {
+            const int64_t z = ROUNDING_RIGHT_SHIFT((n * x[c] - sum) * recip, LAYERNORM_RECIP_BITS);
+            const acc_t result = z * args->gamma[c] + (args->beta != NULL ? args->beta[c] : 0);
+            y[c] = scale_and_sat(result, NO_ACTIVATION, args->shift, 0);
+        }
+    }
+}
+
+// Normalizes every row of input. gamma and beta have one element per column,
+// and beta may be NULL. output may be input.
+static void layernorm_cpu(size_t rows, size_t cols,
+        const elem_t * input, size_t stride_in,
+        const elem_t * gamma, const acc_t * beta,
+        elem_t * output, size_t stride_out, size_t shift)
+{
+    struct layernorm_args args = {
+        .cols = cols,
+        .input = input, .stride_in = stride_in,
+        .gamma = gamma, .beta = beta,
+        .output = output, .stride_out = stride_out,
+        .shift = shift,
+    };
+
+    gemmini_parallel_for(rows, 4, layernorm_task, &args);
+}
+
+// The weights are stored [in_features][out_features], like an MlpLayer's. Every
+// bias may be NULL. Q's projection has to be scaled so that the logits come
+// out of QK^T in units of 2^-SOFTMAX_IN_FRAC_BITS after qk_shift, which is also
+// where the 1/sqrt(head_dim) of scaled dot-product attention goes. AV is
+// shifted right by SOFTMAX_OUT_FRAC_BITS, so the context has the scale of V.
+struct EncoderLayer {
+    char * name;
+    const elem_t * qkv_weights;  // [hidden][3*hidden], Q's columns, then K's, then V's
+    const acc_t * qkv_bias;      // [3*hidden]
+    const elem_t * out_weights;  // [hidden][hidden]
+    const acc_t * out_bias;      // [hidden]
+    const elem_t * ln1_gamma;    // [hidden]
+    const acc_t * ln1_beta;      // [hidden]
+    const elem_t * ffn1_weights; // [hidden][ffn]
+    const acc_t * ffn1_bias;     // [ffn]
+    const elem_t * ffn2_weights; // [ffn][hidden]
+    const acc_t * ffn2_bias;     // [hidden]
+    const elem_t * ln2_gamma;    // [hidden]
+    const acc_t * ln2_beta;      // [hidden]
+    elem_t * output;             // [batch_size*seq_len][hidden]
+    size_t qkv_shift, qk_shift, out_shift, ffn1_shift, ffn2_shift, ln_shift;
+};
+
+struct EncoderCycles {
+    uint64_t qkv, qk, softmax, av, out, res_add, layernorm, ffn;
+};
+
+// How many elements of scratch space tiled_encoder_nn() needs
+#define ENCODER_SCRATCH_ELEMS(batch_size, seq_len, hidden, ffn) \
+    ((size_t)(batch_size) * (seq_len) * (5*(hidden) + (ffn)) + \
+        (size_t)(seq_len) * ((hidden) + (seq_len)))
+
+// Runs layers [0, n_layers) on input, batch_size sequences of seq_len tokens
+// each, stored as a [batch_size*seq_len][hidden] matrix, and adds how many
+// cycles each kind of op took to cycles, unless it's NULL
+static void tiled_encoder_nn(size_t batch_size, size_t seq_len,
+        size_t hidden, size_t heads, size_t ffn,
+        const elem_t * input,
+        const struct EncoderLayer * layers, size_t n_layers,
+        elem_t * scratch,
+        enum tiled_matmul_type_t tiled_matmul_type,
+        struct EncoderCycles * cycles)
+{
+    const size_t tokens = batch_size * seq_len;
+    const size_t head_dim = hidden / heads;
+
+    elem_t * qkv = scratch;                            // [tokens][3*hidden]
+    elem_t * context = qkv + tokens*3*hidden;          // [tokens][hidden]
+    elem_t * attention = context + tokens*hidden;      // [tokens][hidden]
+    elem_t * hidden_ffn = attention + tokens*hidden;   // [tokens][ffn]
+    elem_t * k_t = hidden_ffn + tokens*ffn;            // [hidden][seq_len]
+    elem_t * scores = k_t + hidden*seq_len;            // [seq_len][seq_len]
+
+    // Layernorm 1's output, and the feed-forward network's, reuse context
+    elem_t * normalized = attention;
+    elem_t * ffn_out = context;
+
+    struct EncoderCycles unused = {0};
+    if (cycles == NULL)
+        cycles = &unused;
+
+    const elem_t * x = input;
+
+    for (size_t l = 0; l < n_layers; l++) {
+        const struct EncoderLayer * layer = &layers[l];
+        uint64_t start, end;
+
+        start = read_cycles();
+
+        tiled_matmul_auto(tokens, 3*hidden, hidden,
+            x, layer->qkv_weights, layer->qkv_bias, qkv,
+            hidden, 3*hidden, 3*hidden, 3*hidden,
             MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
-            act, shift, relu6_shift, repeating_bias,
-            CPU);
+            NO_ACTIVATION, layer->qkv_shift, 0, NULL, NULL, true,
+            tiled_matmul_type);
+
+        end = read_cycles();
+        cycles->qkv += end - start;
+
+        for (size_t b = 0; b < batch_size; b++) {
+            const elem_t * q = qkv + b*seq_len*3*hidden;
+            const elem_t * k = q + hidden;
+            const elem_t * v = q + 2*hidden;
+
+            start = read_cycles();
+
+            for (size_t t = 0; t < seq_len; t++)
+                for (size_t c = 0; c < hidden; c++)
+                    k_t[c*seq_len + t] = k[t*3*hidden + c];
+
+            end = read_cycles();
+            cycles->qk += end - start;
+
+            for (size_t h = 0; h < heads; h++) {
+                start = read_cycles();
+
+                tiled_matmul_auto(seq_len, seq_len, head_dim,
+                    q + h*head_dim, k_t + h*head_dim*seq_len, NULL, scores,
+                    3*hidden, seq_len, 0, seq_len,
+                    MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+                    NO_ACTIVATION, layer->qk_shift, 0, NULL, NULL, false,
+                    tiled_matmul_type);
+
+                end = read_cycles();
+                cycles->qk += end - start;
+
+                start = read_cycles();
+                softmax_cpu(seq_len, seq_len, scores, seq_len, scores, seq_len);
+                end = read_cycles();
+                cycles->softmax += end - start;
+
+                start = read_cycles();
 
-        if (!MAT_IS_EQUAL(dim_I, dim_J, C, gold)) {
-            printf("Layer calculated incorrectly: %s\n", layer_name);
-            exit(1);
+                tiled_matmul_auto(seq_len, head_dim, seq_len,
+                    scores, v + h*head_dim, NULL, context + b*seq_len*hidden + h*head_dim,
+                    seq_len, 3*hidden, 0, hidden,
+                    MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+                    NO_ACTIVATION, SOFTMAX_OUT_FRAC_BITS, 0, NULL, NULL, false,
+                    tiled_matmul_type);
+
+                end = read_cycles();
+                cycles->av += end - start;
+            }
         }
+
+        start = read_cycles();
+
+        tiled_matmul_auto(tokens, hidden, hidden,
+            context, layer->out_weights, layer->out_bias, attention,
+            hidden, hidden, hidden, hidden,
+            MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+            NO_ACTIVATION, layer->out_shift, 0, NULL, NULL, true,
+            tiled_matmul_type);
+
+        end = read_cycles();
+        cycles->out += end - start;
+
+        start = read_cycles();
+        resadd_cpu_strided(tokens, hidden, 0, x, hidden, attention, hidden, attention, hidden, false);
+        end = read_cycles();
+        cycles->res_add += end - start;
+
+        start = read_cycles();
+        layernorm_cpu(tokens, hidden, attention, hidden, layer->ln1_gamma, layer->ln1_beta,
+            normalized, hidden, layer->ln_shift);
+        end = read_cycles();
+        cycles->layernorm += end - start;
+
+        start = read_cycles();
+
+        tiled_matmul_auto(tokens, ffn, hidden,
+            normalized, layer->ffn1_weights, layer->ffn1_bias, hidden_ffn,
+            hidden, ffn, ffn, ffn,
+            MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+            RELU, layer->ffn1_shift, 0, NULL, NULL, true,
+            tiled_matmul_type);
+
+        tiled_matmul_auto(tokens, hidden, ffn,
+            hidden_ffn, layer->ffn2_weights, layer->ffn2_bias, ffn_out,
+            ffn, hidden, hidden, hidden,
+            MVIN_SCALE_ONE, MVIN_SCALE_ONE, MVIN_SCALE_ONE,
+            NO_ACTIVATION, layer->ffn2_shift, 0, NULL, NULL, true,
+            tiled_matmul_type);
+
+        end = read_cycles();
+        cycles->ffn += end - start;
+
+        start = read_cycles();
+        resadd_cpu_strided(tokens, hidden, 0, normalized, hidden, ffn_out, hidden, ffn_out, hidden, false);
+        end = read_cycles();
+        cycles->res_add += end - start;
+
+        start = read_cycles();
+        layernorm_cpu(tokens, hidden, ffn_out, hidden, layer->ln2_gamma, layer->ln2_beta,
+            layer->output, hidden, layer->ln_shift);
+        end = read_cycles();
+        cycles->layernorm += end - start;
+
+        x = layer->output;
     }
 }
 
-static void conv_dw(size_t I, size_t J,
-    const size_t batch_size, const size_t channels, const size_t in_dim, const size_t out_dim, const size_t kernel_size,
-    const elem_t input[batch_size][in_dim][in_dim][channels],
-    const elem_t weight[channels][kernel_size][kernel_size],
-    const acc_t * bias,
-    // elem_t output [batch_size][out_dim][out_dim][channels],
-    elem_t output [I][J],
-    const struct ConvParams * params)
+#endif // ELEM_T_IS_FLOAT
+
+// Depthwise convolution
+//
+// The kernel keeps channels innermost. The weights are repacked once per call
+// into [kernel_row][kernel_col][channel] order, so that every tap is a
+// multiply-accumulate of two contiguous channel vectors. For each output row,
+// the kernel_size input rows it needs are reused across all the output
+// columns. Layers whose weights don't fit in CONV_DW_WEIGHT_PACK_ELEMS are
+// computed in groups of channels.
+#define CONV_DW_CB 64
+#define CONV_DW_WEIGHT_PACK_ELEMS (16 * 1024)
+
+static elem_t conv_dw_packed_weights[CONV_DW_WEIGHT_PACK_ELEMS];
+
+struct conv_dw_args {
+    size_t J, in_J;
+    size_t batch_size, channels, out_dim, kernel_size;
+    const elem_t * input;
+    const elem_t * weight;
+    const acc_t * bias;
+    elem_t * output;
+    const struct ConvParams * params;
+
+    // The group of channels whose weights are currently packed
+    size_t ch_group0, ch_group_size;
+
+    // The output only holds the rows from row0 on, and the rows that tasks
+    // are given are counted from row0
+    size_t row0;
+};
+
+static inline void conv_dw_accumulate(acc_t * result, const elem_t * input, const elem_t * weight, size_t n)
 {
-    for (int batch = 0; batch < batch_size; batch++) {
-        for (int channel = 0; channel < channels; channel++) {
-            for (int out_row = 0; out_row < out_dim; out_row++) {
-                for (int out_col = 0; out_col < out_dim; out_col++) {
-                    int in_row = out_row * params->stride - params->padding;
+    for (size_t c = 0; c < n; c++)
+        result[c] += input[c] * weight[c];
+}
 
-                    acc_t result = 0;
-                    if (params->bias) {
-                        result = bias[channel];
-                    }
+// Computes output rows [start, end) of a depthwise convolution, counted across
+// the whole batch from args->row0. The input is read as a matrix with in_J
+// columns.
+static void conv_dw_task(void * args_, size_t start, size_t end, size_t thread_id)
+{
+    const struct conv_dw_args * args = (const struct conv_dw_args *)args_;
+    const struct ConvParams * params = args->params;
+    const size_t out_dim = args->out_dim;
+    const size_t ch_group0 = args->ch_group0, ch_group_size = args->ch_group_size;
+
+    const elem_t (* input)[args->in_J] = (const elem_t (*)[args->in_J]) args->input;
+    elem_t (* output)[args->J] = (elem_t (*)[args->J]) args->output;
+
+    for (size_t row = args->row0 + start; row < args->row0 + end; row++) {
+        const int batch = row / out_dim;
+        const int out_row = row % out_dim;
+
+        for (size_t c0 = 0; c0 < ch_group_size; c0 += CONV_DW_CB) {
+            const size_t cb = ch_group_size - c0 < CONV_DW_CB ? ch_group_size - c0 : CONV_DW_CB;
+            const size_t channel0 = ch_group0 + c0;
+
+            for (int out_col = 0; out_col < out_dim; out_col++) {
+                acc_t result[CONV_DW_CB];
+                for (size_t c = 0; c < cb; c++) {
+                    result[c] = params->bias ? args->bias[channel0 + c] : 0;
+                }
+
+                for (int kernel_row = 0; kernel_row < params->kernel_size; kernel_row++) {
+                    const int in_row = out_row * params->stride - params->padding + kernel_row;
+                    if (in_row < 0 || in_row >= params->in_dim)
+                        continue;
 
-                    for (int kernel_row = 0; kernel_row < params->kernel_size; kernel_row++) {
-                        int in_col = out_col * params->stride - params->padding;
+                    for (int kernel_col = 0; kernel_col < params->kernel_size; kernel_col++) {
+                        const int in_col = out_col * params->stride - params->padding + kernel_col;
+                        if (in_col < 0 || in_col >= params->in_dim)
+                            continue;
 
-                        for (int kernel_col = 0; kernel_col < params->kernel_size; kernel_col++) {
-                            if (in_row >= 0 && in_row < params->in_dim && in_col >= 0 && in_col < params->in_dim) {
-                                result += input[batch][in_row][in_col][channel] * weight[channel][kernel_row][kernel_col];
-                            }
+                        size_t r = batch * params->in_dim * params->in_dim + in_row * params->in_dim + in_col;
 
-                            in_col++;
-                        }
+                        const elem_t * weight = conv_dw_packed_weights +
+                            (kernel_row * params->kernel_size + kernel_col) * ch_group_size + c0;
 
-                        in_row++;
+                        conv_dw_accumulate(result, &input[r][channel0], weight, cb);
                     }
+                }
+
+                size_t r = batch * params->out_dim * params->out_dim + out_row * params->out_dim + out_col - args->row0 * out_dim;
+
+                for (size_t c = 0; c < cb; c++) {
+                    acc_t x = result[c];
 
-                    if (result < 0) {
-                        result = 0;
+                    if (x < 0) {
+                        x = 0;
                     }
-                    
-                    acc_t shifted = ROUNDING_RIGHT_SHIFT(result, params->output_scale);
+
+                    acc_t shifted = ROUNDING_RIGHT_SHIFT(x, params->output_scale);
 
                     if (shifted > elem_t_max) {
                         shifted = elem_t_max;
                     } else if (shifted < elem_t_min) {
                         shifted = elem_t_min;
                     }
-                    
-                    size_t r = batch * params->out_dim * params->out_dim + out_row * params->out_dim + out_col;
-                    output[r][channel] = shifted;
-                    // output[batch][out_row][out_col][channel] = shifted;
+
+                    output[r][channel0 + c] = shifted;
                 }
             }
         }
     }
 }
 
+// The largest number of channels whose weights are packed at once
+static size_t conv_dw_group_size(const struct conv_dw_args * args)
+{
+    const size_t taps = args->params->kernel_size * args->params->kernel_size;
+
+    size_t ch_group_size = CONV_DW_WEIGHT_PACK_ELEMS / taps;
+    if (ch_group_size >= CONV_DW_CB)
+        ch_group_size = ch_group_size / CONV_DW_CB * CONV_DW_CB;
+
+    return ch_group_size;
+}
+
+static void conv_dw_pack_weights(struct conv_dw_args * args, size_t ch_group0, size_t ch_group_size)
+{
+    const size_t kernel_size = args->kernel_size;
+    const elem_t (* weight)[kernel_size][kernel_size] = (const elem_t (*)[kernel_size][kernel_size]) args->weight;
+
+    args->ch_group0 = ch_group0;
+    args->ch_group_size = args->channels - ch_group0 < ch_group_size ? args->channels - ch_group0 : ch_group_size;
+
+    for (int kernel_row = 0; kernel_row < args->params->kernel_size; kernel_row++)
+        for (int kernel_col = 0; kernel_col < args->params->kernel_size; kernel_col++)
+            for (size_t c = 0; c < args->ch_group_size; c++)
+                conv_dw_packed_weights[(kernel_row * args->params->kernel_size + kernel_col) * args->ch_group_size + c] =
+                    weight[ch_group0 + c][kernel_row][kernel_col];
+}
+
+static void conv_dw_run(struct conv_dw_args * args)
+{
+    const size_t ch_group_size = conv_dw_group_size(args);
+
+    for (size_t ch_group0 = 0; ch_group0 < args->channels; ch_group0 += ch_group_size) {
+        conv_dw_pack_weights(args, ch_group0, ch_group_size);
+        gemmini_parallel_for(args->batch_size * args->out_dim, 1, conv_dw_task, args);
+    }
+}
+
+// Starts the depthwise conv that args describes on the worker threads, with
+// gemmini_parallel_fork(), so that the calling thread can drive Gemmini in the
+// meantime, and gemmini_parallel_join() finishes it. That only works when the
+// weights of all the channels fit in conv_dw_packed_weights at once, which is
+// what callers check beforehand; otherwise, nothing is started, and false is
+// returned. The weights are only packed when pack is set, so that a conv which
+// is forked once per image packs them once.
+static bool conv_dw_fork(struct conv_dw_args * args, bool pack)
+{
+    if ((size_t)args->channels * args->kernel_size * args->kernel_size > CONV_DW_WEIGHT_PACK_ELEMS)
+        return false;
+
+    if (pack) {
+        conv_dw_pack_weights(args, 0, args->channels);
+    } else {
+        args->ch_group0 = 0;
+        args->ch_group_size = args->channels;
+    }
+
+    gemmini_parallel_fork(args->batch_size * args->out_dim, 1, conv_dw_task, args);
+    return true;
+}
+
+static void conv_dw(size_t I, size_t J,
+    const size_t batch_size, const size_t channels, const size_t in_dim, const size_t out_dim, const size_t kernel_size,
+    const elem_t input[batch_size][in_dim][in_dim][channels],
+    const elem_t weight[channels][kernel_size][kernel_size],
+    const acc_t * bias,
+    // elem_t output [batch_size][out_dim][out_dim][channels],
+    elem_t output [I][J],
+    const struct ConvParams * params)
+{
+    struct conv_dw_args args = {
+        .J = J, .in_J = channels,
+        .batch_size = batch_size, .channels = channels, .out_dim = out_dim, .kernel_size = kernel_size,
+        .input = (const elem_t *) input,
+        .weight = (const elem_t *) weight,
+        .bias = bias,
+        .output = (elem_t *) output,
+        .params = params,
+    };
+
+    conv_dw_run(&args);
+}
+
 static void conv_dw_with_col2im(size_t prev_I, size_t prev_J, size_t I, size_t J,
     const size_t batch_size, const size_t channels, const size_t out_dim, const size_t kernel_size,
     const elem_t input[prev_I][prev_J],
@@ -209,91 +1216,114 @@ static void conv_dw_with_col2im(size_t prev_I, size_t prev_J, size_t I, size_t J
     elem_t output [I][J],
     const struct ConvParams * params)
 {
-    for (int batch = 0; batch < batch_size; batch++) {
-        for (int channel = 0; channel < channels; channel++) {
-            for (int out_row = 0; out_row < out_dim; out_row++) {
-                for (int out_col = 0; out_col < out_dim; out_col++) {
-                    int in_row = out_row * params->stride - params->padding;
+    struct conv_dw_args args = {
+        .J = J, .in_J = prev_J,
+        .batch_size = batch_size, .channels = channels, .out_dim = out_dim, .kernel_size = kernel_size,
+        .input = (const elem_t *) input,
+        .weight = (const elem_t *) weight,
+        .bias = bias,
+        .output = (elem_t *) output,
+        .params = params,
+    };
+
+    conv_dw_run(&args);
+}
 
-                    acc_t result = 0;
-                    if (params->bias) {
-                        result = bias[channel];
-                    }
+struct im2col_args {
+    size_t in_J, K;
+    const elem_t * input;
+    elem_t * output;
+    const struct ConvParams * params;
+};
 
-                    for (int kernel_row = 0; kernel_row < params->kernel_size; kernel_row++) {
-                        int in_col = out_col * params->stride - params->padding;
+// Fills patch rows [start, end) of an im2col matrix. The input is read as a
+// matrix with in_J columns. Each filter row of a patch is copied as whole runs
+// of in_channels, and the parts of the patch that fall into the padding (as
+// well as any columns past the end of the patch) are explicitly zeroed, so the
+// output doesn't need to be cleared beforehand.
+static void im2col_task(void * args_, size_t start, size_t end, size_t thread_id)
+{
+    const struct im2col_args * args = (const struct im2col_args *)args_;
+    const struct ConvParams * params = args->params;
 
-                        for (int kernel_col = 0; kernel_col < params->kernel_size; kernel_col++) {
-                            if (in_row >= 0 && in_row < params->in_dim && in_col >= 0 && in_col < params->in_dim) {
-                                // result += input[batch][in_row][in_col][channel] * weight[channel][kernel_row][kernel_col];
+    const elem_t (* input)[args->in_J] = (const elem_t (*)[args->in_J]) args->input;
+    elem_t (* output)[args->K] = (elem_t (*)[args->K]) args->output;
 
-                                size_t r = batch * params->in_dim * params->in_dim + in_row * params->in_dim + in_col;
+    const int in_dim = params->in_dim, kernel_size = params->kernel_size;
+    const int in_channels = params->in_channels;
+    const int patches_per_row = (in_dim - kernel_size + 2*params->padding) / params->stride + 1;
+    const size_t filter_row_len = kernel_size * in_channels;
+    const size_t patch_len = kernel_size * filter_row_len;
 
-                                result += input[r][channel] * weight[channel][kernel_row][kernel_col];
-                            }
+    // When the input rows aren't padded, neighbouring pixels are contiguous
+    const bool contiguous = args->in_J == in_channels;
 
-                            in_col++;
-                        }
+    for (size_t patch_row = start; patch_row < end; patch_row++) {
+        const int n_batch = patch_row / (patches_per_row * patches_per_row);
+        const int im_row = -params->padding + (patch_row / patches_per_row) % patches_per_row * params->stride;
+        const int im_col = -params->padding + patch_row % patches_per_row * params->stride;
 
-                        in_row++;
-                    }
+        // The filter columns that land inside the image
+        const int filter_col_start = im_col < 0 ? -im_col : 0;
+        const int filter_col_end = im_col + kernel_size > in_dim ? in_dim - im_col : kernel_size;
 
-                    if (result < 0) {
-                        result = 0;
-                    }
-                    
-                    acc_t shifted = ROUNDING_RIGHT_SHIFT(result, params->output_scale);
+        elem_t * out = output[patch_row];
 
-                    if (shifted > elem_t_max) {
-                        shifted = elem_t_max;
-                    } else if (shifted < elem_t_min) {
-                        shifted = elem_t_min;
-                    }
-                    
-                    size_t r = batch * params->out_dim * params->out_dim + out_row * params->out_dim + out_col;
-                    output[r][channel] = shifted;
-                    // output[batch][out_row][out_col][channel] = shifted;
-                }
+        for (int filter_row = 0; filter_row < kernel_size; filter_row++) {
+            const int pixel_row = im_row + filter_row;
+            elem_t * out_row = out + filter_row * filter_row_len;
+
+            if (pixel_row < 0 || pixel_row >= in_dim || filter_col_start >= filter_col_end) {
+                memset(out_row, 0, filter_row_len * sizeof(elem_t));
+                continue;
+            }
+
+            memset(out_row, 0, filter_col_start * in_channels * sizeof(elem_t));
+
+            const int in_row = n_batch * in_dim * in_dim + pixel_row * in_dim + im_col;
+
+            if (contiguous) {
+                memcpy(out_row + filter_col_start * in_channels, input[in_row + filter_col_start],
+                    (filter_col_end - filter_col_start) * in_channels * sizeof(elem_t));
+            } else {
+                for (int filter_col = filter_col_start; filter_col < filter_col_end; filter_col++)
+                    memcpy(out_row + filter_col * in_channels, input[in_row + filter_col],
+                        in_channels * sizeof(elem_t));
             }
+
+            memset(out_row + filter_col_end * in_channels, 0,
+                (kernel_size - filter_col_end) * in_channels * sizeof(elem_t));
         }
+
+        if (args->K > patch_len)
+            memset(out + patch_len, 0, (args->K - patch_len) * sizeof(elem_t));
     }
 }
 
+static void im2col_rows(size_t in_J, size_t K, const elem_t * input, elem_t * output,
+    const struct ConvParams * params)
+{
+    struct im2col_args args = {
+        .in_J = in_J, .K = K,
+        .input = input, .output = output,
+        .params = params,
+    };
+
+    if (params->in_dim + 2*params->padding < params->kernel_size)
+        return;
+
+    const size_t patches_per_row = (params->in_dim - params->kernel_size + 2*params->padding) / params->stride + 1;
+
+    gemmini_parallel_for(params->batch_size * patches_per_row * patches_per_row, 16, im2col_task, &args);
+}
+
 static void im2col(size_t batch_size, size_t channels, size_t im_dim,
     size_t I, size_t K,
     const elem_t input[batch_size][im_dim][im_dim][channels],
     elem_t output[I][K],
     const struct ConvParams * params)
 {
-    int patch_row = 0;
-
-    for (int n_batch = 0; n_batch < params->batch_size; n_batch++) {
-        for (int im_row = -params->padding; im_row < params->in_dim - params->kernel_size + params->padding + 1; im_row += params->stride) {
-            for (int im_col = -params->padding; im_col < params->in_dim - params->kernel_size + params->padding + 1; im_col += params->stride) {
-                int patch_col = 0;
-
-                for (int filter_row = 0; filter_row < params->kernel_size; filter_row++) {
-                    for (int filter_col = 0; filter_col < params->kernel_size; filter_col++) {
-                        for (int im_channel = 0; im_channel < params->in_channels; im_channel++) {
-                            int pixel_row = im_row + filter_row;
-                            int pixel_col = im_col + filter_col;
-                            
-                            if (pixel_row < 0 || pixel_row >= params->in_dim
-                                || pixel_col < 0 || pixel_col >= params->in_dim) {
-                                // output[patch_row][patch_col] = 0;
-                            } else {
-                                output[patch_row][patch_col] = input[n_batch][pixel_row][pixel_col][im_channel];
-                            }
-
-                            patch_col++;
-                        }
-                    }
-                }
-                
-                patch_row++;
-            }
-        }
-    }
+    im2col_rows(channels, K, (const elem_t *) input, (elem_t *) output, params);
 }
 
 static void im2col_with_col2im(size_t prev_I, size_t prev_J,
@@ -302,53 +1332,12 @@ static void im2col_with_col2im(size_t prev_I, size_t prev_J,
     elem_t output[next_I][next_K],
     const struct ConvParams * params)
 {
-    int out_row = 0;
-
-    for (int n_batch = 0; n_batch < params->batch_size; n_batch++) {
-        for (int im_row = -params->padding; im_row < params->in_dim - params->kernel_size + params->padding + 1; im_row += params->stride) {
-            for (int im_col = -params->padding; im_col < params->in_dim - params->kernel_size + params->padding + 1; im_col += params->stride) {
-                int out_col = 0;
-
-                for (int filter_row = 0; filter_row < params->kernel_size; filter_row++) {
-                    for (int filter_col = 0; filter_col < params->kernel_size; filter_col++) {
-                        for (int im_channel = 0; im_channel < params->in_channels; im_channel++) {
-                            int pixel_row = im_row + filter_row;
-                            int pixel_col = im_col + filter_col;
-
-                            if (pixel_row < 0 || pixel_row >= params->in_dim
-                                || pixel_col < 0 || pixel_col >= params->in_dim) {
-                                // output[out_row][out_col] = 0;
-                            } else {
-                                int in_row = n_batch * params->in_dim * params->in_dim + pixel_row * params->in_dim + pixel_col;
-                                int in_col = im_channel;
-
-                                output[out_row][out_col] = input[in_row][in_col];
-                            }
-
-                            out_col++;
-                        }
-                    }
-                }
-
-                out_row++;
-            }
-        }
-    }
+    im2col_rows(prev_J, next_K, (const elem_t *) input, (elem_t *) output, params);
 }
 
 // Compute C = A + B with saturating add
 void vecadd(size_t len, const elem_t * A, const elem_t * B, elem_t * C, int A_shift) {
-    for (size_t i = 0; i < len; i++) {
-        acc_t result = ROUNDING_RIGHT_SHIFT(A[i], A_shift) + B[i];
-
-        if (result > elem_t_max) {
-            result = elem_t_max;
-        } else if (result < elem_t_min) {
-            result = elem_t_min;
-        }
-
-        C[i] = result;
-    }
+    resadd_cpu_strided(1, len, A_shift, A, len, B, len, C, len, false);
 }
 
 void resadd1(const size_t batch_size, const size_t channels, const size_t im_dim,
@@ -358,23 +1347,13 @@ void resadd1(const size_t batch_size, const size_t channels, const size_t im_dim
     bool relu,
     const struct ConvParams * params) {
 
-    const int minimum = relu ? 0 : elem_t_min;
-
     for (size_t batch = 0; batch < params->batch_size; batch++) {
         for (size_t row = 0; row < params->out_dim_pooled; row++) {
-            for (size_t col = 0; col < params->out_dim_pooled; col++) {
-                for (size_t channel = 0; channel < params->out_channels; channel++) {
-                    acc_t result = ROUNDING_RIGHT_SHIFT(A[batch][row][col][channel], params->res_scale) + B[batch][row][col][channel];
-
-                    if (result > elem_t_max) {
-                        result = elem_t_max;
-                    } else if (result < minimum) {
-                        result = minimum;
-                    }
-
-                    C[batch][row][col][channel] = result;
-                }
-            }
+            resadd_cpu_strided(params->out_dim_pooled, params->out_channels, params->res_scale,
+                A[batch][row][0], channels,
+                B[batch][row][0], channels,
+                C[batch][row][0], channels,
+                relu);
         }
     }
 }
@@ -387,25 +1366,15 @@ void resadd2(const size_t I, const size_t J,
     bool relu,
     const struct ConvParams * params) {
 
-    const int minimum = relu ? 0 : elem_t_min;
-
     for (size_t batch = 0; batch < params->batch_size; batch++) {
         for (size_t row = 0; row < params->out_dim_pooled; row++) {
-            for (size_t col = 0; col < params->out_dim_pooled; col++) {
-                for (size_t channel = 0; channel < params->out_channels; channel++) {
-                    size_t r = batch * params->out_dim_pooled * params->out_dim_pooled + row * params->out_dim_pooled + col;
-
-                    acc_t result = ROUNDING_RIGHT_SHIFT(A[r][channel], params->res_scale) + B[batch][row][col][channel];
+            size_t r = batch * params->out_dim_pooled * params->out_dim_pooled + row * params->out_dim_pooled;
 
-                    if (result > elem_t_max) {
-                        result = elem_t_max;
-                    } else if (result < minimum) {
-                        result = minimum;
-                    }
-
-                    C[batch][row][col][channel] = result;
-                }
-            }
+            resadd_cpu_strided(params->out_dim_pooled, params->out_channels, params->res_scale,
+                A[r], J,
+                B[batch][row][0], channels,
+                C[batch][row][0], channels,
+                relu);
         }
     }
 }
@@ -417,115 +1386,210 @@ void resadd3(const size_t I, const size_t J,
     bool relu,
     const struct ConvParams * params) {
 
-    const int minimum = relu ? 0 : elem_t_min;
+    const size_t rows = params->batch_size * params->out_dim_pooled * params->out_dim_pooled;
 
-    for (size_t batch = 0; batch < params->batch_size; batch++) {
-        for (size_t row = 0; row < params->out_dim_pooled; row++) {
-            for (size_t col = 0; col < params->out_dim_pooled; col++) {
-                for (size_t channel = 0; channel < params->out_channels; channel++) {
-                    size_t r = batch * params->out_dim_pooled * params->out_dim_pooled + row * params->out_dim_pooled + col;
+    resadd_cpu_strided(rows, params->out_channels, params->res_scale,
+        A[0], J,
+        B[0], J,
+        C[0], J,
+        relu);
+}
 
-                    acc_t result = ROUNDING_RIGHT_SHIFT(A[r][channel], params->res_scale) + B[r][channel];
+// Pooling
+//
+// Max-pooling is done in two separable passes, with channels innermost. The
+// row pass takes the max over the pool window's columns for each input row,
+// and keeps the last pool_size of those rows in a per-thread band. The column
+// pass then takes the max over the band's rows. Padding counts as a zero in
+// both passes, exactly like it does for the accelerator's pooling. If the
+// band for all channels doesn't fit in POOL_BAND_ELEMS, the channels are
+// processed in slices.
+#define POOL_BAND_ELEMS (32 * 1024)
+
+static elem_t pool_band[GEMMINI_MAX_THREADS][POOL_BAND_ELEMS];
+
+struct pool_args {
+    size_t in_J;
+    size_t channels, in_dim, out_dim;
+    const elem_t * input;
+    elem_t * output;
+    const struct ConvParams * params;
+    size_t rows_per_task;
+};
 
-                    if (result > elem_t_max) {
-                        result = elem_t_max;
-                    } else if (result < minimum) {
-                        result = minimum;
-                    }
+static inline void pool_fill(elem_t * dst, elem_t x, size_t n)
+{
+    for (size_t c = 0; c < n; c++)
+        dst[c] = x;
+}
 
-                    C[r][channel] = result;
-                }
-            }
-        }
-    }
+// Sets dst to the max of dst and src, over n channels. The fixed-width inner
+// loop, and the restrict pointers, let the compiler vectorize this at -O2.
+static inline void pool_max(elem_t * restrict dst, const elem_t * restrict src, size_t n)
+{
+    size_t c = 0;
+
+    for (; c + 16 <= n; c += 16)
+        for (size_t i = 0; i < 16; i++)
+            dst[c + i] = src[c + i] > dst[c + i] ? src[c + i] : dst[c + i];
+
+    for (; c < n; c++)
+        dst[c] = src[c] > dst[c] ? src[c] : dst[c];
 }
 
-// Pooling
-void pool(size_t batch_size, size_t channels, size_t in_dim, size_t out_dim,
-    elem_t input[batch_size][in_dim][in_dim][channels],
-    elem_t output[batch_size][out_dim][out_dim][channels],
-    const struct ConvParams * params)
+// Computes output rows [start, end) of a max-pool, where every index covers
+// rows_per_task consecutive output rows of one image. The input is read as a
+// matrix with in_J columns.
+static void pool_task(void * args_, size_t start, size_t end, size_t thread_id)
 {
-    size_t kernel_size = params->pool_size;
-    size_t stride = params->pool_stride;
-    // size_t in_dim = params->out_dim;
-    size_t padding = params->pool_padding;
+    const struct pool_args * args = (const struct pool_args *)args_;
+    const struct ConvParams * params = args->params;
 
-    for (int batch = 0; batch < batch_size; batch++) {
-        for (int channel = 0; channel < channels; channel++) {
-            for (int out_row = 0; out_row < out_dim; out_row++) {
-                for (int out_col = 0; out_col < out_dim; out_col++) {
-                    int in_row = out_row * stride - padding;
+    const int kernel_size = params->pool_size;
+    const int stride = params->pool_stride;
+    const int padding = params->pool_padding;
+    const int channels = args->channels, in_dim = args->in_dim, out_dim = args->out_dim;
+    const int tasks_per_image = (out_dim + args->rows_per_task - 1) / args->rows_per_task;
+
+    const elem_t (* input)[args->in_J] = (const elem_t (*)[args->in_J]) args->input;
+    elem_t (* output)[channels] = (elem_t (*)[channels]) args->output;
+
+    elem_t * band = pool_band[thread_id];
+
+    int slice = POOL_BAND_ELEMS / (kernel_size * out_dim);
+    if (slice > channels)
+        slice = channels;
+
+    for (size_t task = start; task < end; task++) {
+        const int batch = task / tasks_per_image;
+        const int out_row_start = (task % tasks_per_image) * args->rows_per_task;
+        const int out_row_end = out_row_start + args->rows_per_task < out_dim ?
+            out_row_start + args->rows_per_task : out_dim;
+
+        for (int c0 = 0; c0 < channels; c0 += slice) {
+            const int cs = channels - c0 < slice ? channels - c0 : slice;
+
+            // The next input row which hasn't been reduced into the band yet
+            int next_in_row = INT_MIN;
 
-                    elem_t result = elem_t_min;
+            for (int out_row = out_row_start; out_row < out_row_end; out_row++) {
+                const int in_row0 = out_row * stride - padding;
+                const int in_row_end = in_row0 + kernel_size < in_dim ? in_row0 + kernel_size : in_dim;
 
-                    for (int kernel_row = 0; kernel_row < kernel_size; kernel_row++) {
-                        int in_col = out_col * stride - padding;
+                // Row pass
+                for (int in_row = in_row0 > next_in_row ? in_row0 : next_in_row; in_row < in_row_end; in_row++) {
+                    if (in_row < 0)
+                        continue;
 
-                        for (int kernel_col = 0; kernel_col < kernel_size; kernel_col++) {
-                            if (in_row >= 0 && in_row < in_dim && in_col >= 0 && in_col < in_dim) {
-                                if (input[batch][in_row][in_col][channel] > result) {
-                                    result = input[batch][in_row][in_col][channel];
-                                }
-                            } else if (0 > result) {
-                                result = 0;
-                            }
+                    elem_t * band_row = band + (size_t)(in_row % kernel_size) * out_dim * cs;
 
-                            in_col++;
-                        }
+                    for (int out_col = 0; out_col < out_dim; out_col++) {
+                        const int in_col0 = out_col * stride - padding;
+                        const int in_col_start = in_col0 > 0 ? in_col0 : 0;
+                        const int in_col_end = in_col0 + kernel_size < in_dim ? in_col0 + kernel_size : in_dim;
+                        const bool padded = in_col0 < 0 || in_col0 + kernel_size > in_dim;
 
-                        in_row++;
+                        elem_t * result = band_row + out_col * cs;
+                        pool_fill(result, padded ? 0 : elem_t_min, cs);
+
+                        for (int in_col = in_col_start; in_col < in_col_end; in_col++)
+                            pool_max(result, &input[batch * in_dim * in_dim + in_row * in_dim + in_col][c0], cs);
                     }
-                    
-                    output[batch][out_row][out_col][channel] = result;
+                }
+                if (in_row_end > next_in_row)
+                    next_in_row = in_row_end;
+
+                // Column pass
+                const bool padded = in_row0 < 0 || in_row0 + kernel_size > in_dim;
+                const int in_row_start = in_row0 > 0 ? in_row0 : 0;
+
+                for (int out_col = 0; out_col < out_dim; out_col++) {
+                    elem_t * result = &output[batch * out_dim * out_dim + out_row * out_dim + out_col][c0];
+
+                    pool_fill(result, padded ? 0 : elem_t_min, cs);
+
+                    for (int in_row = in_row_start; in_row < in_row_end; in_row++)
+                        pool_max(result, band + ((size_t)(in_row % kernel_size) * out_dim + out_col) * cs, cs);
                 }
             }
         }
     }
 }
 
-void pool_with_col2im(size_t I, size_t J,
-    size_t batch_size, size_t channels, size_t out_dim,
-    elem_t input[I][J],
-    elem_t output[batch_size][out_dim][out_dim][channels],
-    const struct ConvParams * params)
+// Splits the rows of batch_size images between threads, and returns the number
+// of pool_tasks that takes
+static size_t pool_split(struct pool_args * args, size_t batch_size, size_t threads)
 {
-    size_t kernel_size = params->pool_size;
-    size_t stride = params->pool_stride;
-    size_t in_dim = params->out_dim;
-    size_t padding = params->pool_padding;
+    const size_t out_dim = args->out_dim;
 
-    for (int batch = 0; batch < batch_size; batch++) {
-        for (int channel = 0; channel < channels; channel++) {
-            for (int out_row = 0; out_row < out_dim; out_row++) {
-                for (int out_col = 0; out_col < out_dim; out_col++) {
-                    int in_row = out_row * stride - padding;
+#ifdef GEMMINI_ASSERTIONS
+    if (args->params->pool_size * out_dim > POOL_BAND_ELEMS) {
+        printf("%d pooled rows of width %zu do not fit in the CPU pooling band\n",
+            args->params->pool_size, out_dim);
+        exit(1);
+    }
+#endif
 
-                    elem_t result = elem_t_min;
+    // Neighbouring groups of output rows share pool_size - pool_stride input
+    // rows, which get reduced by both groups. So we only split the rows of an
+    // image when there are several threads to split them across.
+    args->rows_per_task = out_dim;
+    if (threads > 1) {
+        args->rows_per_task = (batch_size * out_dim + 2*threads - 1) / (2*threads);
+        if (args->rows_per_task > out_dim)
+            args->rows_per_task = out_dim;
+    }
 
-                    for (int kernel_row = 0; kernel_row < kernel_size; kernel_row++) {
-                        int in_col = out_col * stride - padding;
+    const size_t tasks_per_image = (out_dim + args->rows_per_task - 1) / args->rows_per_task;
+    return batch_size * tasks_per_image;
+}
 
-                        for (int kernel_col = 0; kernel_col < kernel_size; kernel_col++) {
-                            if (in_row >= 0 && in_row < in_dim && in_col >= 0 && in_col < in_dim) {
-                                if (input[batch * in_dim * in_dim + in_row * in_dim + in_col][channel] > result) {
-                                    result = input[batch * in_dim * in_dim + in_row * in_dim + in_col][channel];
-                                }
-                            } else if (0 > result) {
-                                result = 0;
-                            }
+static void pool_run(struct pool_args * args, size_t batch_size)
+{
+    const size_t tasks = pool_split(args, batch_size, gemmini_num_threads());
+    gemmini_parallel_for(tasks, 1, pool_task, args);
+}
 
-                            in_col++;
-                        }
+// Like conv_dw_fork(), starts the pooling that args describes on the worker
+// threads. args must outlive the gemmini_parallel_join() that finishes it.
+static void pool_fork(struct pool_args * args, size_t batch_size)
+{
+    const size_t threads = gemmini_num_threads();
+    const size_t tasks = pool_split(args, batch_size, threads > 1 ? threads - 1 : 1);
+    gemmini_parallel_fork(tasks, 1, pool_task, args);
+}
 
-                        in_row++;
-                    }
+void pool(size_t batch_size, size_t channels, size_t in_dim, size_t out_dim,
+    elem_t input[batch_size][in_dim][in_dim][channels],
+    elem_t output[batch_size][out_dim][out_dim][channels],
+    const struct ConvParams * params)
+{
+    struct pool_args args = {
+        .in_J = channels,
+        .channels = channels, .in_dim = in_dim, .out_dim = out_dim,
+        .input = (const elem_t *) input,
+        .output = (elem_t *) output,
+        .params = params,
+    };
+
+    pool_run(&args, batch_size);
+}
 
-                    output[batch][out_row][out_col][channel] = result;
-                }
-            }
-        }
-    }
+void pool_with_col2im(size_t I, size_t J,
+    size_t batch_size, size_t channels, size_t out_dim,
+    elem_t input[I][J],
+    elem_t output[batch_size][out_dim][out_dim][channels],
+    const struct ConvParams * params)
+{
+    struct pool_args args = {
+        .in_J = J,
+        .channels = channels, .in_dim = params->out_dim, .out_dim = out_dim,
+        .input = (const elem_t *) input,
+        .output = (elem_t *) output,
+        .params = params,
+    };
+
+    pool_run(&args, batch_size);
 }
 
 #endif // GEMMINI_NN_H
@@ -260,16 +260,6 @@ int is_equal_transposed(elem_t x[DIM][DIM], elem_t y[DIM][DIM]) {
         } \
       result;})
 
-uint64_t read_cycles() {
-    uint64_t cycles;
-    asm volatile ("rdcycle %0" : "=r" (cycles));
-    return cycles;
-
-    // const uint32_t * mtime = (uint32_t *)(33554432 + 0xbff8);
-    // const uint32_t * mtime = (uint32_t *)(33554432 + 0xbffc);
-    // return *mtime;
-}
-
 #undef abs
 
 #endif  // SRC_MAIN_C_GEMMINI_TESTUTILS_H
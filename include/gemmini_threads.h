@@ -0,0 +1,293 @@
+// See LICENSE for license details.
+
+#ifndef SRC_MAIN_C_GEMMINI_THREADS_H
+#define SRC_MAIN_C_GEMMINI_THREADS_H
+
+// A small fork-join thread pool for the CPU-side kernels.
+//
+// gemmini_parallel_for(n, grain, task, args) splits [0, n) into chunks of
+// "grain" iterations, which the participating threads take from a shared
+// counter until none are left. The calling thread always participates as
+// thread 0, so task() may index per-thread scratch buffers with thread_id,
+// which is always less than GEMMINI_MAX_THREADS.
+//
+// gemmini_parallel_fork(n, grain, task, args) hands the same kind of work to
+// the worker threads only, and returns right away, so that the calling thread
+// can drive the accelerator in the meantime. gemmini_parallel_join() then
+// helps with whatever is left, and waits for the workers to finish.
+//
+// When MULTITHREAD is not defined, everything runs on the calling thread. On
+// Linux, the workers are pthreads, which are created the first time they are
+// needed. On baremetal, the workers are the harts that crt.S passes into
+// thread_entry(). Harts other than hart 0 wait in thread_entry for work
+// instead of spinning forever.
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef MULTITHREAD
+#ifndef GEMMINI_MAX_THREADS
+#define GEMMINI_MAX_THREADS 8
+#endif
+#else
+#undef GEMMINI_MAX_THREADS
+#define GEMMINI_MAX_THREADS 1
+#endif
+
+#if defined(MULTITHREAD) && !defined(BAREMETAL)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+typedef void (*gemmini_task_t)(void * args, size_t start, size_t end, size_t thread_id);
+
+struct gemmini_pool_job {
+  gemmini_task_t task;
+  void * args;
+  size_t n;
+  size_t grain;
+  size_t next;
+};
+
+static struct gemmini_pool_job gemmini_pool_job;
+static size_t gemmini_pool_requested_threads = GEMMINI_MAX_THREADS;
+static volatile bool gemmini_pool_busy = false;
+static __thread size_t gemmini_pool_thread_id = 0;
+
+static void gemmini_pool_run(struct gemmini_pool_job * job, size_t thread_id) {
+  gemmini_pool_thread_id = thread_id;
+
+  for (;;) {
+    const size_t start = __atomic_fetch_add(&job->next, job->grain, __ATOMIC_RELAXED);
+    if (start >= job->n)
+      break;
+
+    const size_t end = job->n - start < job->grain ? job->n : start + job->grain;
+    job->task(job->args, start, end, thread_id);
+  }
+}
+
+#if defined(MULTITHREAD) && defined(BAREMETAL)
+
+static volatile size_t gemmini_pool_harts = 1;
+static volatile size_t gemmini_pool_generation = 0;
+static volatile size_t gemmini_pool_active = 1;
+static size_t gemmini_pool_done = 0;
+
+// Overrides the weak thread_entry in riscv-tests/benchmarks/common/syscalls.c
+void thread_entry(int cid, int nc) {
+  if (cid == 0) {
+    gemmini_pool_harts = nc < GEMMINI_MAX_THREADS ? nc : GEMMINI_MAX_THREADS;
+    return;
+  }
+
+  if (cid >= GEMMINI_MAX_THREADS)
+    while (1);
+
+  size_t generation = 0;
+
+  while (1) {
+    while (gemmini_pool_generation == generation);
+    generation = gemmini_pool_generation;
+    __sync_synchronize();
+
+    if (cid < gemmini_pool_active) {
+      gemmini_pool_run(&gemmini_pool_job, cid);
+      __atomic_fetch_add(&gemmini_pool_done, 1, __ATOMIC_RELEASE);
+    }
+  }
+}
+
+static size_t gemmini_num_threads() {
+  const size_t harts = gemmini_pool_harts;
+  return gemmini_pool_requested_threads < harts ? gemmini_pool_requested_threads : harts;
+}
+
+static void gemmini_pool_start(size_t threads) {
+  gemmini_pool_active = threads;
+  __atomic_store_n(&gemmini_pool_done, 0, __ATOMIC_RELAXED);
+  __sync_synchronize();
+  gemmini_pool_generation++;
+}
+
+static void gemmini_pool_finish() {
+  gemmini_pool_run(&gemmini_pool_job, 0);
+
+  while (__atomic_load_n(&gemmini_pool_done, __ATOMIC_ACQUIRE) != gemmini_pool_active - 1);
+}
+
+#elif defined(MULTITHREAD)
+
+static pthread_mutex_t gemmini_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gemmini_pool_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t gemmini_pool_done = PTHREAD_COND_INITIALIZER;
+static size_t gemmini_pool_generation = 0;
+static size_t gemmini_pool_active = 1;
+static size_t gemmini_pool_pending = 0;
+static size_t gemmini_pool_workers = 0;
+
+static void * gemmini_pool_worker(void * arg) {
+  const size_t thread_id = (size_t)arg;
+  size_t generation = 0;
+
+  pthread_mutex_lock(&gemmini_pool_lock);
+  while (1) {
+    while (gemmini_pool_generation == generation)
+      pthread_cond_wait(&gemmini_pool_wakeup, &gemmini_pool_lock);
+    generation = gemmini_pool_generation;
+
+    if (thread_id < gemmini_pool_active) {
+      pthread_mutex_unlock(&gemmini_pool_lock);
+      gemmini_pool_run(&gemmini_pool_job, thread_id);
+      pthread_mutex_lock(&gemmini_pool_lock);
+
+      if (--gemmini_pool_pending == 0)
+        pthread_cond_signal(&gemmini_pool_done);
+    }
+  }
+
+  return NULL;
+}
+
+static size_t gemmini_num_threads() {
+  static long cpus = 0;
+  if (cpus == 0) {
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+      cpus = 1;
+  }
+
+  return gemmini_pool_requested_threads < (size_t)cpus ? gemmini_pool_requested_threads : (size_t)cpus;
+}
+
+static void gemmini_pool_start(size_t threads) {
+  pthread_mutex_lock(&gemmini_pool_lock);
+
+  while (gemmini_pool_workers < threads - 1) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, gemmini_pool_worker, (void*)(gemmini_pool_workers + 1)) != 0)
+      break;
+    pthread_detach(thread);
+    gemmini_pool_workers++;
+  }
+
+  if (threads > gemmini_pool_workers + 1)
+    threads = gemmini_pool_workers + 1;
+
+  gemmini_pool_active = threads;
+  gemmini_pool_pending = threads - 1;
+  gemmini_pool_generation++;
+  pthread_cond_broadcast(&gemmini_pool_wakeup);
+  pthread_mutex_unlock(&gemmini_pool_lock);
+}
+
+static void gemmini_pool_finish() {
+  gemmini_pool_run(&gemmini_pool_job, 0);
+
+  pthread_mutex_lock(&gemmini_pool_lock);
+  while (gemmini_pool_pending != 0)
+    pthread_cond_wait(&gemmini_pool_done, &gemmini_pool_lock);
+  pthread_mutex_unlock(&gemmini_pool_lock);
+}
+
+#else
+
+static size_t gemmini_num_threads() {
+  return 1;
+}
+
+static void gemmini_pool_start(size_t threads) {
+}
+
+static void gemmini_pool_finish() {
+  gemmini_pool_run(&gemmini_pool_job, 0);
+}
+
+#endif
+
+// Limits the number of threads used by later calls to gemmini_parallel_for
+static void gemmini_set_num_threads(size_t threads) {
+  if (threads < 1)
+    threads = 1;
+  else if (threads > GEMMINI_MAX_THREADS)
+    threads = GEMMINI_MAX_THREADS;
+
+  gemmini_pool_requested_threads = threads;
+}
+
+static void gemmini_pool_set_job(size_t n, size_t grain, gemmini_task_t task, void * args) {
+  gemmini_pool_job.task = task;
+  gemmini_pool_job.args = args;
+  gemmini_pool_job.n = n;
+  gemmini_pool_job.grain = grain;
+  gemmini_pool_job.next = 0;
+}
+
+// Returns how many threads (including the caller) should split n iterations
+static size_t gemmini_pool_threads_for(size_t n, size_t grain) {
+  size_t threads = gemmini_num_threads();
+  if (threads > (n + grain - 1) / grain)
+    threads = (n + grain - 1) / grain;
+  return threads;
+}
+
+static void gemmini_parallel_for(size_t n, size_t grain, gemmini_task_t task, void * args) {
+  if (n == 0)
+    return;
+
+  if (grain == 0)
+    grain = 1;
+
+  const size_t threads = gemmini_pool_threads_for(n, grain);
+
+  // Nested calls, and calls that would only use one thread anyway, run
+  // directly on the calling thread
+  if (threads <= 1 || gemmini_pool_busy) {
+    task(args, 0, n, gemmini_pool_thread_id);
+    return;
+  }
+
+  gemmini_pool_busy = true;
+
+  gemmini_pool_set_job(n, grain, task, args);
+  gemmini_pool_start(threads);
+  gemmini_pool_finish();
+
+  gemmini_pool_busy = false;
+}
+
+static bool gemmini_pool_forked = false;
+
+static void gemmini_parallel_fork(size_t n, size_t grain, gemmini_task_t task, void * args) {
+  if (grain == 0)
+    grain = 1;
+
+  // The caller doesn't take any chunks until it joins, so it isn't counted
+  const size_t threads = n == 0 ? 1 : gemmini_pool_threads_for(n, grain) + 1;
+
+  // Without any workers to hand the work to, or when nested, the work is
+  // simply done right away
+  if (gemmini_num_threads() <= 1 || gemmini_pool_busy) {
+    if (n > 0)
+      task(args, 0, n, gemmini_pool_thread_id);
+    return;
+  }
+
+  gemmini_pool_busy = true;
+  gemmini_pool_forked = true;
+
+  gemmini_pool_set_job(n, grain, task, args);
+  gemmini_pool_start(threads < gemmini_num_threads() ? threads : gemmini_num_threads());
+}
+
+static void gemmini_parallel_join() {
+  if (!gemmini_pool_forked)
+    return;
+
+  gemmini_pool_finish();
+
+  gemmini_pool_forked = false;
+  gemmini_pool_busy = false;
+}
+
+#endif // SRC_MAIN_C_GEMMINI_THREADS_H
@@ -0,0 +1,305 @@
+#!/usr/bin/env python3
+# See LICENSE for license details.
+
+"""Generates an MLP benchmark from a model description.
+
+A model description is a JSON file like:
+
+    {
+        "batch_size": 64,
+        "in_features": 784,
+        "pad_to": 64,
+        "init": "random", "seed": 1,
+        "layers": [
+            {"out_features": 2500, "act": "relu", "shift": 0},
+            {"out_features": 10, "act": "none", "shift": 0, "bias": true}
+        ]
+    }
+
+Every feature count is zero-padded up to a multiple of pad_to (1 by default).
+The input, weights and biases are zeros unless init is "random", in which
+case they're small random numbers drawn from seed.
+
+For a description called NAME.json, this writes:
+
+    NAME.bin       The input, and every layer's weights and biases, packed into
+                   one blob of row-aligned int8 matrices and int32 vectors.
+                   Models that are all zeros don't need one, since their blob
+                   is simply left in .bss.
+    NAME_params.h  Links NAME.bin in, and declares the layer table that
+                   tiled_mlp_nn() runs, pointing straight into the blob
+    NAME.c         A driver that runs the table, and reports the cycles and
+                   MACs per cycle of every layer
+
+The layers aren't written as NET_FC layers in a gemmini_model.h container,
+since they don't compute what a NET_FC does. A NET_FC multiplies its weights
+by its input, as [out_features][in_features] times
+[in_features][batch_size], and adds a full [out_features][batch_size] bias.
+An MLP layer multiplies its input by its weights, as
+[batch_size][in_features] times [in_features][out_features], and adds one
+bias per feature to every row. tiled_mlp_nn() relies on that: it keeps the
+activations in the scratchpad as A, and only streams the weights. As
+NET_FC layers, the weights would have to be stored transposed, every bias
+would grow batch_size times over, and the activations would become B, which
+net_run() moves in again for every tile of weights.
+"""
+
+import argparse
+import json
+import os
+import random
+import struct
+import sys
+
+ALIGN = 64
+
+ACTS = {"none": "NO_ACTIVATION", "relu": "RELU"}
+
+
+def pad(n, to):
+    return (n + to - 1) // to * to
+
+
+class Model:
+    def __init__(self, name, desc):
+        self.name = name
+
+        try:
+            self.batch_size = int(desc["batch_size"])
+            pad_to = int(desc.get("pad_to", 1))
+            self.raw_features = [int(desc["in_features"])]
+            self.layers = []
+
+            for l, layer in enumerate(desc["layers"]):
+                act = layer.get("act", "relu")
+                if act not in ACTS:
+                    raise ValueError("layer %d: unknown activation %r" % (l, act))
+
+                self.raw_features.append(int(layer["out_features"]))
+                self.layers.append({
+                    "name": layer.get("name", "layer_%d" % l),
+                    "act": ACTS[act],
+                    "shift": int(layer.get("shift", 0)),
+                    "bias": bool(layer.get("bias", False)),
+                })
+
+            self.init = desc.get("init", "zero")
+            self.seed = int(desc.get("seed", 0))
+        except (KeyError, TypeError, ValueError) as e:
+            raise ValueError("bad model description: %s" % e)
+
+        if self.batch_size <= 0 or pad_to <= 0 or not self.layers or min(self.raw_features) <= 0:
+            raise ValueError("bad model description: sizes must be positive")
+        if self.init not in ("zero", "random"):
+            raise ValueError("bad model description: unknown init %r" % self.init)
+
+        self.features = [pad(f, pad_to) for f in self.raw_features]
+
+    def pack(self):
+        """Returns the blob, and the offsets of the input and of every layer's
+        weights and bias (None without one)"""
+        rng = random.Random(self.seed)
+        blob = bytearray()
+
+        # Uniform in [-8, 8), so that products stay small
+        table = bytes((b % 16 - 8) & 0xff for b in range(256))
+
+        def matrix(rows, cols, raw_rows, raw_cols):
+            offset = pad(len(blob), ALIGN)
+            blob.extend(bytes(offset - len(blob) + rows * cols))
+            if self.init == "random":
+                for r in range(raw_rows):
+                    start = offset + r * cols
+                    blob[start:start + raw_cols] = rng.randbytes(raw_cols).translate(table)
+            return offset
+
+        def vector(n, raw_n):
+            offset = pad(len(blob), ALIGN)
+            blob.extend(bytes(offset - len(blob)))
+            values = [rng.randrange(-256, 256) if self.init == "random" and i < raw_n else 0 for i in range(n)]
+            blob.extend(struct.pack("<%di" % n, *values))
+            return offset
+
+        input_offset = matrix(self.batch_size, self.features[0], self.batch_size, self.raw_features[0])
+
+        offsets = []
+        for l, layer in enumerate(self.layers):
+            K, J = self.features[l], self.features[l + 1]
+            weights = matrix(K, J, self.raw_features[l], self.raw_features[l + 1])
+            bias = vector(J, self.raw_features[l + 1]) if layer["bias"] else None
+            offsets.append((weights, bias))
+
+        blob.extend(bytes(pad(len(blob), ALIGN) - len(blob)))
+        return bytes(blob), input_offset, offsets
+
+    def params_h(self, blob_bytes, input_offset, offsets):
+        name, NAME = self.name, self.name.upper()
+        n = len(self.layers)
+        max_features = max(self.features[1:])
+
+        out = []
+        out.append("// Generated by gemmini_mlp_generator.py from %s.json. Do not edit." % name)
+        out.append("//")
+        out.append("// batch size: %d" % self.batch_size)
+        out.append("// before zeropad: %s" % "x".join(map(str, self.raw_features)))
+        out.append("// after zeropad: %s" % "x".join(map(str, self.features)))
+        out.append("")
+        out.append("#ifndef %s_PARAMS_H" % NAME)
+        out.append("#define %s_PARAMS_H" % NAME)
+        out.append("")
+        out.append('#include "include/gemmini.h"')
+        out.append('#include "include/gemmini_nn.h"')
+        out.append("")
+        out.append("#define %s_BATCH_SIZE %d" % (NAME, self.batch_size))
+        out.append("#define %s_IN_FEATURES %d" % (NAME, self.features[0]))
+        out.append("#define %s_N_LAYERS %d" % (NAME, n))
+        out.append("")
+        if self.init == "zero":
+            out.append("// The input, weights and biases, which are all zeros")
+            out.append("static char %s_blob[%d] __attribute__((aligned(%d)));" % (name, blob_bytes, ALIGN))
+        else:
+            out.append("// The input, weights and biases, read in place from %s.bin" % name)
+            out.append('__asm__(".section .rodata.%s_blob, \\"a\\"\\n"' % name)
+            out.append('        ".balign %d\\n"' % ALIGN)
+            out.append('        ".global %s_blob\\n"' % name)
+            out.append('        "%s_blob:\\n"' % name)
+            out.append('        ".incbin \\"%s.bin\\"\\n"' % name)
+            out.append('        ".previous\\n");')
+            out.append("extern const char %s_blob[];" % name)
+        out.append("")
+        out.append("#define %s_INPUT ((const elem_t *)(%s_blob + %d))" % (NAME, name, input_offset))
+        out.append("")
+        out.append("// Each layer reads the last one's output, so two buffers are enough")
+        out.append("static elem_t %s_activations[2][%d] row_align(1);" % (name, self.batch_size * max_features))
+        out.append("")
+        out.append("#define %s_OUTPUT (%s_activations[%d])" % (NAME, name, (n - 1) % 2))
+        out.append("")
+        out.append("static struct MlpLayer %s_layers[%s_N_LAYERS] = {" % (name, NAME))
+        for l, (layer, (weights, bias)) in enumerate(zip(self.layers, offsets)):
+            bias_ref = "(const acc_t *)(%s_blob + %d)" % (name, bias) if bias is not None else "NULL"
+            out.append('    {.name = "%s", .out_features = %d,' % (layer["name"], self.features[l + 1]))
+            out.append("        .weights = (const elem_t *)(%s_blob + %d), .bias = %s," % (name, weights, bias_ref))
+            out.append("        .output = %s_activations[%d], .act = %s, .shift = %d}," % (name, l % 2, layer["act"], layer["shift"]))
+        out.append("};")
+        out.append("")
+        out.append("// How many features each layer reads")
+        out.append("static const size_t %s_in_features[%s_N_LAYERS] = {%s};" % (name, NAME, ", ".join(map(str, self.features[:-1]))))
+        out.append("")
+        out.append("#endif // %s_PARAMS_H" % NAME)
+        out.append("")
+        return "\n".join(out)
+
+    def driver_c(self):
+        name, NAME = self.name, self.name.upper()
+        return DRIVER.replace("@name@", name).replace("@NAME@", NAME)
+
+
+DRIVER = r'''// Generated by gemmini_mlp_generator.py from @name@.json. Do not edit.
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#ifndef BAREMETAL
+#include <sys/mman.h>
+#endif
+
+#include "include/gemmini.h"
+#include "include/gemmini_nn.h"
+
+#include "@name@_params.h"
+
+int main (int argc, char * argv[]) {
+#ifndef BAREMETAL
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      perror("mlockall failed");
+      exit(1);
+    }
+#endif
+
+    gemmini_flush(0);
+
+    enum tiled_matmul_type_t tiled_matmul_type;
+    if (argc < 2) {
+        tiled_matmul_type = WS;
+    } else if (strcmp(argv[1], "cpu") == 0) {
+        tiled_matmul_type = CPU;
+    } else if (strcmp(argv[1], "os") == 0) {
+        tiled_matmul_type = OS;
+    } else if (strcmp(argv[1], "ws") == 0) {
+        tiled_matmul_type = WS;
+    } else if (strcmp(argv[1], "-h") == 0) {
+        printf("usage: %s [-h] matmul_option [check]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
+        exit(0);
+    } else {
+        printf("Unknown command-line argument\n");
+        printf("usage: %s [-h] matmul_option [check]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
+        exit(1);
+    }
+
+    bool check;
+    if (argc < 3) {
+        check = false;
+    } else if (strcmp(argv[2], "check") == 0) {
+        check = true;
+    } else {
+        printf("Unknown command-line argument\n");
+        printf("usage: %s [-h] matmul_option [check]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
+        exit(1);
+    }
+
+    uint64_t cycles[@NAME@_N_LAYERS] = {0};
+
+    tiled_mlp_nn(@NAME@_BATCH_SIZE, @NAME@_IN_FEATURES, @NAME@_INPUT,
+        @name@_layers, @NAME@_N_LAYERS,
+        tiled_matmul_type, check, cycles);
+
+    uint64_t overall_cycles = 0, overall_macs = 0;
+    for (int l = 0; l < @NAME@_N_LAYERS; l++) {
+        const uint64_t macs = (uint64_t)@NAME@_BATCH_SIZE * @name@_in_features[l] * @name@_layers[l].out_features;
+
+        overall_cycles += cycles[l];
+        overall_macs += macs;
+
+        printf("Cycles taken in layer %d (%s): %llu (%llu MACs per 100 cycles)\n", l, @name@_layers[l].name,
+            (unsigned long long)cycles[l], (unsigned long long)(cycles[l] ? macs * 100 / cycles[l] : 0));
+    }
+    printf("Overall cycles taken: %llu (%llu MACs per 100 cycles)\n",
+        (unsigned long long)overall_cycles, (unsigned long long)(overall_cycles ? overall_macs * 100 / overall_cycles : 0));
+
+    return 0;
+}
+'''
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generates an MLP benchmark for Gemmini from a model description.")
+    parser.add_argument("model", help="a model description, NAME.json")
+    parser.add_argument("-o", "--output-dir", default=".", help="where to write NAME.c, NAME_params.h and NAME.bin")
+    args = parser.parse_args()
+
+    name = os.path.splitext(os.path.basename(args.model))[0]
+    if not name.isidentifier():
+        sys.exit("%s: the model's name has to be a C identifier" % args.model)
+
+    try:
+        with open(args.model) as f:
+            model = Model(name, json.load(f))
+    except (OSError, ValueError) as e:
+        sys.exit("%s: %s" % (args.model, e))
+
+    blob, input_offset, offsets = model.pack()
+
+    outputs = {
+        name + "_params.h": model.params_h(len(blob), input_offset, offsets).encode(),
+        name + ".c": model.driver_c().encode(),
+    }
+    if model.init != "zero":
+        outputs[name + ".bin"] = blob
+
+    for file_name, contents in outputs.items():
+        with open(os.path.join(args.output_dir, file_name), "wb") as f:
+            f.write(contents)
+
+
+if __name__ == "__main__":
+    main()
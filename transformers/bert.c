@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#ifndef BAREMETAL
+#include <sys/mman.h>
+#endif
+#include "include/gemmini.h"
+#include "include/gemmini_nn.h"
+
+#include "bert_params.h"
+
+// The expected output, from the CPU, in check mode
+static elem_t bert_expected[BERT_TOKENS][BERT_HIDDEN];
+
+static uint32_t bert_seed = 1;
+
+static int bert_rand(int lo, int hi) {
+    bert_seed = bert_seed * 1664525 + 1013904223;
+    return lo + (int)((bert_seed >> 8) % (uint32_t)(hi - lo));
+}
+
+static void bert_fill(elem_t * x, size_t n, int lo, int hi) {
+    for (size_t i = 0; i < n; i++)
+        x[i] = bert_rand(lo, hi);
+}
+
+static void bert_fill_acc(acc_t * x, size_t n, int lo, int hi) {
+    for (size_t i = 0; i < n; i++)
+        x[i] = bert_rand(lo, hi);
+}
+
+static void print_op_cycles(const char * op, uint64_t cycles, uint64_t total_cycles) {
+    printf("%s cycles: %llu (%d%%)\n", op, (unsigned long long)cycles, (int)((cycles * 100) / total_cycles));
+}
+
+int main (int argc, char * argv[]) {
+#ifndef BAREMETAL
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+      perror("mlockall failed");
+      exit(1);
+    }
+#endif
+
+    gemmini_flush(0);
+
+    enum tiled_matmul_type_t tiled_matmul_type;
+    if (argc < 2) {
+        tiled_matmul_type = WS;
+    } else if (strcmp(argv[1], "cpu") == 0) {
+        tiled_matmul_type = CPU;
+    } else if (strcmp(argv[1], "os") == 0) {
+        tiled_matmul_type = OS;
+    } else if (strcmp(argv[1], "ws") == 0) {
+        tiled_matmul_type = WS;
+    } else if (strcmp(argv[1], "-h") == 0) {
+        printf("usage: %s [-h] matmul_option [check]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
+        exit(0);
+    } else {
+        printf("Unknown command-line argument\n");
+        printf("usage: %s [-h] matmul_option [check]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
+        exit(1);
+    }
+
+    bool check;
+    if (argc < 3) {
+        check = false;
+    } else if (strcmp(argv[2], "check") == 0) {
+        check = true;
+    } else {
+        printf("Unknown command-line argument\n");
+        printf("usage: %s [-h] matmul_option [check]\n  matmul_option may be 'os', 'ws', or cpu'\n", argv[0]);
+        exit(1);
+    }
+
+    bert_fill((elem_t *)bert_input, sizeof(bert_input), -8, 8);
+    bert_fill((elem_t *)bert_qkv_weights, sizeof(bert_qkv_weights), -8, 8);
+    bert_fill((elem_t *)bert_out_weights, sizeof(bert_out_weights), -8, 8);
+    bert_fill((elem_t *)bert_ffn1_weights, sizeof(bert_ffn1_weights), -8, 8);
+    bert_fill((elem_t *)bert_ffn2_weights, sizeof(bert_ffn2_weights), -8, 8);
+    bert_fill((elem_t *)bert_ln_gamma, sizeof(bert_ln_gamma), 56, 72);
+
+    bert_fill_acc(bert_qkv_bias, sizeof(bert_qkv_bias)/sizeof(acc_t), -1024, 1024);
+    bert_fill_acc(bert_out_bias, sizeof(bert_out_bias)/sizeof(acc_t), -1024, 1024);
+    bert_fill_acc(bert_ffn1_bias, sizeof(bert_ffn1_bias)/sizeof(acc_t), -1024, 1024);
+    bert_fill_acc(bert_ffn2_bias, sizeof(bert_ffn2_bias)/sizeof(acc_t), -1024, 1024);
+    bert_fill_acc((acc_t *)bert_ln_beta, sizeof(bert_ln_beta)/sizeof(acc_t), -1024, 1024);
+
+    if (check) {
+        tiled_encoder_nn(BERT_BATCH_SIZE, BERT_SEQ_LEN, BERT_HIDDEN, BERT_HEADS, BERT_FFN,
+            (elem_t *)bert_input, bert_layers, BERT_N_LAYERS,
+            bert_scratch, CPU, NULL);
+
+        memcpy(bert_expected, BERT_OUTPUT, sizeof(bert_expected));
+    }
+
+    struct EncoderCycles cycles = {0};
+
+    tiled_encoder_nn(BERT_BATCH_SIZE, BERT_SEQ_LEN, BERT_HIDDEN, BERT_HEADS, BERT_FFN,
+        (elem_t *)bert_input, bert_layers, BERT_N_LAYERS,
+        bert_scratch, tiled_matmul_type, &cycles);
+
+    const uint64_t total_cycles = cycles.qkv + cycles.qk + cycles.softmax + cycles.av +
+        cycles.out + cycles.res_add + cycles.layernorm + cycles.ffn;
+
+    const uint64_t tokens = BERT_TOKENS;
+    const uint64_t macs = BERT_N_LAYERS * (tokens * BERT_HIDDEN * (4*BERT_HIDDEN + 2*BERT_FFN) +
+        2 * tokens * BERT_SEQ_LEN * BERT_HIDDEN);
+
+    printf("\nTotal cycles: %llu (100%%)\n", (unsigned long long)total_cycles);
+    print_op_cycles("QKV projection", cycles.qkv, total_cycles);
+    print_op_cycles("QK^T", cycles.qk, total_cycles);
+    print_op_cycles("Softmax", cycles.softmax, total_cycles);
+    print_op_cycles("AV", cycles.av, total_cycles);
+    print_op_cycles("Output projection", cycles.out, total_cycles);
+    print_op_cycles("Res add", cycles.res_add, total_cycles);
+    print_op_cycles("Layernorm", cycles.layernorm, total_cycles);
+    print_op_cycles("Feed-forward", cycles.ffn, total_cycles);
+    printf("MACs per 100 cycles: %llu\n", (unsigned long long)((macs * 100) / total_cycles));
+
+    if (check) {
+        for (size_t i = 0; i < BERT_TOKENS; i++)
+            for (size_t j = 0; j < BERT_HIDDEN; j++)
+                if (BERT_OUTPUT[i][j] != bert_expected[i][j]) {
+                    printf("Output %zu, %zu is %d instead of %d\nFAIL\n",
+                        i, j, BERT_OUTPUT[i][j], bert_expected[i][j]);
+                    exit(1);
+                }
+
+        printf("PASS\n");
+    }
+
+    return 0;
+}
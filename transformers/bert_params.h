@@ -0,0 +1,59 @@
+#ifndef BERT_PARAMS_H
+#define BERT_PARAMS_H
+
+#include "include/gemmini.h"
+#include "include/gemmini_nn.h"
+
+// The shapes of BERT-base, running one 128-token sequence. The layers all
+// share one set of weights, which still have to come in from DRAM for every
+// layer, since they take 7 MB.
+#define BERT_BATCH_SIZE 1
+#define BERT_SEQ_LEN 128
+#define BERT_HIDDEN 768
+#define BERT_HEADS 12
+#define BERT_FFN 3072
+#define BERT_N_LAYERS 2
+
+#define BERT_TOKENS (BERT_BATCH_SIZE * BERT_SEQ_LEN)
+
+static elem_t bert_input[BERT_TOKENS][BERT_HIDDEN] row_align(1);
+
+static elem_t bert_qkv_weights[BERT_HIDDEN][3*BERT_HIDDEN] row_align(1);
+static acc_t bert_qkv_bias[3*BERT_HIDDEN] row_align_acc(1);
+static elem_t bert_out_weights[BERT_HIDDEN][BERT_HIDDEN] row_align(1);
+static acc_t bert_out_bias[BERT_HIDDEN] row_align_acc(1);
+static elem_t bert_ffn1_weights[BERT_HIDDEN][BERT_FFN] row_align(1);
+static acc_t bert_ffn1_bias[BERT_FFN] row_align_acc(1);
+static elem_t bert_ffn2_weights[BERT_FFN][BERT_HIDDEN] row_align(1);
+static acc_t bert_ffn2_bias[BERT_HIDDEN] row_align_acc(1);
+static elem_t bert_ln_gamma[2][BERT_HIDDEN];
+static acc_t bert_ln_beta[2][BERT_HIDDEN];
+
+// Each layer reads the last one's output, so two buffers are enough
+static elem_t bert_activations[2][BERT_TOKENS][BERT_HIDDEN] row_align(1);
+
+#define BERT_OUTPUT (bert_activations[(BERT_N_LAYERS - 1) % 2])
+
+static elem_t bert_scratch[ENCODER_SCRATCH_ELEMS(BERT_BATCH_SIZE, BERT_SEQ_LEN, BERT_HIDDEN, BERT_FFN)] row_align(1);
+
+// The inputs and weights are drawn from [-8, 8), and gamma from [56, 72),
+// around 1.0 in units of 2^-6. These shifts keep every op's outputs in range.
+#define BERT_LAYER(l) { \
+    .name = "layer_" #l, \
+    .qkv_weights = (elem_t *)bert_qkv_weights, .qkv_bias = bert_qkv_bias, \
+    .out_weights = (elem_t *)bert_out_weights, .out_bias = bert_out_bias, \
+    .ln1_gamma = bert_ln_gamma[0], .ln1_beta = bert_ln_beta[0], \
+    .ffn1_weights = (elem_t *)bert_ffn1_weights, .ffn1_bias = bert_ffn1_bias, \
+    .ffn2_weights = (elem_t *)bert_ffn2_weights, .ffn2_bias = bert_ffn2_bias, \
+    .ln2_gamma = bert_ln_gamma[1], .ln2_beta = bert_ln_beta[1], \
+    .output = (elem_t *)bert_activations[(l) % 2], \
+    .qkv_shift = 6, .qk_shift = 5, .out_shift = 7, \
+    .ffn1_shift = 6, .ffn2_shift = 10, .ln_shift = 11, \
+}
+
+static struct EncoderLayer bert_layers[BERT_N_LAYERS] = {
+    BERT_LAYER(0),
+    BERT_LAYER(1),
+};
+
+#endif // BERT_PARAMS_H